@@ -1,5 +1,23 @@
+#include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <immintrin.h>
+#define BASE64_X86
+#endif
+
+// The generic vector encoder is what ARM gets: NEON is always there on
+// AArch64, and on 32-bit ARM only if the build targets it (-mfpu=neon...)
+#if ( defined( __aarch64__ ) || ( defined( __arm__ ) && defined( __ARM_NEON ) ) ) \
+    && ( __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ )
+#define BASE64_VECTOR_DEFAULT
+#endif
+
+#include "base64.h"
+#include "gateway.h"
 
 
 static char encoding_table[] = { 'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H',
@@ -16,20 +34,197 @@ static char *decoding_table = NULL;
 static int mod_table[] = { 0, 2, 1 };
 
 
-char *
-base64_encode( const char *data,
-               size_t input_length,
-               size_t * output_length, char *encoded_data )
+// Encoders for the bulk of the input.  Each converts whole 3-byte groups
+// from the start of In, as many as it can do efficiently, and returns the
+// number of input bytes it used; base64_encode() finishes off the rest.
+typedef size_t( *block_encoder_t ) ( const unsigned char *In, size_t Length,
+                                     char *Out );
+
+// Two output characters per 12 bits, for CPUs without SIMD (e.g. the
+// ARMv6 in a Pi Zero)
+static uint16_t PairTable[4096];
+
+static size_t
+EncodePairs( const unsigned char *In, size_t Length, char *Out )
 {
+    size_t i;
 
-    int i, j;
+    for ( i = 0; i + 3 <= Length; i += 3 )
+    {
+        uint32_t Triple = ( In[i] << 16 ) | ( In[i + 1] << 8 ) | In[i + 2];
 
-    *output_length = 4 * ( ( input_length + 2 ) / 3 );
+        memcpy( Out, &PairTable[Triple >> 12], 2 );
+        memcpy( Out + 2, &PairTable[Triple & 0xFFF], 2 );
+        Out += 4;
+    }
 
-    // char *encoded_data = malloc(*output_length);
-    // if (encoded_data == NULL) return NULL;
+    return i;
+}
 
-    for ( i = 0, j = 0; i < input_length; )
+#ifdef BASE64_X86
+// 12 input bytes to 16 characters per step, after Mula & Lemire: shuffle
+// each 3 bytes into a 32-bit lane, split into 4 sextets with two
+// multiplies, then map sextets to ASCII by adding an offset looked up from
+// the sextet's range.  Reads 16 bytes per step, so stops 4 short.
+__attribute__ ( ( target( "ssse3" ) ) )
+static __m128i
+EncodeSSSE3Step( __m128i In )
+{
+    const __m128i Offsets = _mm_setr_epi8( 'a' - 26, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '+' - 62,
+                                           '/' - 63, 'A', 0, 0 );
+    __m128i Sextets, Range;
+
+    In = _mm_shuffle_epi8( In, _mm_set_epi8( 10, 11, 9, 10, 7, 8, 6, 7,
+                                             4, 5, 3, 4, 1, 2, 0, 1 ) );
+    Sextets = _mm_or_si128(
+        _mm_mulhi_epu16( _mm_and_si128( In, _mm_set1_epi32( 0x0FC0FC00 ) ),
+                         _mm_set1_epi32( 0x04000040 ) ),
+        _mm_mullo_epi16( _mm_and_si128( In, _mm_set1_epi32( 0x003F03F0 ) ),
+                         _mm_set1_epi32( 0x01000010 ) ) );
+
+    // 0 for A-Z, 1 for a-z, 2-11 for digits, 12 '+', 13 '/'
+    Range = _mm_subs_epu8( Sextets, _mm_set1_epi8( 51 ) );
+    Range = _mm_or_si128( Range,
+                          _mm_and_si128( _mm_cmpgt_epi8( _mm_set1_epi8( 26 ),
+                                                         Sextets ),
+                                         _mm_set1_epi8( 13 ) ) );
+
+    return _mm_add_epi8( Sextets, _mm_shuffle_epi8( Offsets, Range ) );
+}
+
+__attribute__ ( ( target( "ssse3" ) ) )
+static size_t
+EncodeSSSE3( const unsigned char *In, size_t Length, char *Out )
+{
+    size_t i;
+
+    for ( i = 0; i + 16 <= Length; i += 12 )
+    {
+        _mm_storeu_si128( ( __m128i * ) Out,
+                          EncodeSSSE3Step( _mm_loadu_si128
+                                           ( ( const __m128i * ) ( In + i ) ) ) );
+        Out += 16;
+    }
+
+    return i;
+}
+
+// The same, 24 bytes at a time in the two 128-bit halves
+__attribute__ ( ( target( "avx2" ) ) )
+static size_t
+EncodeAVX2( const unsigned char *In, size_t Length, char *Out )
+{
+    const __m256i Offsets =
+        _mm256_setr_epi8( 'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                          '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                          '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+                          'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                          '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                          '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0 );
+    const __m256i Shuffle =
+        _mm256_setr_epi8( 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                          1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10 );
+    size_t i;
+
+    for ( i = 0; i + 28 <= Length; i += 24 )
+    {
+        __m256i Data, Sextets, Range;
+
+        Data = _mm256_inserti128_si256(
+            _mm256_castsi128_si256( _mm_loadu_si128
+                                    ( ( const __m128i * ) ( In + i ) ) ),
+            _mm_loadu_si128( ( const __m128i * ) ( In + i + 12 ) ), 1 );
+        Data = _mm256_shuffle_epi8( Data, Shuffle );
+
+        Sextets = _mm256_or_si256(
+            _mm256_mulhi_epu16( _mm256_and_si256( Data,
+                                                  _mm256_set1_epi32( 0x0FC0FC00 ) ),
+                                _mm256_set1_epi32( 0x04000040 ) ),
+            _mm256_mullo_epi16( _mm256_and_si256( Data,
+                                                  _mm256_set1_epi32( 0x003F03F0 ) ),
+                                _mm256_set1_epi32( 0x01000010 ) ) );
+
+        Range = _mm256_subs_epu8( Sextets, _mm256_set1_epi8( 51 ) );
+        Range = _mm256_or_si256( Range,
+                                 _mm256_and_si256( _mm256_cmpgt_epi8
+                                                   ( _mm256_set1_epi8( 26 ),
+                                                     Sextets ),
+                                                   _mm256_set1_epi8( 13 ) ) );
+
+        _mm256_storeu_si256( ( __m256i * ) Out,
+                             _mm256_add_epi8( Sextets,
+                                              _mm256_shuffle_epi8( Offsets,
+                                                                   Range ) ) );
+        Out += 32;
+    }
+
+    return i;
+}
+#endif
+
+// The SSSE3 step again, 12 bytes to 16 characters, in GCC's generic
+// vector extensions so the one version builds to NEON on AArch64 and ARMv7
+// (and SSE2 elsewhere).  Each 3 bytes are shuffled into a 32-bit lane as
+// b0 << 16 | b1 << 8 | b2, split into sextets with shifts and masks, and
+// each sextet mapped to ASCII by adding 'A' plus a correction per range.
+// The lane layout assumes little-endian.
+typedef uint8_t v16u8 __attribute__ ( ( vector_size( 16 ) ) );
+typedef uint32_t v4u32 __attribute__ ( ( vector_size( 16 ) ) );
+
+static inline v16u8
+EncodeVectorStep( v16u8 In )
+{
+    const v16u8 Shuffle = { 2, 1, 0, 0, 5, 4, 3, 3, 8, 7, 6, 6, 11, 10, 9, 9 };
+    v16u8 Sextets;
+    v4u32 x;
+
+    x = ( v4u32 ) __builtin_shuffle( In, Shuffle );
+    Sextets = ( v16u8 ) ( ( ( x >> 18 ) & 0x3F ) | ( ( x >> 4 ) & 0x3F00 ) |
+                          ( ( x << 10 ) & 0x3F0000 ) |
+                          ( ( x << 24 ) & 0x3F000000 ) );
+
+    // 'A' for A-Z, then 'a' - 26, '0' - 52, '+' - 62 and '/' - 63
+    return Sextets + 'A' + ( ( v16u8 ) ( Sextets >= 26 ) & 6 )
+        + ( ( v16u8 ) ( Sextets >= 52 ) & ( uint8_t ) - 75 )
+        + ( ( v16u8 ) ( Sextets == 62 ) & ( uint8_t ) - 15 )
+        + ( ( v16u8 ) ( Sextets == 63 ) & ( uint8_t ) - 12 );
+}
+
+// Reads 16 bytes per step, so stops 4 short
+static size_t
+EncodeVector( const unsigned char *In, size_t Length, char *Out )
+{
+    v16u8 Data;
+    size_t i;
+
+    for ( i = 0; i + 16 <= Length; i += 12 )
+    {
+        memcpy( &Data, In + i, 16 );
+        Data = EncodeVectorStep( Data );
+        memcpy( Out, &Data, 16 );
+        Out += 16;
+    }
+
+    return i;
+}
+
+static void
+Encode( block_encoder_t Encoder, const char *data, size_t input_length,
+        char *encoded_data )
+{
+    size_t i, j, output_length;
+
+    output_length = 4 * ( ( input_length + 2 ) / 3 );
+
+    // No encoder means all the plain way, for the self-check
+    i = Encoder ? Encoder( ( const unsigned char * ) data, input_length,
+                           encoded_data ) : 0;
+    j = i / 3 * 4;
+
+    for ( ; i < input_length; )
     {
         uint32_t octet_a = i < input_length ? ( unsigned char ) data[i++] : 0;
         uint32_t octet_b = i < input_length ? ( unsigned char ) data[i++] : 0;
@@ -44,7 +239,135 @@ base64_encode( const char *data,
     }
 
     for ( i = 0; i < mod_table[input_length % 3]; i++ )
-        encoded_data[*output_length - 1 - i] = '=';
+        encoded_data[output_length - 1 - i] = '=';
+}
+
+static const struct {
+    const char *Name;
+    block_encoder_t Encoder;
+} Encoders[] = {
+    {"plain", NULL},            // No block encoder at all
+    {"scalar", EncodePairs},
+    {"vector", EncodeVector},
+#ifdef BASE64_X86
+    {"ssse3", EncodeSSSE3},
+    {"avx2", EncodeAVX2},
+#endif
+};
+
+static block_encoder_t BlockEncoder = EncodePairs;
+static pthread_once_t EncoderOnce = PTHREAD_ONCE_INIT;
+
+static int
+EncoderSupported( block_encoder_t Encoder )
+{
+#ifdef BASE64_X86
+    if ( Encoder == EncodeAVX2 )
+        return __builtin_cpu_supports( "avx2" );
+    if ( Encoder == EncodeSSSE3 )
+        return __builtin_cpu_supports( "ssse3" );
+#endif
+
+    return 1;
+}
+
+// Pick the fastest encoder this CPU has, and check it against the plain
+// one before trusting it
+static void
+ChooseEncoder( void )
+{
+    unsigned char Test[200];
+    char Expected[268], Actual[268];
+    block_encoder_t Encoder;
+    const char *Name;
+    int i;
+
+    for ( i = 0; i < 4096; i++ )
+    {
+        char Pair[2] = { encoding_table[i >> 6], encoding_table[i & 0x3F] };
+
+        memcpy( &PairTable[i], Pair, 2 );
+    }
+
+    Encoder = EncodePairs;
+    Name = "scalar";
+
+#ifdef BASE64_X86
+    __builtin_cpu_init(  );
+    if ( EncoderSupported( EncodeAVX2 ) )
+    {
+        Encoder = EncodeAVX2;
+        Name = "AVX2";
+    }
+    else if ( EncoderSupported( EncodeSSSE3 ) )
+    {
+        Encoder = EncodeSSSE3;
+        Name = "SSSE3";
+    }
+#endif
+#ifdef BASE64_VECTOR_DEFAULT
+    Encoder = EncodeVector;
+    Name = "NEON";
+#endif
+
+    // Every sextet value, at every alignment, and a ragged end
+    for ( i = 0; i < sizeof( Test ); i++ )
+    {
+        Test[i] = i * 37 + ( i >> 3 );
+    }
+
+    for ( i = 0; i < 4; i++ )
+    {
+        Encode( NULL, ( char * ) Test + i, sizeof( Test ) - i * 2,
+                Expected );
+        Encode( Encoder, ( char * ) Test + i, sizeof( Test ) - i * 2, Actual );
+        if ( memcmp( Expected, Actual, 4 * ( ( sizeof( Test ) - i * 2 + 2 ) / 3 ) ) )
+        {
+            LogMessage( "base64 %s encoder failed its self-check, not used\n",
+                        Name );
+            Encoder = EncodePairs;
+            break;
+        }
+    }
+
+    BlockEncoder = Encoder;
+}
+
+// Use the named encoder from now on instead of the one chosen for this
+// CPU, for the tests and benchmarks.  Returns 0, or -1 if there's no such
+// encoder or the CPU can't run it.
+int
+base64_select_encoder( const char *Name )
+{
+    int i;
+
+    pthread_once( &EncoderOnce, ChooseEncoder );
+
+    for ( i = 0; i < sizeof( Encoders ) / sizeof( Encoders[0] ); i++ )
+    {
+        if ( !strcmp( Encoders[i].Name, Name )
+             && EncoderSupported( Encoders[i].Encoder ) )
+        {
+            BlockEncoder = Encoders[i].Encoder;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+// Same as ever, but the bulk of the work is done by the fastest encoder
+// the CPU supports (chosen on first use)
+char *
+base64_encode( const char *data,
+               size_t input_length,
+               size_t * output_length, char *encoded_data )
+{
+    pthread_once( &EncoderOnce, ChooseEncoder );
+
+    *output_length = 4 * ( ( input_length + 2 ) / 3 );
+
+    Encode( BlockEncoder, data, input_length, encoded_data );
 
     return encoded_data;
 }
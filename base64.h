@@ -1,4 +1,4 @@
-#include <stdint.h>
+#include <stdint.h>
 
 void build_decoding_table(  );
 char *base64_encode( const char *data, size_t input_length,
@@ -6,3 +6,4 @@ char *base64_encode( const char *data, size_t input_length,
 char *base64_decode( const char *data, size_t input_length,
                      size_t * output_length );
 void base64_cleanup(  );
+int base64_select_encoder( const char *Name );
@@ -0,0 +1,184 @@
+#include <string.h>
+#include <pthread.h>
+
+#include "crc.h"
+
+// CRC16Table[0] is the usual byte-at-a-time table; CRC16Table[k] gives the
+// effect of a byte followed by k zero bytes, so four table lookups can be
+// combined to process four bytes at once
+static uint16_t CRC16Table[4][256];
+static pthread_once_t CRC16Once = PTHREAD_ONCE_INIT;
+
+static void
+BuildCRC16Tables( void )
+{
+    int i, j, k;
+
+    for ( i = 0; i < 256; i++ )
+    {
+        uint16_t CRC = i << 8;
+
+        for ( j = 0; j < 8; j++ )
+        {
+            CRC = ( CRC & 0x8000 ) ? ( CRC << 1 ) ^ 0x1021 : CRC << 1;
+        }
+        CRC16Table[0][i] = CRC;
+    }
+
+    for ( k = 1; k < 4; k++ )
+    {
+        for ( i = 0; i < 256; i++ )
+        {
+            uint16_t CRC = CRC16Table[k - 1][i];
+
+            CRC16Table[k][i] = ( CRC << 8 ) ^ CRC16Table[0][CRC >> 8];
+        }
+    }
+}
+
+uint16_t
+CRC16Update( uint16_t CRC, const unsigned char *Data, size_t Length )
+{
+    pthread_once( &CRC16Once, BuildCRC16Tables );
+
+    while ( Length >= 4 )
+    {
+        CRC = CRC16Table[3][( CRC >> 8 ) ^ Data[0]] ^
+            CRC16Table[2][( CRC & 0xFF ) ^ Data[1]] ^
+            CRC16Table[1][Data[2]] ^ CRC16Table[0][Data[3]];
+        Data += 4;
+        Length -= 4;
+    }
+
+    while ( Length-- )
+    {
+        CRC = ( CRC << 8 ) ^ CRC16Table[0][( CRC >> 8 ) ^ *Data++];
+    }
+
+    return CRC;
+}
+
+// Reflected CRC32 (polynomial 0xEDB88320) as used by zlib and SSDV, sliced
+// the same way as the CRC16 tables above
+static uint32_t CRC32Table[4][256];
+static pthread_once_t CRC32Once = PTHREAD_ONCE_INIT;
+
+static void
+BuildCRC32Tables( void )
+{
+    int i, j, k;
+
+    for ( i = 0; i < 256; i++ )
+    {
+        uint32_t CRC = i;
+
+        for ( j = 0; j < 8; j++ )
+        {
+            CRC = ( CRC & 1 ) ? ( CRC >> 1 ) ^ 0xEDB88320 : CRC >> 1;
+        }
+        CRC32Table[0][i] = CRC;
+    }
+
+    for ( k = 1; k < 4; k++ )
+    {
+        for ( i = 0; i < 256; i++ )
+        {
+            uint32_t CRC = CRC32Table[k - 1][i];
+
+            CRC32Table[k][i] = ( CRC >> 8 ) ^ CRC32Table[0][CRC & 0xFF];
+        }
+    }
+}
+
+// Start with CRC = 0; the result can be passed back in to continue
+uint32_t
+CRC32Update( uint32_t CRC, const unsigned char *Data, size_t Length )
+{
+    pthread_once( &CRC32Once, BuildCRC32Tables );
+
+    CRC = ~CRC;
+
+    while ( Length >= 4 )
+    {
+        CRC ^= Data[0] | ( Data[1] << 8 ) | ( Data[2] << 16 ) |
+            ( ( uint32_t ) Data[3] << 24 );
+        CRC = CRC32Table[3][CRC & 0xFF] ^ CRC32Table[2][( CRC >> 8 ) & 0xFF] ^
+            CRC32Table[1][( CRC >> 16 ) & 0xFF] ^ CRC32Table[0][CRC >> 24];
+        Data += 4;
+        Length -= 4;
+    }
+
+    while ( Length-- )
+    {
+        CRC = ( CRC >> 8 ) ^ CRC32Table[0][( CRC ^ *Data++ ) & 0xFF];
+    }
+
+    return ~CRC;
+}
+
+// CRC of a null-terminated string
+uint16_t
+CRC16( unsigned char *ptr )
+{
+    return CRC16Update( 0xFFFF, ptr, strlen( ( char * ) ptr ) );
+}
+
+static int
+HexDigit( char c )
+{
+    if ( ( c >= '0' ) && ( c <= '9' ) )
+        return c - '0';
+    if ( ( c >= 'A' ) && ( c <= 'F' ) )
+        return c - 'A' + 10;
+    if ( ( c >= 'a' ) && ( c <= 'f' ) )
+        return c - 'a' + 10;
+    return -1;
+}
+
+// Check the checksum on the end of a "$$...*XXXX" sentence.  The CRC covers
+// everything between the $'s and the '*'.  Some older trackers send a
+// 2-digit XOR checksum instead, so that's accepted too.
+int
+TelemetryChecksumOK( const char *Sentence )
+{
+    const char *Start, *Star;
+    unsigned int Sum;
+    int Digits, Digit;
+
+    Start = Sentence;
+    while ( *Start == '$' )
+    {
+        Start++;
+    }
+
+    if ( ( Star = strchr( Start, '*' ) ) == NULL )
+    {
+        return 0;
+    }
+
+    Sum = 0;
+    for ( Digits = 0; ( Digit = HexDigit( Star[1 + Digits] ) ) >= 0; Digits++ )
+    {
+        Sum = ( Sum << 4 ) | Digit;
+    }
+
+    if ( Digits == 4 )
+    {
+        return CRC16Update( 0xFFFF, ( const unsigned char * ) Start,
+                            Star - Start ) == Sum;
+    }
+
+    if ( Digits == 2 )
+    {
+        const char *p;
+        unsigned int XOR = 0;
+
+        for ( p = Start; p < Star; p++ )
+        {
+            XOR ^= ( unsigned char ) *p;
+        }
+        return XOR == Sum;
+    }
+
+    return 0;
+}
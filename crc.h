@@ -0,0 +1,18 @@
+#ifndef _H_CRC
+#define _H_CRC
+
+#include <stdint.h>
+#include <stddef.h>
+
+// CRC16-CCITT (polynomial 0x1021, seed 0xFFFF) as used for the checksum on
+// the end of UKHAS telemetry sentences, and the CRC32 on SSDV packets.
+// Table driven, 4 bytes at a time.
+
+uint16_t CRC16Update( uint16_t CRC, const unsigned char *Data,
+                      size_t Length );
+uint16_t CRC16( unsigned char *ptr );
+uint32_t CRC32Update( uint32_t CRC, const unsigned char *Data,
+                      size_t Length );
+int TelemetryChecksumOK( const char *Sentence );
+
+#endif
@@ -0,0 +1,182 @@
+#include <string.h>
+#include <pthread.h>
+
+#include "dedup.h"
+
+#define DEDUP_TABLE_SIZE    ( DEDUP_RING_SIZE * 2 )
+#define EMPTY_SLOT          0xFFFF
+
+typedef struct {
+    uint64_t Hash;
+    long long FirstSeenNS;
+    int Channel, BestChannel, BestSNR;
+    unsigned int Copies;
+} dedup_entry_t;
+
+static dedup_entry_t Ring[DEDUP_RING_SIZE];
+static unsigned int RingCount = 0;              // Entries ever added
+static uint16_t Table[DEDUP_TABLE_SIZE];        // Ring index, or EMPTY_SLOT
+static int TableReady = 0;
+static long long WindowNS = 30 * 1000000000LL;
+static pthread_mutex_t DedupLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Multiply/xorshift hash, 8 bytes at a time
+static uint64_t
+HashPacket( const uint8_t * Data, int Length )
+{
+    uint64_t Hash, Word;
+
+    Hash = 0xCBF29CE484222325ULL ^ ( uint64_t ) Length;
+
+    for ( ; Length >= 8; Data += 8, Length -= 8 )
+    {
+        memcpy( &Word, Data, 8 );
+        Hash = ( Hash ^ Word ) * 0x9E3779B97F4A7C15ULL;
+        Hash ^= Hash >> 32;
+    }
+
+    if ( Length > 0 )
+    {
+        Word = 0;
+        memcpy( &Word, Data, Length );
+        Hash = ( Hash ^ Word ) * 0x9E3779B97F4A7C15ULL;
+        Hash ^= Hash >> 32;
+    }
+
+    return Hash;
+}
+
+static unsigned int
+HomeSlot( uint64_t Hash )
+{
+    return ( unsigned int ) ( Hash >> 16 ) & ( DEDUP_TABLE_SIZE - 1 );
+}
+
+// Remove ring entry Index from the table, shifting later entries of the
+// probe sequence back so lookups still find them
+static void
+TableRemove( unsigned int Index )
+{
+    unsigned int Slot, Next, Home;
+
+    for ( Slot = HomeSlot( Ring[Index].Hash ); Table[Slot] != Index;
+          Slot = ( Slot + 1 ) & ( DEDUP_TABLE_SIZE - 1 ) )
+    {
+        if ( Table[Slot] == EMPTY_SLOT )
+            return;
+    }
+
+    for ( Next = ( Slot + 1 ) & ( DEDUP_TABLE_SIZE - 1 );
+          Table[Next] != EMPTY_SLOT;
+          Next = ( Next + 1 ) & ( DEDUP_TABLE_SIZE - 1 ) )
+    {
+        // Move it back if its home slot isn't between the hole and it
+        Home = HomeSlot( Ring[Table[Next]].Hash );
+        if ( ( ( Next - Home ) & ( DEDUP_TABLE_SIZE - 1 ) ) >=
+             ( ( Next - Slot ) & ( DEDUP_TABLE_SIZE - 1 ) ) )
+        {
+            Table[Slot] = Table[Next];
+            Slot = Next;
+        }
+    }
+
+    Table[Slot] = EMPTY_SLOT;
+}
+
+void
+DedupSetWindow( int Seconds )
+{
+    WindowNS = Seconds * 1000000000LL;
+}
+
+// Returns 1 if this packet was already seen within the window.  Either way
+// Result describes all the copies so far, including the best SNR and the
+// channel it came on.
+int
+DedupCheck( const uint8_t * Data, int Length, int Channel, int SNR,
+            const struct timespec *Now, dedup_result_t * Result )
+{
+    dedup_entry_t *Entry;
+    uint64_t Hash;
+    long long NowNS;
+    unsigned int Slot, Index;
+    int Duplicate;
+
+    Hash = HashPacket( Data, Length );
+    NowNS = Now->tv_sec * 1000000000LL + Now->tv_nsec;
+
+    pthread_mutex_lock( &DedupLock );
+
+    if ( !TableReady )
+    {
+        memset( Table, 0xFF, sizeof( Table ) );
+        TableReady = 1;
+    }
+
+    for ( Slot = HomeSlot( Hash ); Table[Slot] != EMPTY_SLOT;
+          Slot = ( Slot + 1 ) & ( DEDUP_TABLE_SIZE - 1 ) )
+    {
+        if ( Ring[Table[Slot]].Hash == Hash )
+            break;
+    }
+
+    Duplicate = 0;
+    if ( Table[Slot] != EMPTY_SLOT )
+    {
+        Entry = &Ring[Table[Slot]];
+        if ( NowNS - Entry->FirstSeenNS < WindowNS )
+        {
+            Duplicate = 1;
+        }
+        else
+        {
+            // Same packet again, but long enough ago to count as new
+            TableRemove( Table[Slot] );
+            Entry->Hash = 0;
+        }
+    }
+
+    if ( Duplicate )
+    {
+        Entry->Copies++;
+        Result->Best = SNR > Entry->BestSNR;
+        if ( Result->Best )
+        {
+            Entry->BestSNR = SNR;
+            Entry->BestChannel = Channel;
+        }
+    }
+    else
+    {
+        // Take the oldest ring entry
+        Index = RingCount++ & ( DEDUP_RING_SIZE - 1 );
+        if ( RingCount > DEDUP_RING_SIZE )
+        {
+            TableRemove( Index );
+        }
+
+        Entry = &Ring[Index];
+        Entry->Hash = Hash;
+        Entry->FirstSeenNS = NowNS;
+        Entry->Channel = Channel;
+        Entry->BestChannel = Channel;
+        Entry->BestSNR = SNR;
+        Entry->Copies = 1;
+        Result->Best = 1;
+
+        for ( Slot = HomeSlot( Hash ); Table[Slot] != EMPTY_SLOT;
+              Slot = ( Slot + 1 ) & ( DEDUP_TABLE_SIZE - 1 ) )
+        {
+        }
+        Table[Slot] = Index;
+    }
+
+    Result->Channel = Entry->Channel;
+    Result->BestChannel = Entry->BestChannel;
+    Result->BestSNR = Entry->BestSNR;
+    Result->Copies = Entry->Copies;
+
+    pthread_mutex_unlock( &DedupLock );
+
+    return Duplicate;
+}
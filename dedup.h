@@ -0,0 +1,27 @@
+#ifndef _H_Dedup
+#define _H_Dedup
+
+#include <stdint.h>
+#include <time.h>
+
+// Duplicate packet filter.  Remembers a hash of each recent packet so that
+// a second copy - heard on another channel, or repeated by the payload -
+// isn't logged, parsed and uploaded again.  Entries live in a fixed ring
+// (so memory is bounded and the oldest go first) indexed by a small
+// open-addressed hash table, and expire after the window anyway.
+
+#define DEDUP_RING_SIZE     256     // Packets remembered; must be a power of 2
+
+typedef struct {
+    int Channel;                // First heard on
+    int BestChannel;            // Best copy heard on
+    int BestSNR;
+    unsigned int Copies;        // Including the first
+    int Best;                   // This copy has the best SNR so far
+} dedup_result_t;
+
+void DedupSetWindow( int Seconds );
+int DedupCheck( const uint8_t * Data, int Length, int Channel, int SNR,
+                const struct timespec *Now, dedup_result_t * Result );
+
+#endif
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "events.h"
+#include "gateway.h"
+
+#define MAX_SUBSCRIBERS     8       // Per event type
+
+typedef struct {
+    const char *Name;
+    event_handler_t Handler;
+
+    // Timing, updated by whichever thread publishes
+    unsigned long Calls;
+    unsigned long long TotalNS;
+    unsigned long long MaxNS;
+} subscriber_t;
+
+static subscriber_t Subscribers[EVENT_TYPES][MAX_SUBSCRIBERS];
+static int SubscriberCounts[EVENT_TYPES];
+
+static const char *EventNames[EVENT_TYPES] = {
+    "Unknown", "Telemetry", "Binary", "SSDV", "Calling", "Upload",
+    "Controller", "Command", "CRC", "SSDVError", "Duplicate", "Received"
+};
+
+// Packet type by first byte; anything not listed is EVENT_UNKNOWN
+static const uint8_t PacketTypes[256] = {
+    ['$'] = EVENT_TELEMETRY,
+    ['!'] = EVENT_UPLOAD,
+    ['^'] = EVENT_CALLING,
+    ['>'] = EVENT_FLIGHT_CONTROLLER,
+    ['*'] = EVENT_UPLINK_COMMAND,
+    [0x66 ... 0x69] = EVENT_SSDV,
+    [0xC0 ... 0xCF] = EVENT_BINARY_TELEMETRY
+};
+
+// Call at startup, before any packets are published
+int
+EventSubscribe( event_type_t Type, const char *Name, event_handler_t Handler )
+{
+    subscriber_t *Subscriber;
+
+    if ( SubscriberCounts[Type] >= MAX_SUBSCRIBERS )
+    {
+        LogMessage( "Too many event subscribers, %s ignored\n", Name );
+        return -1;
+    }
+
+    Subscriber = &Subscribers[Type][SubscriberCounts[Type]++];
+    memset( Subscriber, 0, sizeof( *Subscriber ) );
+    Subscriber->Name = Name;
+    Subscriber->Handler = Handler;
+
+    return 0;
+}
+
+event_type_t
+PacketEventType( unsigned char FirstByte )
+{
+    return PacketTypes[FirstByte];
+}
+
+void
+EventPublish( packet_event_t * Event )
+{
+    int i;
+
+    for ( i = 0; i < SubscriberCounts[Event->Type]; i++ )
+    {
+        subscriber_t *Subscriber = &Subscribers[Event->Type][i];
+        struct timespec Start, End;
+        unsigned long long NS, Max;
+
+        clock_gettime( CLOCK_MONOTONIC, &Start );
+        Subscriber->Handler( Event );
+        clock_gettime( CLOCK_MONOTONIC, &End );
+
+        NS = ( End.tv_sec - Start.tv_sec ) * 1000000000ULL +
+            End.tv_nsec - Start.tv_nsec;
+
+        __atomic_add_fetch( &Subscriber->Calls, 1, __ATOMIC_RELAXED );
+        __atomic_add_fetch( &Subscriber->TotalNS, NS, __ATOMIC_RELAXED );
+        Max = __atomic_load_n( &Subscriber->MaxNS, __ATOMIC_RELAXED );
+        while ( ( NS > Max )
+                && !__atomic_compare_exchange_n( &Subscriber->MaxNS, &Max, NS,
+                                                 0, __ATOMIC_RELAXED,
+                                                 __ATOMIC_RELAXED ) )
+        {
+        }
+    }
+}
+
+// Publish a received packet as its typed event (or EVENT_DUPLICATE or
+// EVENT_SSDV_ERROR), then as EVENT_RECEIVED
+void
+PublishPacket( int Channel, char *Message, int Bytes,
+               const rx_packet_t * Packet, const struct timespec *RxTime )
+{
+    packet_event_t Event;
+
+    Event.Channel = Channel;
+    Event.Message = Message;
+    Event.Bytes = Bytes;
+    Event.Packet = Packet;
+    Event.RxTime = *RxTime;
+
+    Event.Type = PacketEventType( Message[1] );
+    Event.Corrected = 0;
+    memset( &Event.Dedup, 0, sizeof( Event.Dedup ) );
+
+    // Repair SSDV packets first, so a damaged copy isn't taken for a new
+    // packet and only good ones are stored and uploaded
+    if ( Event.Type == EVENT_SSDV )
+    {
+        Event.Corrected =
+            SSDVPacketRepair( ( unsigned char * ) Message, Bytes );
+        if ( Event.Corrected == SSDV_FEC_FAILED )
+        {
+            Event.Type = EVENT_SSDV_ERROR;
+        }
+    }
+
+    // Only filter what gets uploaded; calling mode and uplink messages
+    // must still reach every channel that hears them
+    if ( ( Event.Type == EVENT_TELEMETRY )
+         || ( Event.Type == EVENT_BINARY_TELEMETRY )
+         || ( Event.Type == EVENT_SSDV ) )
+    {
+        if ( DedupCheck( ( uint8_t * ) Message + 1, Bytes, Channel,
+                         Packet ? Packet->SNR : -128, RxTime, &Event.Dedup ) )
+        {
+            Event.Type = EVENT_DUPLICATE;
+        }
+    }
+
+    EventPublish( &Event );
+
+    Event.Type = EVENT_RECEIVED;
+    EventPublish( &Event );
+}
+
+void
+LogEventStats( void )
+{
+    int Type, i;
+
+    for ( Type = 0; Type < EVENT_TYPES; Type++ )
+    {
+        for ( i = 0; i < SubscriberCounts[Type]; i++ )
+        {
+            subscriber_t *Subscriber = &Subscribers[Type][i];
+
+            if ( Subscriber->Calls )
+            {
+                LogMessage( "%-9s %-14s %6lu calls, avg %6lluus, max %6lluus\n",
+                            EventNames[Type], Subscriber->Name,
+                            Subscriber->Calls,
+                            Subscriber->TotalNS / Subscriber->Calls / 1000,
+                            Subscriber->MaxNS / 1000 );
+            }
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef _H_Events
+#define _H_Events
+
+#include <time.h>
+
+#include "rxqueue.h"
+#include "dedup.h"
+#include "ssdvfec.h"
+
+// Packet pipeline.  Every packet, whether from a radio or injected for
+// testing, is classified by its first byte using a lookup table and
+// published as a typed event.  Consumers (logging, display, habitat, SSDV,
+// ...) subscribe to the event types they want at startup and are called in
+// the order they subscribed.  Repeats of telemetry and SSDV packets already
+// heard (on any channel) are published as EVENT_DUPLICATE instead, so they
+// never reach the upload queues.  SSDV packets are checked, and repaired
+// if need be, before that (see ssdvfec.h).  The time spent in each subscriber is kept so
+// slow stages show up.
+
+typedef enum {
+    EVENT_UNKNOWN,              // Unrecognised packet type
+    EVENT_TELEMETRY,            // $$ sentence
+    EVENT_BINARY_TELEMETRY,     // struct TBinaryPacket
+    EVENT_SSDV,
+    EVENT_CALLING,              // ^ calling mode message
+    EVENT_UPLOAD,               // ! message from the tracker
+    EVENT_FLIGHT_CONTROLLER,    // >
+    EVENT_UPLINK_COMMAND,       // *
+    EVENT_CRC_ERROR,            // Packet failed the LoRa CRC
+    EVENT_SSDV_ERROR,           // SSDV packet failed its CRC32 and couldn't be repaired
+    EVENT_DUPLICATE,            // Telemetry or SSDV already received
+    EVENT_RECEIVED,             // Any good packet, after its typed event
+    EVENT_TYPES
+} event_type_t;
+
+typedef struct {
+    event_type_t Type;
+    int Channel;
+    char *Message;              // Message[0] is reserved, data starts at Message[1]
+    int Bytes;
+    const rx_packet_t *Packet;  // Radio details, or NULL if injected
+    struct timespec RxTime;
+    dedup_result_t Dedup;       // Copies is 0 if it wasn't checked
+    int Corrected;              // EVENT_SSDV: bytes repaired by the FEC
+} packet_event_t;
+
+typedef void ( *event_handler_t ) ( packet_event_t * Event );
+
+int EventSubscribe( event_type_t Type, const char *Name,
+                    event_handler_t Handler );
+event_type_t PacketEventType( unsigned char FirstByte );
+void PublishPacket( int Channel, char *Message, int Bytes,
+                    const rx_packet_t * Packet,
+                    const struct timespec *RxTime );
+void EventPublish( packet_event_t * Event );
+void LogEventStats( void );
+
+#endif
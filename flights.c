@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "flights.h"
+#include "gateway.h"
+
+static flight_t Flights[FLIGHT_TABLE_SIZE];
+static int FlightCount = 0;
+static pthread_mutex_t FlightLock = PTHREAD_MUTEX_INITIALIZER;
+
+// FNV-1a
+static unsigned int
+HashPayload( const char *Payload )
+{
+    uint32_t Hash = 2166136261u;
+
+    while ( *Payload )
+    {
+        Hash ^= ( unsigned char ) *Payload++;
+        Hash *= 16777619u;
+    }
+
+    return Hash;
+}
+
+// Slot holding Payload, or the empty slot where it would go.  Returns -1
+// if it isn't there and the table is full.  Caller holds FlightLock.
+static int
+FindSlot( const char *Payload )
+{
+    unsigned int Slot;
+
+    for ( Slot = HashPayload( Payload );; Slot++ )
+    {
+        flight_t *Flight = &Flights[Slot & ( FLIGHT_TABLE_SIZE - 1 )];
+
+        if ( Flight->Telemetry.Payload[0] == '\0' )
+        {
+            return ( FlightCount < MAX_FLIGHTS ) ?
+                ( int ) ( Slot & ( FLIGHT_TABLE_SIZE - 1 ) ) : -1;
+        }
+        if ( strcmp( Flight->Telemetry.Payload, Payload ) == 0 )
+        {
+            return Slot & ( FLIGHT_TABLE_SIZE - 1 );
+        }
+    }
+}
+
+// Empty a slot, moving later entries of its probe sequence back to fill
+// the gap so that every entry can still be found from its home slot
+static void
+RemoveSlot( int Hole )
+{
+    int Next, Home;
+
+    for ( Next = ( Hole + 1 ) & ( FLIGHT_TABLE_SIZE - 1 );
+          Flights[Next].Telemetry.Payload[0] != '\0';
+          Next = ( Next + 1 ) & ( FLIGHT_TABLE_SIZE - 1 ) )
+    {
+        Home = HashPayload( Flights[Next].Telemetry.Payload ) &
+            ( FLIGHT_TABLE_SIZE - 1 );
+
+        // Can move back if the hole is between its home and where it is
+        if ( ( ( Next - Home ) & ( FLIGHT_TABLE_SIZE - 1 ) ) >=
+             ( ( Next - Hole ) & ( FLIGHT_TABLE_SIZE - 1 ) ) )
+        {
+            Flights[Hole] = Flights[Next];
+            Hole = Next;
+        }
+    }
+
+    memset( &Flights[Hole], 0, sizeof( Flights[Hole] ) );
+    FlightCount--;
+}
+
+// Make room by dropping the payload heard least recently.  Mistyped or
+// corrupted callsigns would otherwise fill the table for good.  Caller
+// holds FlightLock.
+static void
+RemoveOldest( time_t At )
+{
+    int Slot, Oldest;
+
+    Oldest = -1;
+    for ( Slot = 0; Slot < FLIGHT_TABLE_SIZE; Slot++ )
+    {
+        if ( ( Flights[Slot].Telemetry.Payload[0] != '\0' )
+             && ( ( Oldest < 0 ) || ( Flights[Slot].LastPacketAt <
+                                      Flights[Oldest].LastPacketAt ) ) )
+        {
+            Oldest = Slot;
+        }
+    }
+
+    if ( Oldest >= 0 )
+    {
+        LogMessage( "Flight table full, dropping %s (last heard %lds ago)\n",
+                    Flights[Oldest].Telemetry.Payload,
+                    ( long ) ( At - Flights[Oldest].LastPacketAt ) );
+        RemoveSlot( Oldest );
+    }
+}
+
+// Record new telemetry for its payload, adding the payload if it's new,
+// and work out the ascent rate since its last position.  A copy of the
+// updated entry goes in Flight.  Returns 0 if the payload has no ID.
+int
+FlightUpdate( int Channel, const telemetry_values_t * Telemetry, time_t At,
+              flight_t * Flight )
+{
+    flight_t *Entry;
+    unsigned long Now;
+    int Slot;
+
+    if ( Telemetry->Payload[0] == '\0' )
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock( &FlightLock );
+
+    if ( ( Slot = FindSlot( Telemetry->Payload ) ) < 0 )
+    {
+        RemoveOldest( At );
+        Slot = FindSlot( Telemetry->Payload );
+    }
+
+    Entry = &Flights[Slot];
+    if ( Entry->Telemetry.Payload[0] == '\0' )
+    {
+        memset( Entry, 0, sizeof( *Entry ) );
+        FlightCount++;
+    }
+
+    Now = Telemetry->Seconds >= 0 ? Telemetry->Seconds : 0;
+
+    if ( ( Entry->LastPositionAt > 0 ) && ( Now > Entry->LastPositionAt ) )
+    {
+        Entry->AscentRate =
+            ( ( float ) Telemetry->Altitude - ( float ) Entry->Telemetry.Altitude ) /
+            ( ( float ) Now - ( float ) Entry->LastPositionAt );
+    }
+    else
+    {
+        Entry->AscentRate = 0;
+    }
+
+    Entry->PreviousAltitude = Entry->Telemetry.Altitude;
+    Entry->LastPositionAt = Now;
+    Entry->Telemetry = *Telemetry;
+    Entry->Channel = Channel;
+    Entry->LastPacketAt = At;
+    Entry->PacketCount++;
+
+    *Flight = *Entry;
+
+    pthread_mutex_unlock( &FlightLock );
+
+    return 1;
+}
+
+// Copy of the entry for Payload; returns 0 if we haven't heard it
+int
+FlightGet( const char *Payload, flight_t * Flight )
+{
+    int Slot, Found;
+
+    pthread_mutex_lock( &FlightLock );
+
+    Slot = FindSlot( Payload );
+    Found = ( Slot >= 0 ) && ( Flights[Slot].Telemetry.Payload[0] != '\0' );
+    if ( Found )
+    {
+        *Flight = Flights[Slot];
+    }
+
+    pthread_mutex_unlock( &FlightLock );
+
+    return Found;
+}
+
+// A repeat of the payload's latest packet was heard better on Channel
+void
+FlightSetChannel( const char *Payload, int Channel )
+{
+    int Slot;
+
+    pthread_mutex_lock( &FlightLock );
+
+    Slot = FindSlot( Payload );
+    if ( ( Slot >= 0 ) && ( Flights[Slot].Telemetry.Payload[0] != '\0' ) )
+    {
+        Flights[Slot].Channel = Channel;
+    }
+
+    pthread_mutex_unlock( &FlightLock );
+}
+
+// Walk the table.  Start with *Index = 0; returns 0 when there are no more.
+int
+FlightNext( int *Index, flight_t * Flight )
+{
+    int Found = 0;
+
+    pthread_mutex_lock( &FlightLock );
+
+    while ( !Found && ( *Index < FLIGHT_TABLE_SIZE ) )
+    {
+        if ( Flights[*Index].Telemetry.Payload[0] != '\0' )
+        {
+            *Flight = Flights[*Index];
+            Found = 1;
+        }
+        ( *Index )++;
+    }
+
+    pthread_mutex_unlock( &FlightLock );
+
+    return Found;
+}
@@ -0,0 +1,34 @@
+#ifndef _H_Flights
+#define _H_Flights
+
+#include <time.h>
+
+#include "telemetry.h"
+
+// Flight table: the latest state of every payload we've heard, keyed by
+// payload ID, so several payloads can share a channel (or move between
+// channels) without their positions and ascent rates getting mixed up.
+// It's an open-addressed hash table with linear probing.  Once it's full,
+// the payload heard least recently makes way for a new one.  All access goes through these functions, which lock the table
+// and hand back copies, so any thread can use them.
+
+#define FLIGHT_TABLE_SIZE   128     // Must be a power of 2
+#define MAX_FLIGHTS         96      // Keeps the probe sequences short
+
+typedef struct {
+    telemetry_values_t Telemetry;   // Latest; Telemetry.Payload is the key
+    int Channel;                    // Channel that heard the latest packet best
+    time_t LastPacketAt;
+    unsigned int PacketCount;
+    unsigned int PreviousAltitude;
+    long LastPositionAt;            // Seconds since midnight, from Telemetry
+    float AscentRate;               // m/s
+} flight_t;
+
+int FlightUpdate( int Channel, const telemetry_values_t * Telemetry,
+                  time_t At, flight_t * Flight );
+int FlightGet( const char *Payload, flight_t * Flight );
+int FlightNext( int *Index, flight_t * Flight );
+void FlightSetChannel( const char *Payload, int Channel );
+
+#endif
@@ -13,83 +13,490 @@
 #include <dirent.h>
 #include <math.h>
 #include <pthread.h>
+#include <curl/curl.h>
 
 #include "ftp.h"
 #include "global.h"
+#include "ssdvimage.h"
+#include "gateway.h"
 
-void
-ConvertFile( char *FileName )
+#define CONVERT_DELAY_MS        2000    // Wait this long for more packets
+#define MAX_CONVERSION_THREADS  4
+
+typedef struct upload {
+    struct upload *Next;
+    char FileName[300];
+    uint64_t UploadedHash;      // Contents last uploaded, 0 if none
+    uint64_t FailedHash;        // Contents of an upload that didn't finish
+    int Queued;
+} upload_t;
+
+typedef struct {
+    const unsigned char *Data;
+    size_t Length, Position;
+} upload_buffer_t;
+
+typedef struct conversion {
+    struct conversion *Next;
+    char Callsign[7];
+    int ImageNumber;
+    struct timespec DueAt;
+    int Queued;                 // Waiting for DueAt
+    int Running;
+} conversion_t;
+
+static conversion_t *Conversions = NULL;
+static pthread_mutex_t ConversionLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ConversionCond;
+static pthread_t ConversionThreads[MAX_CONVERSION_THREADS];
+static int ConversionThreadCount = 0;
+static int StopConversions = 0;
+
+static upload_t *Uploads = NULL;
+static pthread_cond_t UploadCond = PTHREAD_COND_INITIALIZER;
+static pthread_t UploadThread;
+static int UploadThreadRunning = 0;
+
+// Upload a JPEG, once the conversion is done, if we have somewhere to send it
+static void
+QueueUpload( const char *FileName )
 {
-    char TargetFile[100], CommandLine[200], *ptr;
+    upload_t *Upload;
+
+    pthread_mutex_lock( &ConversionLock );
+
+    for ( Upload = Uploads; Upload; Upload = Upload->Next )
+    {
+        if ( !strcmp( Upload->FileName, FileName ) )
+            break;
+    }
 
-    strcpy( TargetFile, FileName );
-    ptr = strchr( TargetFile, '.' );
-    if ( ptr && Config.SSDVJpegFolder[0] )
+    if ( ( Upload == NULL ) && ( Upload = calloc( 1, sizeof( *Upload ) ) ) )
     {
-        *ptr = '\0';
-        strcat( TargetFile, ".JPG" );
+        snprintf( Upload->FileName, sizeof( Upload->FileName ), "%s", FileName );
+        Upload->Next = Uploads;
+        Uploads = Upload;
+    }
+
+    if ( Upload )
+    {
+        Upload->Queued = 1;
+        pthread_cond_signal( &UploadCond );
+    }
+
+    pthread_mutex_unlock( &ConversionLock );
+}
+
+static uint64_t
+HashData( const unsigned char *Data, size_t Length )
+{
+    uint64_t Hash = 0xCBF29CE484222325ULL;
+
+    while ( Length-- )
+    {
+        Hash = ( Hash ^ *Data++ ) * 0x100000001B3ULL;
+    }
+
+    return Hash ? Hash : 1;
+}
+
+static size_t
+ReadUpload( char *Buffer, size_t Size, size_t Count, void *Data )
+{
+    upload_buffer_t *Upload = Data;
+    size_t Length;
+
+    Length = Upload->Length - Upload->Position;
+    if ( Length > Size * Count )
+    {
+        Length = Size * Count;
+    }
+
+    memcpy( Buffer, Upload->Data + Upload->Position, Length );
+    Upload->Position += Length;
+
+    return Length;
+}
+
+// Lets curl skip what the server already has when resuming
+static int
+SeekUpload( void *Data, curl_off_t Offset, int Origin )
+{
+    upload_buffer_t *Upload = Data;
+
+    if ( ( Origin != SEEK_SET ) || ( Offset < 0 )
+         || ( ( size_t ) Offset > Upload->Length ) )
+        return CURL_SEEKFUNC_CANTSEEK;
+
+    Upload->Position = Offset;
+
+    return CURL_SEEKFUNC_OK;
+}
+
+// Send one file on the uploader's connection.  *Hash is set to the file's
+// contents; if that's what was last sent, nothing is sent.  If Resume is
+// the hash of an upload that failed part way, an ftp upload carries on
+// from what the server has.  Returns 0 on success.
+static int
+UploadFile( CURL * curl, const char *FileName, uint64_t Uploaded,
+            uint64_t Resume, uint64_t * Hash )
+{
+    char URL[512], curl_error[CURL_ERROR_SIZE];
+    const char *Name, *Host;
+    upload_buffer_t Upload;
+    unsigned char *Data;
+    struct stat st;
+    CURLcode res;
+    FILE *fp;
+    int Result;
+
+    if ( ( fp = fopen( FileName, "rb" ) ) == NULL )
+        return -1;
+
+    if ( ( fstat( fileno( fp ), &st ) < 0 )
+         || ( ( Data = malloc( st.st_size + 1 ) ) == NULL ) )
+    {
+        fclose( fp );
+        return -1;
+    }
+
+    Upload.Data = Data;
+    Upload.Length = fread( Data, 1, st.st_size, fp );
+    Upload.Position = 0;
+    fclose( fp );
+
+    *Hash = HashData( Data, Upload.Length );
+    if ( *Hash == Uploaded )
+    {
+        free( Data );
+        return 0;
+    }
+
+    // As curl -T: a URL ending in '/', or with no path, gets the file name
+    if ( ( Name = strrchr( FileName, '/' ) ) != NULL )
+        Name++;
+    else
+        Name = FileName;
+    Host = strstr( Config.ftpServer, "://" );
+    Host = Host ? Host + 3 : Config.ftpServer;
+    if ( strchr( Host, '/' ) == NULL )
+        snprintf( URL, sizeof( URL ), "%s/%s", Config.ftpServer, Name );
+    else if ( Config.ftpServer[strlen( Config.ftpServer ) - 1] == '/' )
+        snprintf( URL, sizeof( URL ), "%s%s", Config.ftpServer, Name );
+    else
+        snprintf( URL, sizeof( URL ), "%s", Config.ftpServer );
+
+    curl_easy_setopt( curl, CURLOPT_URL, URL );
+    curl_easy_setopt( curl, CURLOPT_USERNAME, Config.ftpUser );
+    curl_easy_setopt( curl, CURLOPT_PASSWORD, Config.ftpPassword );
+    curl_easy_setopt( curl, CURLOPT_UPLOAD, 1L );
+    curl_easy_setopt( curl, CURLOPT_READFUNCTION, ReadUpload );
+    curl_easy_setopt( curl, CURLOPT_READDATA, &Upload );
+    curl_easy_setopt( curl, CURLOPT_SEEKFUNCTION, SeekUpload );
+    curl_easy_setopt( curl, CURLOPT_SEEKDATA, &Upload );
+    curl_easy_setopt( curl, CURLOPT_INFILESIZE_LARGE,
+                      ( curl_off_t ) Upload.Length );
+
+    // -1 asks the server how much it has
+    curl_easy_setopt( curl, CURLOPT_RESUME_FROM_LARGE,
+                      ( ( *Hash == Resume )
+                        && !strncasecmp( URL, "ftp", 3 ) ) ? ( curl_off_t ) -1 :
+                      ( curl_off_t ) 0 );
+
+    curl_easy_setopt( curl, CURLOPT_CONNECTTIMEOUT, 15L );
+    curl_easy_setopt( curl, CURLOPT_LOW_SPEED_LIMIT, 100L );
+    curl_easy_setopt( curl, CURLOPT_LOW_SPEED_TIME, 30L );
+    curl_easy_setopt( curl, CURLOPT_FAILONERROR, 1L );
+    curl_easy_setopt( curl, CURLOPT_ERRORBUFFER, curl_error );
+    curl_easy_setopt( curl, CURLOPT_NOSIGNAL, 1L );
+
+    curl_error[0] = '\0';
+    res = curl_easy_perform( curl );
+
+    Result = 0;
+    if ( res != CURLE_OK )
+    {
+        LogMessage( "Upload of %s failed: %s\n", Name,
+                    curl_error[0] ? curl_error : curl_easy_strerror( res ) );
+        Result = -1;
+    }
+
+    free( Data );
+
+    return Result;
+}
+
+// Uploads go one at a time on the same curl handle, so the server
+// connection (and ftp login) is kept between them
+static void *
+UploadLoop( void *some_void_ptr )
+{
+    upload_t *Upload;
+    uint64_t Uploaded, Resume, Hash;
+    char FileName[300];
+    CURL *curl;
+
+    curl = curl_easy_init(  );
+
+    pthread_mutex_lock( &ConversionLock );
+
+    while ( !StopConversions )
+    {
+        for ( Upload = Uploads; Upload && !Upload->Queued;
+              Upload = Upload->Next )
+        {
+        }
+
+        if ( Upload == NULL )
+        {
+            pthread_cond_wait( &UploadCond, &ConversionLock );
+            continue;
+        }
+
+        Upload->Queued = 0;
+        strcpy( FileName, Upload->FileName );
+        Uploaded = Upload->UploadedHash;
+        Resume = Upload->FailedHash;
+
+        pthread_mutex_unlock( &ConversionLock );
+        Hash = 0;
+        if ( curl && ( UploadFile( curl, FileName, Uploaded, Resume, &Hash ) == 0 ) )
+        {
+            Resume = 0;
+            Uploaded = Hash;
+        }
+        else
+        {
+            Resume = Hash;
+        }
+        pthread_mutex_lock( &ConversionLock );
+
+        Upload->UploadedHash = Uploaded;
+        Upload->FailedHash = Resume;
+    }
+
+    pthread_mutex_unlock( &ConversionLock );
+
+    if ( curl )
+        curl_easy_cleanup( curl );
+
+    return NULL;
+}
 
-        // Now convert the file
-        // LogMessage("Converting %s to %s\n", FileName, TargetFile);
+static void
+ConvertImage( const char *Callsign, int ImageNumber )
+{
+    char SSDVFile[64], JPEGFile[300], CommandLine[1000];
+
+    if ( !Config.SSDVJpegFolder[0] )
+        return;
+
+    snprintf( JPEGFile, sizeof( JPEGFile ), "%s/%s_%d.JPG",
+              Config.SSDVJpegFolder, Callsign, ImageNumber );
+
+    // The decoder can't handle it (e.g. a new packet type), so try the
+    // ssdv program on the saved packets
+    if ( SSDVImageWriteJPEG( Callsign, ImageNumber, JPEGFile ) < 0 )
+    {
+        sprintf( SSDVFile, "/tmp/%s_%d.bin", Callsign, ImageNumber );
+        if ( access( SSDVFile, R_OK ) < 0 )
+            return;
 
-        sprintf( CommandLine,
-                 "ssdv -d /tmp/%s %s/%s 2> /dev/null > /dev/null", FileName,
-                 Config.SSDVJpegFolder, TargetFile );
+        snprintf( CommandLine, sizeof( CommandLine ),
+                  "ssdv -d %s %s 2> /dev/null > /dev/null", SSDVFile,
+                  JPEGFile );
         // LogMessage("COMMAND %s\n", CommandLine);
         system( CommandLine );
+    }
+
+    if ( Config.ftpServer[0] && Config.ftpUser[0] && Config.ftpPassword[0] )
+    {
+        QueueUpload( JPEGFile );
+    }
+}
 
-        if ( Config.ftpServer[0] && Config.ftpUser[0]
-             && Config.ftpPassword[0] )
+// Called by the image assembler for each new packet.  Final means the
+// image is complete (or its last packet is in), so convert it now.
+void
+QueueImageConversion( const char *Callsign, int ImageNumber, int Final )
+{
+    conversion_t *Conversion;
+    struct timespec Now;
+
+    pthread_mutex_lock( &ConversionLock );
+
+    for ( Conversion = Conversions; Conversion;
+          Conversion = Conversion->Next )
+    {
+        if ( ( Conversion->ImageNumber == ImageNumber )
+             && !strcmp( Conversion->Callsign, Callsign ) )
         {
-            // Upload to ftp server
-            sprintf( CommandLine,
-                     "curl -T %s %s -Q \"TYPE I\" --user %s:%s 2> /dev/null > /dev/null",
-                     TargetFile, Config.ftpServer, Config.ftpUser,
-                     Config.ftpPassword );
-            system( CommandLine );
+            break;
         }
     }
+
+    if ( ( Conversion == NULL )
+         && ( Conversion = calloc( 1, sizeof( *Conversion ) ) ) )
+    {
+        strncpy( Conversion->Callsign, Callsign,
+                 sizeof( Conversion->Callsign ) - 1 );
+        Conversion->ImageNumber = ImageNumber;
+        Conversion->Next = Conversions;
+        Conversions = Conversion;
+    }
+
+    if ( Conversion )
+    {
+        clock_gettime( CLOCK_MONOTONIC, &Now );
+
+        if ( Final )
+        {
+            Conversion->DueAt = Now;
+            Conversion->Queued = 1;
+        }
+        else if ( !Conversion->Queued )
+        {
+            // Any more packets in the meantime go in the same conversion
+            Conversion->DueAt = Now;
+            Conversion->DueAt.tv_sec += CONVERT_DELAY_MS / 1000;
+            Conversion->DueAt.tv_nsec += ( CONVERT_DELAY_MS % 1000 ) * 1000000;
+            if ( Conversion->DueAt.tv_nsec >= 1000000000 )
+            {
+                Conversion->DueAt.tv_sec++;
+                Conversion->DueAt.tv_nsec -= 1000000000;
+            }
+            Conversion->Queued = 1;
+        }
+
+        pthread_cond_signal( &ConversionCond );
+    }
+
+    pthread_mutex_unlock( &ConversionLock );
 }
 
+static int
+Before( const struct timespec *a, const struct timespec *b )
+{
+    return ( a->tv_sec < b->tv_sec )
+        || ( ( a->tv_sec == b->tv_sec ) && ( a->tv_nsec < b->tv_nsec ) );
+}
 
-void *
-FTPLoop( void *some_void_ptr )
+static void *
+ConversionLoop( void *some_void_ptr )
 {
-    while ( 1 )
+    conversion_t **Link, *Conversion, *Next;
+    struct timespec Now;
+    char Callsign[7];
+    int ImageNumber;
+
+    pthread_mutex_lock( &ConversionLock );
+
+    while ( !StopConversions )
     {
-        DIR *dp;
-        struct dirent *ep;
-        struct stat st;
-        char *SSDVFolder;
-        char FileName[100], TempName[100];
+        // Earliest conversion not already being done by another thread
+        Next = NULL;
+        for ( Conversion = Conversions; Conversion;
+              Conversion = Conversion->Next )
+        {
+            if ( Conversion->Queued && !Conversion->Running
+                 && ( ( Next == NULL )
+                      || Before( &Conversion->DueAt, &Next->DueAt ) ) )
+            {
+                Next = Conversion;
+            }
+        }
 
-        SSDVFolder = "/tmp";
+        if ( Next == NULL )
+        {
+            pthread_cond_wait( &ConversionCond, &ConversionLock );
+            continue;
+        }
 
-        dp = opendir( SSDVFolder );
-        if ( dp != NULL )
+        clock_gettime( CLOCK_MONOTONIC, &Now );
+        if ( Before( &Now, &Next->DueAt ) )
         {
-            while ( ( ep = readdir( dp ) ) )
+            pthread_cond_timedwait( &ConversionCond, &ConversionLock,
+                                    &Next->DueAt );
+            continue;
+        }
+
+        Next->Queued = 0;
+        Next->Running = 1;
+        strcpy( Callsign, Next->Callsign );
+        ImageNumber = Next->ImageNumber;
+
+        pthread_mutex_unlock( &ConversionLock );
+        ConvertImage( Callsign, ImageNumber );
+        pthread_mutex_lock( &ConversionLock );
+
+        Next->Running = 0;
+
+        // Done with it, unless more packets came in meanwhile
+        if ( !Next->Queued )
+        {
+            for ( Link = &Conversions; *Link != Next; Link = &( *Link )->Next )
             {
-                if ( strstr( ep->d_name, ".bin" ) != NULL )
-                {
-                    sprintf( FileName, "%s/%s", SSDVFolder, ep->d_name );
-                    stat( FileName, &st );
-                    // LogMessage("Age of '%s' is %ld seconds\n", FileName, time(0) - st.st_mtime);
-                    if ( ( time( 0 ) - st.st_mtime ) < 20 )
-                    {
-                        ConvertFile( ep->d_name );
-                    }
-                    else if ( ( time( 0 ) - st.st_mtime ) > 120 )
-                    {
-                        sprintf( TempName, "%s/%s", SSDVFolder, ep->d_name );
-                        // LogMessage("Removing %s\n", TempName);
-                        remove( TempName );
-                    }
-                }
             }
+            *Link = Next->Next;
+            free( Next );
+        }
+    }
+
+    pthread_mutex_unlock( &ConversionLock );
+
+    return NULL;
+}
+
+void
+StartConversionThreads( void )
+{
+    pthread_condattr_t Attributes;
+    long Cores;
+    int i;
+
+    pthread_condattr_init( &Attributes );
+    pthread_condattr_setclock( &Attributes, CLOCK_MONOTONIC );
+    pthread_cond_init( &ConversionCond, &Attributes );
+    pthread_condattr_destroy( &Attributes );
+
+    Cores = sysconf( _SC_NPROCESSORS_ONLN );
+    Cores = Cores < 1 ? 1 : Cores > MAX_CONVERSION_THREADS ?
+        MAX_CONVERSION_THREADS : Cores;
+
+    for ( i = 0; i < Cores; i++ )
+    {
+        if ( pthread_create( &ConversionThreads[i], NULL, ConversionLoop,
+                             NULL ) == 0 )
+        {
+            ConversionThreadCount++;
         }
-        ( void ) closedir( dp );
+    }
 
-        sleep( 5 );
+    if ( pthread_create( &UploadThread, NULL, UploadLoop, NULL ) == 0 )
+    {
+        UploadThreadRunning = 1;
+    }
+}
+
+// Conversions and uploads still waiting are dropped
+void
+StopConversionThreads( void )
+{
+    int i;
+
+    pthread_mutex_lock( &ConversionLock );
+    StopConversions = 1;
+    pthread_cond_broadcast( &ConversionCond );
+    pthread_cond_signal( &UploadCond );
+    pthread_mutex_unlock( &ConversionLock );
+
+    for ( i = 0; i < ConversionThreadCount; i++ )
+    {
+        pthread_join( ConversionThreads[i], NULL );
+    }
+
+    if ( UploadThreadRunning )
+    {
+        pthread_join( UploadThread, NULL );
     }
 }
@@ -1 +1,12 @@
-void *FTPLoop( void *some_void_ptr );
+// Conversion of received SSDV images to JPEG, and upload to an ftp server.
+// The image assembler asks for a conversion when packets arrive; it's done
+// a couple of seconds later (so a burst of packets means one conversion),
+// or straight away once the image's last packet is in.  A small pool of
+// threads does the work and sleeps when there is none.  JPEGs are then
+// uploaded by one thread, through libcurl on a connection kept open
+// between uploads, and only if their contents have changed.
+
+void QueueImageConversion( const char *Callsign, int ImageNumber,
+                           int Final );
+void StartConversionThreads( void );
+void StopConversionThreads( void );
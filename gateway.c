@@ -19,8 +19,6 @@
 #include <curses.h>
 #include <math.h>
 #include <dirent.h>
-#include <wiringPi.h>
-#include <wiringPiSPI.h>
 #include <time.h>
 
 #include "urlencode.h"
@@ -32,92 +30,21 @@
 #include "global.h"
 #include "server.h"
 #include "gateway.h"
+#include "sx127x.h"
+#include "hal.h"
+#include "rxqueue.h"
+#include "regimage.h"
+#include "radio.h"
+#include "telemetry.h"
+#include "crc.h"
+#include "flights.h"
+#include "events.h"
+#include "dedup.h"
+#include "ssdvimage.h"
 
 #define VERSION	"V1.8.0"
 bool run = TRUE;
 
-// RFM98
-uint8_t currentMode = 0x81;
-
-#define REG_FIFO                    0x00
-#define REG_FIFO_ADDR_PTR           0x0D
-#define REG_FIFO_TX_BASE_AD         0x0E
-#define REG_FIFO_RX_BASE_AD         0x0F
-#define REG_RX_NB_BYTES             0x13
-#define REG_OPMODE                  0x01
-#define REG_FIFO_RX_CURRENT_ADDR    0x10
-#define REG_IRQ_FLAGS               0x12
-#define REG_PACKET_SNR				0x19
-#define REG_PACKET_RSSI				0x1A
-#define REG_CURRENT_RSSI			0x1B
-#define REG_DIO_MAPPING_1           0x40
-#define REG_DIO_MAPPING_2           0x41
-#define REG_MODEM_CONFIG            0x1D
-#define REG_MODEM_CONFIG2           0x1E
-#define REG_MODEM_CONFIG3           0x26
-#define REG_PAYLOAD_LENGTH          0x22
-#define REG_IRQ_FLAGS_MASK          0x11
-#define REG_HOP_PERIOD              0x24
-#define REG_FREQ_ERROR				0x28
-#define REG_DETECT_OPT				0x31
-#define	REG_DETECTION_THRESHOLD		0x37
-
-// MODES
-#define RF98_MODE_RX_CONTINUOUS     0x85
-#define RF98_MODE_TX                0x83
-#define RF98_MODE_SLEEP             0x80
-#define RF98_MODE_STANDBY           0x81
-
-#define PAYLOAD_LENGTH              255
-
-// Modem Config 1
-#define EXPLICIT_MODE               0x00
-#define IMPLICIT_MODE               0x01
-
-#define ERROR_CODING_4_5            0x02
-#define ERROR_CODING_4_6            0x04
-#define ERROR_CODING_4_7            0x06
-#define ERROR_CODING_4_8            0x08
-
-#define BANDWIDTH_7K8               0x00
-#define BANDWIDTH_10K4              0x10
-#define BANDWIDTH_15K6              0x20
-#define BANDWIDTH_20K8              0x30
-#define BANDWIDTH_31K25             0x40
-#define BANDWIDTH_41K7              0x50
-#define BANDWIDTH_62K5              0x60
-#define BANDWIDTH_125K              0x70
-#define BANDWIDTH_250K              0x80
-#define BANDWIDTH_500K              0x90
-
-// Modem Config 2
-
-#define SPREADING_6                 0x60
-#define SPREADING_7                 0x70
-#define SPREADING_8                 0x80
-#define SPREADING_9                 0x90
-#define SPREADING_10                0xA0
-#define SPREADING_11                0xB0
-#define SPREADING_12                0xC0
-
-#define CRC_OFF                     0x00
-#define CRC_ON                      0x04
-
-// POWER AMPLIFIER CONFIG
-#define REG_PA_CONFIG               0x09
-#define PA_MAX_BOOST                0x8F
-#define PA_LOW_BOOST                0x81
-#define PA_MED_BOOST                0x8A
-#define PA_MAX_UK                   0x88
-#define PA_OFF_BOOST                0x00
-#define RFO_MIN                     0x00
-
-// LOW NOISE AMPLIFIER
-#define REG_LNA                     0x0C
-#define LNA_MAX_GAIN                0x23    // 0010 0011
-#define LNA_OFF_GAIN                0x00
-#define LNA_LOW_GAIN                0xC0    // 1100 0000
-
 struct TPayload {
     int InUse;
     char Payload[32];
@@ -146,8 +73,26 @@ struct TLoRaMode
 struct TConfig Config;
 struct TPayload Payloads[16];
 
-int LEDCounts[2];
+int LEDCounts[MAX_LORA_DEVICES];
 pthread_mutex_t var = PTHREAD_MUTEX_INITIALIZER;
+WINDOW *LogWindow = NULL;
+
+// Radio state and mailbox for each channel's radio thread
+radio_t Radios[MAX_LORA_DEVICES];
+
+// Received packets and radio events, from radio thread to packet thread
+rx_queue_t RxQueues[MAX_LORA_DEVICES];
+
+// What we last wrote to each chip, and the register images that are
+// applied to it; built by BuildRegisterImages() from LoRaModes[] and the
+// config file
+reg_shadow_t Shadows[MAX_LORA_DEVICES];
+reg_image_t ModeImages[sizeof( LoRaModes ) / sizeof( LoRaModes[0] )];
+reg_image_t DefaultImages[MAX_LORA_DEVICES];
+double DefaultFrequencies[MAX_LORA_DEVICES];
+
+// Last telemetry sentence on each channel, parsed
+telemetry_record_t TelemetryRecords[MAX_LORA_DEVICES];
 
 #pragma pack(1)
 
@@ -212,7 +157,19 @@ writeRegister( int Channel, uint8_t reg, uint8_t val )
 
     data[0] = reg | 0x80;
     data[1] = val;
-    wiringPiSPIDataRW( Channel, data, 2 );
+    HalSPIDataRW( Channel, data, 2 );
+
+    RegShadowNote( &Shadows[Channel], reg, val );
+}
+
+// As writeRegister, but skipped if the chip already has that value
+void
+updateRegister( int Channel, uint8_t reg, uint8_t val )
+{
+    if ( RegShadowNeedsWrite( &Shadows[Channel], reg, val ) )
+    {
+        writeRegister( Channel, reg, val );
+    }
 }
 
 uint8_t
@@ -223,15 +180,41 @@ readRegister( int Channel, uint8_t reg )
 
     data[0] = reg & 0x7F;
     data[1] = 0;
-    wiringPiSPIDataRW( Channel, data, 2 );
+    HalSPIDataRW( Channel, data, 2 );
     val = data[1];
 
     return val;
 }
 
+// Burst read of Count consecutive registers in one SPI transaction (the
+// chip auto-increments the address, except on REG_FIFO where it reads
+// successive FIFO bytes).  Buffer needs Count + 1 bytes - Buffer[0] carries
+// the address - and the values land in Buffer[1] to Buffer[Count].
 void
-LogPacket( int Channel, int8_t SNR, int RSSI, double FreqError, int Bytes,
-           unsigned char MessageType )
+readRegisters( int Channel, uint8_t reg, uint8_t * Buffer, int Count )
+{
+    Buffer[0] = reg & 0x7F;
+    memset( Buffer + 1, 0, Count );
+    HalSPIDataRW( Channel, Buffer, Count + 1 );
+}
+
+// UTC timestamp to the microsecond, e.g. 2016-05-14T12:34:56.123456Z
+void
+FormatTimestamp( char *Buffer, const struct timespec *Time )
+{
+    struct tm tm;
+
+    gmtime_r( &Time->tv_sec, &tm );
+    sprintf( Buffer, "%04d-%02d-%02dT%02d:%02d:%02d.%06ldZ",
+             tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour,
+             tm.tm_min, tm.tm_sec, Time->tv_nsec / 1000 );
+}
+
+// Copy is which copy of a telemetry or SSDV packet this is (0 for other
+// packets), and Best is set if it was heard better than those before
+void
+LogPacket( int Channel, const rx_packet_t * Packet, unsigned int Copy,
+           int Best )
 {
     if ( Config.EnablePacketLogging )
     {
@@ -239,16 +222,31 @@ LogPacket( int Channel, int8_t SNR, int RSSI, double FreqError, int Bytes,
 
         if ( ( fp = fopen( "packets.txt", "at" ) ) != NULL )
         {
-            time_t now;
-            struct tm *tm;
+            struct timespec Now;
+            struct tm tm;
+            char Copies[32];
 
-            now = time( 0 );
-            tm = localtime( &now );
+            // Rx and Mono are when DIO0 fired; Delay is how long it took
+            // to get from there to here
+            clock_gettime( CLOCK_MONOTONIC, &Now );
+            localtime_r( &Packet->RxTime.tv_sec, &tm );
+
+            Copies[0] = '\0';
+            if ( Copy > 0 )
+            {
+                sprintf( Copies, ", Copy %u%s", Copy, Best ? ", Best" : "" );
+            }
 
             fprintf( fp,
-                     "%02d:%02d:%02d - Ch %d, SNR %d, RSSI %d, FreqErr %.1lf, Bytes %d, Type %02Xh\n",
-                     tm->tm_hour, tm->tm_min, tm->tm_sec, Channel, SNR, RSSI,
-                     FreqError, Bytes, MessageType );
+                     "%02d:%02d:%02d - Ch %d, SNR %d, RSSI %d, FreqErr %.1lf, Bytes %d, Type %02Xh, Rx %ld.%09ld, Mono %ld.%09ld, Delay %ldus%s\n",
+                     tm.tm_hour, tm.tm_min, tm.tm_sec, Channel, Packet->SNR,
+                     Packet->RSSI, Packet->FreqError, Packet->Bytes,
+                     ( unsigned char ) Packet->Message[1],
+                     ( long ) Packet->RxTime.tv_sec, Packet->RxTime.tv_nsec,
+                     ( long ) Packet->RxMono.tv_sec, Packet->RxMono.tv_nsec,
+                     ( long ) ( ( Now.tv_sec - Packet->RxMono.tv_sec ) * 1000000L
+                                + ( Now.tv_nsec - Packet->RxMono.tv_nsec ) / 1000 ),
+                     Copies );
 
             fclose( fp );
         }
@@ -281,16 +279,15 @@ LogTelemetryPacket( char *Telemetry )
 void
 LogMessage( const char *format, ... )
 {
-    static WINDOW *Window = NULL;
     char Buffer[512];
 
     pthread_mutex_lock( &var ); // lock the critical section
 
-    if ( Window == NULL )
+    if ( LogWindow == NULL )
     {
         // Window = newwin(25, 30, 0, 50);
-        Window = newwin( LINES - 16, COLS, 16, 0 );
-        scrollok( Window, TRUE );
+        LogWindow = newwin( LINES - 16, COLS, 16, 0 );
+        scrollok( LogWindow, TRUE );
     }
 
     va_list args;
@@ -308,9 +305,9 @@ LogMessage( const char *format, ... )
         Buffer[COLS] = 0;
     }
 
-    waddstr( Window, Buffer );
+    waddstr( LogWindow, Buffer );
 
-    wrefresh( Window );
+    wrefresh( LogWindow );
 
     pthread_mutex_unlock( &var );   // unlock once you are done
 
@@ -330,102 +327,185 @@ ChannelPrintf( int Channel, int row, int column, const char *format, ... )
 
     va_end( args );
 
-    mvwaddstr( Config.LoRaDevices[Channel].Window, row, column, Buffer );
+    // No window if the terminal is too small to show this channel
+    if ( Config.LoRaDevices[Channel].Window )
+    {
+        mvwaddstr( Config.LoRaDevices[Channel].Window, row, column, Buffer );
 
-    wrefresh( Config.LoRaDevices[Channel].Window );
+        wrefresh( Config.LoRaDevices[Channel].Window );
+    }
 
     pthread_mutex_unlock( &var );   // unlock once you are done
 
 }
 
-void
-setMode( int Channel, uint8_t newMode )
+// OPMODE value (LoRa mode) for each radio state
+static const uint8_t StateOpModes[] = {
+    [RADIO_SLEEP] = RF98_MODE_SLEEP,
+    [RADIO_STANDBY] = RF98_MODE_STANDBY,
+    [RADIO_RX] = RF98_MODE_RX_CONTINUOUS,
+    [RADIO_TX] = RF98_MODE_TX,
+    [RADIO_CAD] = RF98_MODE_CAD
+};
+
+// ModeReady (DIO5) normally follows a mode change within a millisecond or
+// so; a module that has browned out may never assert it
+#define MODE_READY_TIMEOUT_US   100000
+
+// Wait for DIO5, polling with a growing sleep in between so that a slow
+// transition doesn't tie up a core.  Returns the time taken in us, or -1 if
+// the chip didn't become ready in time.
+long
+WaitForModeReady( int Channel )
 {
-    if ( newMode == currentMode )
-        return;
+    struct timespec Start, Now, Pause;
+    long Elapsed, PauseUS;
+
+    clock_gettime( CLOCK_MONOTONIC, &Start );
+    PauseUS = 10;
 
-    switch ( newMode )
+    while ( 1 )
     {
-        case RF98_MODE_TX:
-            writeRegister( Channel, REG_LNA, LNA_OFF_GAIN );    // TURN LNA OFF FOR TRANSMITT
-            writeRegister( Channel, REG_PA_CONFIG, Config.LoRaDevices[Channel].Power ); // PA_MAX_UK
-            writeRegister( Channel, REG_OPMODE, newMode );
-            currentMode = newMode;
+        clock_gettime( CLOCK_MONOTONIC, &Now );
+        Elapsed = ( Now.tv_sec - Start.tv_sec ) * 1000000L +
+            ( Now.tv_nsec - Start.tv_nsec ) / 1000;
+
+        if ( HalDigitalRead( Config.LoRaDevices[Channel].DIO5 ) )
+        {
+            return Elapsed;
+        }
+
+        if ( Elapsed > MODE_READY_TIMEOUT_US )
+        {
+            return -1;
+        }
+
+        Pause.tv_sec = 0;
+        Pause.tv_nsec = PauseUS * 1000;
+        nanosleep( &Pause, NULL );
+
+        if ( PauseUS < 1000 )
+        {
+            PauseUS *= 2;
+        }
+    }
+}
+
+// Called by the channel's radio thread only (or during setup, before that
+// thread starts), so the channel's state needs no locking.  Returns -1 if
+// the chip didn't reach the new mode, in which case the radio thread will
+// reset the channel.
+int
+setMode( int Channel, radio_state_t NewState )
+{
+    radio_t *Radio;
+    long Latency;
+
+    Radio = &Radios[Channel];
+
+    if ( NewState == Radio->State )
+        return 0;
+
+    switch ( NewState )
+    {
+        case RADIO_TX:
+            // TX and CAD are only entered from standby
+            if ( setMode( Channel, RADIO_STANDBY ) < 0 )
+                return -1;
+            updateRegister( Channel, REG_LNA, LNA_OFF_GAIN );   // TURN LNA OFF FOR TRANSMITT
+            updateRegister( Channel, REG_PA_CONFIG, Config.LoRaDevices[Channel].Power );    // PA_MAX_UK
             break;
-        case RF98_MODE_RX_CONTINUOUS:
-            writeRegister( Channel, REG_PA_CONFIG, PA_OFF_BOOST );  // TURN PA OFF FOR RECIEVE??
-            writeRegister( Channel, REG_LNA, LNA_MAX_GAIN );    // MAX GAIN FOR RECEIVE
-            writeRegister( Channel, REG_OPMODE, newMode );
-            currentMode = newMode;
-            // LogMessage("Changing to Receive Continuous Mode\n");
+        case RADIO_CAD:
+            if ( setMode( Channel, RADIO_STANDBY ) < 0 )
+                return -1;
             break;
-        case RF98_MODE_SLEEP:
-            writeRegister( Channel, REG_OPMODE, newMode );
-            currentMode = newMode;
-            // LogMessage("Changing to Sleep Mode\n"); 
+        case RADIO_RX:
+            updateRegister( Channel, REG_PA_CONFIG, PA_OFF_BOOST ); // TURN PA OFF FOR RECIEVE??
+            updateRegister( Channel, REG_LNA, LNA_MAX_GAIN );   // MAX GAIN FOR RECEIVE
             break;
-        case RF98_MODE_STANDBY:
-            writeRegister( Channel, REG_OPMODE, newMode );
-            currentMode = newMode;
-            // LogMessage("Changing to Standby Mode\n");
+        case RADIO_SLEEP:
+        case RADIO_STANDBY:
             break;
         default:
-            return;
+            return -1;
     }
 
-    if ( newMode != RF98_MODE_SLEEP )
+    writeRegister( Channel, REG_OPMODE, StateOpModes[NewState] );
+
+    if ( NewState != RADIO_SLEEP )
     {
-        while ( digitalRead( Config.LoRaDevices[Channel].DIO5 ) == 0 )
+        if ( ( Latency = WaitForModeReady( Channel ) ) < 0 )
         {
+            Radio->ModeTimeouts++;
+            Radio->ResetPending = 1;
+            Radio->State = RADIO_UNKNOWN;
+            return -1;
         }
-        // delay(1);
+
+        RadioModeReady( Radio, NewState, Latency );
     }
 
+    Radio->State = NewState;
+
     // LogMessage("Mode Change Done\n");
-    return;
+    return 0;
 }
 
 void
-setFrequency( int Channel, double Frequency )
+BuildFrequencyImage( reg_image_t * Image, double Frequency )
 {
     unsigned long FrequencyValue;
-    char FrequencyString[10];
-
-    // Format frequency as xxx.xxx.x Mhz
-    sprintf( FrequencyString, "%8.4lf ", Frequency );
-    FrequencyString[8] = FrequencyString[7];
-    FrequencyString[7] = '.';
 
     FrequencyValue = ( unsigned long ) ( Frequency * 7110656 / 434 );
 
-    writeRegister( Channel, 0x06, ( FrequencyValue >> 16 ) & 0xFF );    // Set frequency
-    writeRegister( Channel, 0x07, ( FrequencyValue >> 8 ) & 0xFF );
-    writeRegister( Channel, 0x08, FrequencyValue & 0xFF );
+    RegImageSet( Image, REG_FRF_MSB, ( FrequencyValue >> 16 ) & 0xFF, 0xFF );
+    RegImageSet( Image, REG_FRF_MID, ( FrequencyValue >> 8 ) & 0xFF, 0xFF );
+    RegImageSet( Image, REG_FRF_LSB, FrequencyValue & 0xFF, 0xFF );
+}
+
+void
+setFrequency( int Channel, double Frequency )
+{
+    reg_image_t Image;
+
+    RegImageClear( &Image );
+    BuildFrequencyImage( &Image, Frequency );
+    RegImageApply( Channel, &Shadows[Channel], &Image );
 
     Config.LoRaDevices[Channel].activeFreq = Frequency;
 
     // LogMessage("Set Frequency to %lf\n", Frequency);
+}
+
+void
+ShowFrequency( int Channel )
+{
+    char FrequencyString[10];
+
+    // Format frequency as xxx.xxx.x Mhz
+    sprintf( FrequencyString, "%8.4lf ",
+             Config.LoRaDevices[Channel].activeFreq );
+    FrequencyString[8] = FrequencyString[7];
+    FrequencyString[7] = '.';
 
     ChannelPrintf( Channel, 1, 1, "Channel %d %s MHz ", Channel,
                    FrequencyString );
 }
 
-void
+// The default frequency is set along with the other default parameters, by
+// SetDefaultLoRaParameters()
+int
 setLoRaMode( int Channel )
 {
-    double Frequency;
-
     // LogMessage("Setting LoRa Mode\n");
-    setMode( Channel, RF98_MODE_SLEEP );
-    writeRegister( Channel, REG_OPMODE, 0x80 );
+    if ( setMode( Channel, RADIO_SLEEP ) < 0 )
+        return -1;
 
-    setMode( Channel, RF98_MODE_SLEEP );
+    // LongRangeMode can only be changed in sleep mode
+    writeRegister( Channel, REG_OPMODE, 0x80 );
+    Radios[Channel].State = RADIO_SLEEP;
 
-    if ( sscanf( Config.LoRaDevices[Channel].Frequency, "%lf", &Frequency ) )
-    {
-        // LogMessage("Set Default Frequency\n");
-        setFrequency( Channel, Frequency );
-    }
+    return 0;
 }
 
 char *
@@ -454,20 +534,75 @@ BandwidthString( int Bandwidth )
     return "??k";
 }
 
+void
+BuildModemImage( reg_image_t * Image, int ImplicitOrExplicit,
+                 int ErrorCoding, int Bandwidth, int SpreadingFactor,
+                 int LowDataRateOptimize )
+{
+    RegImageSet( Image, REG_MODEM_CONFIG,
+                 ImplicitOrExplicit | ErrorCoding | Bandwidth, 0xFF );
+    RegImageSet( Image, REG_MODEM_CONFIG2, SpreadingFactor | CRC_ON, 0xFF );
+    RegImageSet( Image, REG_MODEM_CONFIG3, 0x04 | LowDataRateOptimize, 0xFF );  // 0x04: AGC sets LNA gain
+    RegImageSet( Image, REG_DETECT_OPT, ( SpreadingFactor == SPREADING_6 ) ? 0x05 : 0x03, 0x07 );  // 0x05 For SF6; 0x03 otherwise
+    RegImageSet( Image, REG_DETECTION_THRESHOLD, ( SpreadingFactor == SPREADING_6 ) ? 0x0C : 0x0A, 0xFF );  // 0x0C for SF6, 0x0A otherwise
+}
+
+void
+BuildRegisterImages( void )
+{
+    int Channel, Mode;
+
+    for ( Mode = 0; Mode < sizeof( LoRaModes ) / sizeof( LoRaModes[0] );
+          Mode++ )
+    {
+        RegImageClear( &ModeImages[Mode] );
+        BuildModemImage( &ModeImages[Mode], LoRaModes[Mode].ImplicitOrExplicit,
+                         LoRaModes[Mode].ErrorCoding,
+                         LoRaModes[Mode].Bandwidth,
+                         LoRaModes[Mode].SpreadingFactor,
+                         LoRaModes[Mode].LowDataRateOptimize );
+    }
+
+    for ( Channel = 0; Channel < Config.LoRaDeviceCount; Channel++ )
+    {
+        RegImageClear( &DefaultImages[Channel] );
+        BuildModemImage( &DefaultImages[Channel],
+                         Config.LoRaDevices[Channel].ImplicitOrExplicit,
+                         Config.LoRaDevices[Channel].ErrorCoding,
+                         Config.LoRaDevices[Channel].Bandwidth,
+                         Config.LoRaDevices[Channel].SpreadingFactor,
+                         Config.LoRaDevices[Channel].LowDataRateOptimize );
+
+        DefaultFrequencies[Channel] = 0;
+        if ( sscanf( Config.LoRaDevices[Channel].Frequency, "%lf",
+                     &DefaultFrequencies[Channel] ) == 1 )
+        {
+            BuildFrequencyImage( &DefaultImages[Channel],
+                                 DefaultFrequencies[Channel] );
+        }
+    }
+}
+
 void
 SetLoRaParameters( int Channel, int ImplicitOrExplicit, int ErrorCoding,
                    int Bandwidth, int SpreadingFactor,
                    int LowDataRateOptimize )
 {
-    writeRegister( Channel, REG_MODEM_CONFIG,
-                   ImplicitOrExplicit | ErrorCoding | Bandwidth );
-    writeRegister( Channel, REG_MODEM_CONFIG2, SpreadingFactor | CRC_ON );
-    writeRegister( Channel, REG_MODEM_CONFIG3, 0x04 | LowDataRateOptimize );    // 0x04: AGC sets LNA gain
-    writeRegister( Channel, REG_DETECT_OPT, ( readRegister( Channel, REG_DETECT_OPT ) & 0xF8 ) | ( ( SpreadingFactor == SPREADING_6 ) ? 0x05 : 0x03 ) );    // 0x05 For SF6; 0x03 otherwise
-    writeRegister( Channel, REG_DETECTION_THRESHOLD, ( SpreadingFactor == SPREADING_6 ) ? 0x0C : 0x0A );    // 0x0C for SF6, 0x0A otherwise
+    reg_image_t Image;
+
+    RegImageClear( &Image );
+    BuildModemImage( &Image, ImplicitOrExplicit, ErrorCoding, Bandwidth,
+                     SpreadingFactor, LowDataRateOptimize );
+    RegImageApply( Channel, &Shadows[Channel], &Image );
 
     Config.LoRaDevices[Channel].CurrentBandwidth = Bandwidth;
+}
 
+void
+ShowLoRaParameters( int Channel, int ImplicitOrExplicit, int ErrorCoding,
+                    int Bandwidth, int SpreadingFactor,
+                    int LowDataRateOptimize )
+{
     ChannelPrintf( Channel, 2, 1, "%s, %s, SF%d, EC4:%d %s",
                    ImplicitOrExplicit ==
                    IMPLICIT_MODE ? "Implicit" : "Explicit",
@@ -481,41 +616,54 @@ SetDefaultLoRaParameters( int Channel )
 {
     // LogMessage("Set Default Parameters\n");
 
-    SetLoRaParameters( Channel,
-                       Config.LoRaDevices[Channel].ImplicitOrExplicit,
-                       Config.LoRaDevices[Channel].ErrorCoding,
-                       Config.LoRaDevices[Channel].Bandwidth,
-                       Config.LoRaDevices[Channel].SpreadingFactor,
-                       Config.LoRaDevices[Channel].LowDataRateOptimize );
+    // Default frequency and modem settings in as few transfers as possible
+    RegImageApply( Channel, &Shadows[Channel], &DefaultImages[Channel] );
+
+    if ( DefaultFrequencies[Channel] > 0 )
+    {
+        Config.LoRaDevices[Channel].activeFreq = DefaultFrequencies[Channel];
+    }
+    Config.LoRaDevices[Channel].CurrentBandwidth =
+        Config.LoRaDevices[Channel].Bandwidth;
+}
+
+void
+ShowDefaultLoRaParameters( int Channel )
+{
+    ShowLoRaParameters( Channel,
+                        Config.LoRaDevices[Channel].ImplicitOrExplicit,
+                        Config.LoRaDevices[Channel].ErrorCoding,
+                        Config.LoRaDevices[Channel].Bandwidth,
+                        Config.LoRaDevices[Channel].SpreadingFactor,
+                        Config.LoRaDevices[Channel].LowDataRateOptimize );
 }
 
 /////////////////////////////////////
 //    Method:   Setup to receive continuously
 //////////////////////////////////////
-void
+int
 startReceiving( int Channel )
 {
-    writeRegister( Channel, REG_DIO_MAPPING_1, 0x00 );  // 00 00 00 00 maps DIO0 to RxDone
+    updateRegister( Channel, REG_DIO_MAPPING_1, 0x00 ); // 00 00 00 00 maps DIO0 to RxDone
 
-    writeRegister( Channel, REG_PAYLOAD_LENGTH, 255 );
-    writeRegister( Channel, REG_RX_NB_BYTES, 255 );
+    updateRegister( Channel, REG_PAYLOAD_LENGTH, 255 );
 
-    writeRegister( Channel, REG_FIFO_RX_BASE_AD, 0 );
+    updateRegister( Channel, REG_FIFO_RX_BASE_AD, 0 );
     writeRegister( Channel, REG_FIFO_ADDR_PTR, 0 );
 
     // Setup Receive Continous Mode
-    setMode( Channel, RF98_MODE_RX_CONTINUOUS );
+    return setMode( Channel, RADIO_RX );
 }
 
-void ReTune( int Channel, double FreqShift )
+int ReTune( int Channel, double FreqShift )
 {
-    setMode( Channel, RF98_MODE_SLEEP );
-    LogMessage( "Retune by %lf kHz\n", FreqShift * 1000 );
+    if ( setMode( Channel, RADIO_SLEEP ) < 0 )
+        return -1;
     setFrequency( Channel, Config.LoRaDevices[Channel].activeFreq + FreqShift );
-    startReceiving( Channel );
+    return startReceiving( Channel );
 }
 
-void SendLoRaData(int Channel, char *buffer, int Length)
+int SendLoRaData(int Channel, char *buffer, int Length)
 {
     unsigned char data[257];
     int i;
@@ -523,7 +671,6 @@ void SendLoRaData(int Channel, char *buffer, int Length)
 	// Change frequency for the uplink ?
 	if (Config.LoRaDevices[Channel].UplinkFrequency > 0)
 	{
-		LogMessage("Change frequency to %.3lfMHz\n", Config.LoRaDevices[Channel].UplinkFrequency);
         setFrequency(Channel, Config.LoRaDevices[Channel].UplinkFrequency);
 	}
 	
@@ -534,24 +681,18 @@ void SendLoRaData(int Channel, char *buffer, int Length)
 		
 		UplinkMode = Config.LoRaDevices[Channel].UplinkMode;
 		
-		LogMessage("Change LoRa mode to %d\n", Config.LoRaDevices[Channel].UplinkMode);
-		
-        SetLoRaParameters(Channel,
-						  LoRaModes[UplinkMode].ImplicitOrExplicit,
-						  LoRaModes[UplinkMode].ErrorCoding,
-						  LoRaModes[UplinkMode].Bandwidth,
-						  LoRaModes[UplinkMode].SpreadingFactor,
-						  0);
+        RegImageApply(Channel, &Shadows[Channel], &ModeImages[UplinkMode]);
+        Config.LoRaDevices[Channel].CurrentBandwidth = LoRaModes[UplinkMode].Bandwidth;
 	}
 	
-    LogMessage( "LoRa Channel %d Sending %d bytes\n", Channel, Length );
-    Config.LoRaDevices[Channel].Sending = 1;
+    if ( setMode( Channel, RADIO_STANDBY ) < 0 )
+        return -1;
 
-    setMode( Channel, RF98_MODE_STANDBY );
+    Config.LoRaDevices[Channel].Sending = 1;
 
-    writeRegister( Channel, REG_DIO_MAPPING_1, 0x40 );  // 01 00 00 00 maps DIO0 to TxDone
+    updateRegister( Channel, REG_DIO_MAPPING_1, 0x40 ); // 01 00 00 00 maps DIO0 to TxDone
 
-    writeRegister( Channel, REG_FIFO_TX_BASE_AD, 0x00 );    // Update the address ptr to the current tx base address
+    updateRegister( Channel, REG_FIFO_TX_BASE_AD, 0x00 );   // Update the address ptr to the current tx base address
     writeRegister( Channel, REG_FIFO_ADDR_PTR, 0x00 );
 
     data[0] = REG_FIFO | 0x80;
@@ -559,13 +700,72 @@ void SendLoRaData(int Channel, char *buffer, int Length)
     {
         data[i + 1] = buffer[i];
     }
-    wiringPiSPIDataRW( Channel, data, Length + 1 );
+    HalSPIDataRW( Channel, data, Length + 1 );
 
     // Set the length. For implicit mode, since the length needs to match what the receiver expects, we have to set a value which is 255 for an SSDV packet
     writeRegister( Channel, REG_PAYLOAD_LENGTH, Length );
 
     // go into transmit mode
-    setMode( Channel, RF98_MODE_TX );
+    return setMode( Channel, RADIO_TX );
+}
+
+// Any thread: ask the channel's radio thread to send a packet, either now
+// or (if SendAt isn't NULL) at that CLOCK_REALTIME time
+void
+QueueLoRaData( int Channel, char *buffer, int Length,
+               const struct timespec *SendAt )
+{
+    radio_command_t Command;
+
+    // The payload length register is 8 bits
+    if ( ( Length <= 0 ) || ( Length > 255 )
+         || ( Length > sizeof( Command.Data ) ) )
+    {
+        LogMessage( "Ch%d: Can't send %d bytes, packet not sent\n", Channel,
+                    Length );
+        return;
+    }
+
+    Command.Type = RADIO_CMD_SEND;
+    Command.Length = Length;
+    memcpy( Command.Data, buffer, Length );
+    if ( SendAt )
+    {
+        Command.SendAt = *SendAt;
+    }
+    else
+    {
+        Command.SendAt.tv_sec = 0;
+        Command.SendAt.tv_nsec = 0;
+    }
+
+	if (Config.LoRaDevices[Channel].UplinkFrequency > 0)
+	{
+		LogMessage("Change frequency to %.3lfMHz\n", Config.LoRaDevices[Channel].UplinkFrequency);
+	}
+	
+	if (Config.LoRaDevices[Channel].UplinkMode >= 0)
+	{
+		int UplinkMode;
+		
+		UplinkMode = Config.LoRaDevices[Channel].UplinkMode;
+		
+		LogMessage("Change LoRa mode to %d\n", Config.LoRaDevices[Channel].UplinkMode);
+		
+        ShowLoRaParameters(Channel,
+						   LoRaModes[UplinkMode].ImplicitOrExplicit,
+						   LoRaModes[UplinkMode].ErrorCoding,
+						   LoRaModes[UplinkMode].Bandwidth,
+						   LoRaModes[UplinkMode].SpreadingFactor,
+						   LoRaModes[UplinkMode].LowDataRateOptimize);
+	}
+	
+    LogMessage( "LoRa Channel %d Sending %d bytes\n", Channel, Length );
+
+    if ( !RadioPost( &Radios[Channel], &Command ) )
+    {
+        LogMessage( "Ch%d: Radio busy, packet not sent\n", Channel );
+    }
 }
 
 void
@@ -593,12 +793,25 @@ ShowPacketCounts( int Channel )
                                                              LastSSDVPacketAt )
                        : 0 );
 
-        ChannelPrintf( Channel, 9, 1, "Bad CRC = %d Bad Type = %d",
+        ChannelPrintf( Channel, 8, 29, "FEC %u/%u ",
+                       Config.LoRaDevices[Channel].SSDVFixedCount,
+                       Config.LoRaDevices[Channel].SSDVBadCount );
+
+        ChannelPrintf( Channel, 9, 1, "Bad CRC = %d Sum = %d Type = %d",
                        Config.LoRaDevices[Channel].BadCRCCount,
+                       Config.LoRaDevices[Channel].BadChecksumCount,
                        Config.LoRaDevices[Channel].UnknownCount );
 
         ChannelPrintf( Channel, 6, 16, "SSDV %d ",
                        Config.LoRaDevices[Channel].SSDVCount );
+        ChannelPrintf( Channel, 6, 26, "Dup %d ",
+                       Config.LoRaDevices[Channel].DuplicateCount );
+
+        ChannelPrintf( Channel, 13, 1, "Ovf %-3u RX %4uus TX %4uus Rst %u",
+                       RxQueues[Channel].Overflows,
+                       Radios[Channel].ModeReadyUS[RADIO_RX],
+                       Radios[Channel].ModeReadyUS[RADIO_TX],
+                       Radios[Channel].Resets );
     }
 }
 
@@ -615,6 +828,7 @@ ProcessCallingMessage( int Channel, char *Message )
     double Frequency;
     int ImplicitOrExplicit, ErrorCoding, Bandwidth, SpreadingFactor,
         LowDataRateOptimize;
+    radio_command_t Command;
 
     ChannelPrintf( Channel, 3, 1, "Calling message %d bytes ",
                    strlen( Message ) );
@@ -640,16 +854,19 @@ ProcessCallingMessage( int Channel, char *Message )
         LogMessage( "Ch %d: Calling message, new frequency %7.3lf\n", Channel,
                     Frequency );
 
-        // Decoded OK
-        setMode( Channel, RF98_MODE_SLEEP );
-
-        // setFrequency(Channel, Config.LoRaDevices[Channel].activeFreq + );
-        setFrequency( Channel, Frequency );
+        // Decoded OK; the radio thread switches over and reports back with
+        // a PACKET_RETUNED event
+        Command.Type = RADIO_CMD_SET_MODEM;
+        Command.Frequency = Frequency;
+        Command.ImplicitOrExplicit = ImplicitOrExplicit;
+        Command.ErrorCoding = ErrorCoding;
+        Command.Bandwidth = Bandwidth;
+        Command.SpreadingFactor = SpreadingFactor;
+        Command.LowDataRateOptimize = LowDataRateOptimize;
+        RadioPost( &Radios[Channel], &Command );
 
-        SetLoRaParameters( Channel, ImplicitOrExplicit, ErrorCoding,
-                           Bandwidth, SpreadingFactor, LowDataRateOptimize );
-
-        setMode( Channel, RF98_MODE_RX_CONTINUOUS );
+        ShowLoRaParameters( Channel, ImplicitOrExplicit, ErrorCoding,
+                            Bandwidth, SpreadingFactor, LowDataRateOptimize );
 
         Config.LoRaDevices[Channel].InCallingMode = 1;
 
@@ -752,94 +969,156 @@ UploadListenerTelemetry( char *callsign, float gps_lat, float gps_lon,
 }
 
 
+// Update the flight table from the channel's latest telemetry, and show
+// where that payload is now
 void
-DoPositionCalcs( Channel )
+DoPositionCalcs( int Channel, time_t At )
 {
-    unsigned long Now;
-    struct tm tm;
-    float Climb, Period;
-
-    strptime( Config.LoRaDevices[Channel].Time, "%H:%M:%S", &tm );
-    Now = tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec;
+    flight_t Flight;
 
-    if ( ( Config.LoRaDevices[Channel].LastPositionAt > 0 )
-         && ( Now > Config.LoRaDevices[Channel].LastPositionAt ) )
+    if ( FlightUpdate( Channel, &TelemetryRecords[Channel].Values, At,
+                       &Flight ) )
     {
-        Climb =
-            ( float ) Config.LoRaDevices[Channel].Altitude -
-            ( float ) Config.LoRaDevices[Channel].PreviousAltitude;
-        Period =
-            ( float ) Now -
-            ( float ) Config.LoRaDevices[Channel].LastPositionAt;
-        Config.LoRaDevices[Channel].AscentRate = Climb / Period;
+        ChannelPrintf( Channel, 4, 1, "%8.5lf, %8.5lf, %05u   ",
+                       Flight.Telemetry.Latitude, Flight.Telemetry.Longitude,
+                       Flight.Telemetry.Altitude );
     }
-    else
+}
+
+
+// Send a telemetry sentence to habitat
+void
+QueueTelemetryUpload( int Channel, const char *Sentence,
+                      const struct timespec *RxTime )
+{
+    if ( Config.EnableHabitat )
     {
-        Config.LoRaDevices[Channel].AscentRate = 0;
-    }
 
-    Config.LoRaDevices[Channel].PreviousAltitude =
-        Config.LoRaDevices[Channel].Altitude;
-    Config.LoRaDevices[Channel].LastPositionAt = Now;
+        // Create a telemetry packet
+        telemetry_t t;
+        t.Channel = Channel;
+        t.Packet_Number = habitate_telem_packets;
+        t.RxTime = *RxTime;
+        memcpy( t.Telemetry, Sentence, strlen( Sentence ) + 1 );
 
-    ChannelPrintf( Channel, 4, 1, "%8.5lf, %8.5lf, %05u   ",
-                   Config.LoRaDevices[Channel].Latitude,
-                   Config.LoRaDevices[Channel].Longitude,
-                   Config.LoRaDevices[Channel].Altitude );
+        // Add the telemetry packet to the pipe
+        int result = write( telem_pipe_fd[1], &t, sizeof( t ) );
+        if ( result == -1 )
+        {
+            printf( "Error writing to the telemetry pipe\n" );
+            exit( 1 );
+        }
+        if ( result == 0 )
+        {
+            LogMessage( "Nothing written to telemetry pipe \n" );
+        }
+        if ( result > 1 )
+        {
+            htsv.packet_count++;
+        }
+    }
 }
 
-
 void
 ProcessLine( int Channel, char *Line )
 {
-    int Satellites;
-    float TempInt, TempExt;
-
-    Config.LoRaDevices[Channel].FlightMode = -1;
-
-    if ( Config.EnableDev )
-    {
-        sscanf( Line + 2,
-                "%15[^,],%u,%8[^,],%lf,%lf,%u,%d,%d,%d,%f,%f,%lf,%lf,%lf,%lf,%d,%d,%d,%lf,%d,%d,%d,%d,%lf,%d",
-                ( Config.LoRaDevices[Channel].Payload ),
-                &( Config.LoRaDevices[Channel].Counter ),
-                ( Config.LoRaDevices[Channel].Time ),
-                &( Config.LoRaDevices[Channel].Latitude ),
-                &( Config.LoRaDevices[Channel].Longitude ),
-                &( Config.LoRaDevices[Channel].Altitude ),
-                &( Config.LoRaDevices[Channel].Speed ),
-                &( Config.LoRaDevices[Channel].Heading ), &Satellites,
-                &TempInt, &TempExt, &( Config.LoRaDevices[Channel].cda ),
-                &( Config.LoRaDevices[Channel].PredictedLatitude ),
-                &( Config.LoRaDevices[Channel].PredictedLongitude ),
-                &( Config.LoRaDevices[Channel].PredictedLandingSpeed ),
-                &( Config.LoRaDevices[Channel].PredictedTime ),
-                &( Config.LoRaDevices[Channel].CompassActual ),
-                &( Config.LoRaDevices[Channel].CompassTarget ),
-                &( Config.LoRaDevices[Channel].AirSpeed ),
-                &( Config.LoRaDevices[Channel].AirDirection ),
-                &( Config.LoRaDevices[Channel].ServoLeft ),
-                &( Config.LoRaDevices[Channel].ServoRight ),
-                &( Config.LoRaDevices[Channel].ServoTime ),
-                &( Config.LoRaDevices[Channel].GlideRatio ),
-                &( Config.LoRaDevices[Channel].FlightMode ) );
+    TelemetryParse( Line, &TelemetryRecords[Channel],
+                    Config.EnableDev ? TELEMETRY_DEV_FIELDS :
+                    TELEMETRY_BASIC_FIELDS );
+}
+
+// Name for a binary payload ID.  Unknown IDs still need distinct names for
+// the flight table.
+static void
+BinaryPayloadName( int ID, char *Payload, size_t Size )
+{
+    if ( Payloads[ID].InUse )
+    {
+        snprintf( Payload, Size, "%s", Payloads[ID].Payload );
     }
     else
     {
-        sscanf( Line + 2, "%15[^,],%u,%8[^,],%lf,%lf,%u",
-                ( Config.LoRaDevices[Channel].Payload ),
-                &( Config.LoRaDevices[Channel].Counter ),
-                ( Config.LoRaDevices[Channel].Time ),
-                &( Config.LoRaDevices[Channel].Latitude ),
-                &( Config.LoRaDevices[Channel].Longitude ),
-                &( Config.LoRaDevices[Channel].Altitude ) );
+        snprintf( Payload, Size, "Binary%d", ID );
+    }
+}
+
+// Binary telemetry.  The top 4 bits of the first byte are 0xC, and the
+// bottom 4 are the payload ID, which payload_<ID>.txt maps to a name.
+// The fields are decoded straight into the telemetry record, and an
+// equivalent sentence is made for habitat and the logs.
+void
+ProcessBinaryTelemetry( int Channel, char *Message, int Bytes,
+                        const struct timespec *RxTime )
+{
+    struct TBinaryPacket Binary;
+    telemetry_record_t *Record;
+    telemetry_values_t *Values;
+    char *Sentence;
+    long Seconds;
+    int ID, Length;
+
+    if ( Bytes < sizeof( Binary ) )
+    {
+        LogMessage( "Ch%d: Binary telemetry too short (%d bytes)\n",
+                    Channel, Bytes );
+        Config.LoRaDevices[Channel].UnknownCount++;
+        return;
+    }
+
+    // Little-endian, as sent by the trackers
+    memcpy( &Binary, Message, sizeof( Binary ) );
+    ID = Binary.PayloadIDs & 0x0F;
+    Seconds = ( Binary.BiSeconds * 2L ) % 86400;
+
+    ChannelPrintf( Channel, 3, 1, "Binary Telemetry %d bytes ", Bytes );
+
+    Record = &TelemetryRecords[Channel];
+    memset( Record, 0, sizeof( *Record ) );
+    Values = &Record->Values;
+
+    BinaryPayloadName( ID, Values->Payload, sizeof( Values->Payload ) );
+    Values->Counter = Binary.Counter;
+    Values->Seconds = Seconds;
+    sprintf( Values->Time, "%02ld:%02ld:%02ld", Seconds / 3600,
+             ( Seconds / 60 ) % 60, Seconds % 60 );
+    Values->Latitude = Binary.Latitude;
+    Values->Longitude = Binary.Longitude;
+    Values->Altitude = Binary.Altitude;
+    Values->FlightMode = -1;
+
+    Sentence = Config.LoRaDevices[Channel].Telemetry;
+    Length = sprintf( Sentence, "$$%s,%u,%s,%.5lf,%.5lf,%u", Values->Payload,
+                      Values->Counter, Values->Time, Values->Latitude,
+                      Values->Longitude, Values->Altitude );
+    sprintf( Sentence + Length, "*%04X",
+             CRC16Update( 0xFFFF, ( unsigned char * ) Sentence + 2,
+                          Length - 2 ) );
+
+    habitate_telem_packets++;
+    LogTelemetryPacket( Sentence );
+
+    // Without a payload file we don't know who this is, so keep it off
+    // habitat
+    if ( Payloads[ID].InUse )
+    {
+        QueueTelemetryUpload( Channel, Sentence, RxTime );
     }
+
+    LogMessage( "Ch%d: %s (binary, payload %d)\n", Channel, Sentence, ID );
+
+    DoPositionCalcs( Channel, RxTime->tv_sec );
+
+    Config.LoRaDevices[Channel].TelemetryCount++;
+    Config.LoRaDevices[Channel].LastTelemetryPacketAt = RxTime->tv_sec;
 }
 
 
 void
-ProcessTelemetryMessage( int Channel, char *Message )
+ProcessTelemetryMessage( int Channel, char *Message,
+                         const struct timespec *RxTime )
 {
+    TelemetryRecords[Channel].FieldCount = 0;
+
     if ( strlen( Message + 1 ) < 250 )
     {
         char *startmessage, *endmessage;
@@ -850,6 +1129,23 @@ ProcessTelemetryMessage( int Channel, char *Message )
         startmessage = Message;
         endmessage = strchr( startmessage, '\n' );
 
+        if ( endmessage != NULL )
+        {
+            *endmessage = '\0';
+        }
+
+        // Corrupt sentences go no further; they must not be parsed or
+        // uploaded
+        if ( !TelemetryChecksumOK( startmessage ) )
+        {
+            LogMessage( "Ch%d: Bad telemetry checksum: %s\n", Channel,
+                        startmessage );
+            ChannelPrintf( Channel, 3, 1, "Bad telemetry checksum    " );
+            Config.LoRaDevices[Channel].BadChecksumCount++;
+            ShowPacketCounts( Channel );
+            return;
+        }
+
         if ( endmessage != NULL )
         {
             habitate_telem_packets++;
@@ -857,56 +1153,34 @@ ProcessTelemetryMessage( int Channel, char *Message )
             time_t now;
             struct tm *tm;
 
-            *endmessage = '\0';
-
 			LogTelemetryPacket(startmessage);
 
             strcpy( Config.LoRaDevices[Channel].Telemetry, startmessage );
             // UploadTelemetryPacket(startmessage);
 
-            ProcessLine( Channel, startmessage );
+            // Parse the copy, so the field views stay valid until the next
+            // sentence on this channel
+            ProcessLine( Channel, Config.LoRaDevices[Channel].Telemetry );
 
             now = time( 0 );
             tm = localtime( &now );
 
 
-            if ( Config.EnableHabitat )
-            {
-
-                // Create a telemetry packet
-                telemetry_t t;
-                t.Channel = Channel;
-                t.Packet_Number = habitate_telem_packets;
-                memcpy( t.Telemetry, startmessage,
-                        strlen( startmessage ) + 1 );
-
-                // Add the telemetry packet to the pipe
-                int result = write( telem_pipe_fd[1], &t, sizeof( t ) );
-                if ( result == -1 )
-                {
-                    printf( "Error writing to the telemetry pipe\n" );
-                    exit( 1 );
-                }
-                if ( result == 0 )
-                {
-                    LogMessage( "Nothing written to telemetry pipe \n" );
-                }
-                if ( result > 1 )
-                {
-                    htsv.packet_count++;
-                }
-            }
+            QueueTelemetryUpload( Channel, startmessage, RxTime );
 
             LogMessage( "%02d:%02d:%02d Ch%d: %s\n", tm->tm_hour, tm->tm_min,
                         tm->tm_sec, Channel, startmessage );
 
         }
 
-        DoPositionCalcs( Channel );
+        if ( TelemetryRecords[Channel].FieldCount > 0 )
+        {
+            DoPositionCalcs( Channel, RxTime->tv_sec );
+        }
 
         // RJH I think this should be moved up to the bottom of the loop above  
         Config.LoRaDevices[Channel].TelemetryCount++;
-        Config.LoRaDevices[Channel].LastTelemetryPacketAt = time( NULL );
+        Config.LoRaDevices[Channel].LastTelemetryPacketAt = RxTime->tv_sec;
     }
 }
 
@@ -948,66 +1222,40 @@ FileExists( char *filename )
 }
 
 void
-ProcessSSDVMessage( int Channel, char *Message )
+ProcessSSDVMessage( int Channel, char *Message,
+                    const struct timespec *RxTime )
 {
     // SSDV packet
     uint32_t CallsignCode;
-    char Callsign[7], *FileMode;
+    char Callsign[7];
     int ImageNumber, PacketNumber;
-    char filename[100];
-    FILE *fp;
 
     Message[0] = 0x55;
 
-    CallsignCode = Message[2];
+    CallsignCode = ( unsigned char ) Message[2];
     CallsignCode <<= 8;
-    CallsignCode |= Message[3];
+    CallsignCode |= ( unsigned char ) Message[3];
     CallsignCode <<= 8;
-    CallsignCode |= Message[4];
+    CallsignCode |= ( unsigned char ) Message[4];
     CallsignCode <<= 8;
-    CallsignCode |= Message[5];
+    CallsignCode |= ( unsigned char ) Message[5];
 
     decode_callsign( Callsign, CallsignCode );
 
-    ImageNumber = Message[6];
-    PacketNumber = Message[7] * 256 + Message[8];
+    ImageNumber = ( unsigned char ) Message[6];
+    PacketNumber = ( unsigned char ) Message[7] * 256 +
+        ( unsigned char ) Message[8];
 
     LogMessage( "Ch%d: SSDV Packet, Callsign %s, Image %d, Packet %d\n",
-                Channel, Callsign, Message[6], PacketNumber );
+                Channel, Callsign, ImageNumber, PacketNumber );
     ChannelPrintf( Channel, 3, 1, "SSDV Packet                     " );
     ChannelPrintf( Channel, 5, 1, "SSDV %s: Image %d, Packet %d", Callsign,
-                   Message[6], PacketNumber );
+                   ImageNumber, PacketNumber );
 
-    // Create new file ?
-    sprintf( filename, "/tmp/%s_%d.bin", Callsign, ImageNumber );
-    if ( !FileExists( filename ) )
+    if ( SSDVImageAddPacket( Callsign, ( unsigned char * ) Message,
+                             RxTime->tv_sec ) == SSDV_PACKET_NEW_IMAGE )
     {
-        // New image so new file
         LogMessage( "Started image %d\n", ImageNumber );
-
-        // AddImageNumberToLog(Channel, ImageNumber);
-
-        FileMode = "wb";
-    }
-    else
-    {
-        FileMode = "r+b";
-    }
-
-    // Save to file
-    if ( ( fp = fopen( filename, FileMode ) ) )
-    {
-        fseek( fp, PacketNumber * 256, SEEK_SET );
-        if ( fwrite( Message, 1, 256, fp ) == 256 )
-        {
-            // AddImagePacketToLog(Channel, ImageNumber, PacketNumber);
-        }
-        else
-        {
-            LogMessage( "** FAILED TO WRITE TO SSDV FILE\n" );
-        }
-
-        fclose( fp );
     }
 
     // ShowMissingPackets(Channel);
@@ -1018,6 +1266,7 @@ ProcessSSDVMessage( int Channel, char *Message )
         ssdv_t s;
         s.Channel = Channel;
         s.Packet_Number = Config.LoRaDevices[Channel].SSDVCount;
+        s.RxTime = *RxTime;
         memcpy( s.SSDV_Packet, Message, 256 );
 
         // Add the SSDV packet to the pipe
@@ -1039,7 +1288,8 @@ ProcessSSDVMessage( int Channel, char *Message )
     }
 
     Config.LoRaDevices[Channel].SSDVCount++;
-    Config.LoRaDevices[Channel].LastSSDVPacketAt = time( NULL );
+    Config.LoRaDevices[Channel].LastSSDVPacketAt = RxTime->tv_sec;
+    strcpy( Config.LoRaDevices[Channel].SSDVCallsign, Callsign );
 }
 
 void
@@ -1047,45 +1297,34 @@ TestMessageForSMSAcknowledgement( int Channel, char *Message )
 {
     if ( Config.SMSFolder[0] )
     {
-        if ( strlen( Message ) < 250 )
+        telemetry_field_t Field;
+
+        // The tracker acknowledges an SMS by sending its number as the
+        // second-last field of the telemetry.  Found from the end, as the
+        // parsed record only has the first TELEMETRY_MAX_FIELDS fields.
+        if ( TelemetryFieldFromEnd( Message, 2, &Field ) )
         {
-            char Line[256];
-            char *token, *value1, *value2;
+            char OldFileName[256], NewFileName[256];
             int FileNumber;
 
-            value1 = NULL;
-            value2 = NULL;
-
-            strcpy( Line, Message );
-            token = strtok( Line, "," );
-            while ( token != NULL )
-            {
-                value1 = value2;
-                value2 = token;
-                token = strtok( NULL, "," );
-            }
+            FileNumber = atoi( Field.Start );
 
             // Rename the file matching this parameter
-            if ( value1 )
+            if ( FileNumber > 0 )
             {
-                char OldFileName[256], NewFileName[256];
-                FileNumber = atoi( value1 );
-                if ( FileNumber > 0 )
+                sprintf( OldFileName, "%s%d.sms", Config.SMSFolder,
+                         FileNumber );
+                if ( FileExists( OldFileName ) )
                 {
-                    sprintf( OldFileName, "%s%d.sms", Config.SMSFolder,
+                    sprintf( NewFileName, "%s%d.ack", Config.SMSFolder,
                              FileNumber );
-                    if ( FileExists( OldFileName ) )
+                    if ( FileExists( NewFileName ) )
                     {
-                        sprintf( NewFileName, "%s%d.ack", Config.SMSFolder,
-                                 FileNumber );
-                        if ( FileExists( NewFileName ) )
-                        {
-                            remove( NewFileName );
-                        }
-                        rename( OldFileName, NewFileName );
-                        LogMessage( "Renamed %s as %s\n", OldFileName,
-                                    NewFileName );
+                        remove( NewFileName );
                     }
+                    rename( OldFileName, NewFileName );
+                    LogMessage( "Renamed %s as %s\n", OldFileName,
+                                NewFileName );
                 }
             }
         }
@@ -1093,102 +1332,536 @@ TestMessageForSMSAcknowledgement( int Channel, char *Message )
 }
 
 void
-DIO0_Interrupt( int Channel )
+ProcessPacket( int Channel, rx_packet_t * Packet )
+{
+    if ( Packet->Status == PACKET_TX_DONE )
+    {
+        if ( Radios[Channel].UplinkLateUS >= 0 )
+        {
+            LogMessage( "Ch%d: End of Tx, %ldus after slot\n",
+                        Channel, Radios[Channel].UplinkLateUS );
+        }
+        else
+        {
+            LogMessage( "Ch%d: End of Tx\n", Channel );
+        }
+
+        ShowFrequency( Channel );
+        ShowDefaultLoRaParameters( Channel );
+    }
+    else if ( Packet->Status == PACKET_RADIO_RESET )
+    {
+        LogMessage( "Ch%d: Radio not responding (%u mode timeouts), channel reset\n",
+                    Channel, Radios[Channel].ModeTimeouts );
+        ChannelPrintf( Channel, 3, 1, "Radio reset                " );
+
+        ShowFrequency( Channel );
+        ShowDefaultLoRaParameters( Channel );
+        ShowPacketCounts( Channel );
+    }
+    else if ( Packet->Status == PACKET_RETUNED )
+    {
+        if ( Packet->Retune != 0 )
+        {
+            LogMessage( "Retune by %lf kHz\n", Packet->Retune );
+        }
+        ShowFrequency( Channel );
+    }
+    else if ( Packet->Status == PACKET_CRC_ERROR )
+    {
+        packet_event_t Event;
+
+        Event.Type = EVENT_CRC_ERROR;
+        Event.Channel = Channel;
+        Event.Message = Packet->Message;
+        Event.Bytes = Packet->Bytes;
+        Event.Packet = Packet;
+        Event.RxTime = Packet->RxTime;
+        EventPublish( &Event );
+    }
+    else if ( Packet->Bytes > 0 )
+    {
+        PublishPacket( Channel, Packet->Message, Packet->Bytes, Packet,
+                       &Packet->RxTime );
+    }
+}
+
+// Packet pipeline stages; see SubscribePacketHandlers()
+
+void
+ShowSignalEvent( packet_event_t * Event )
+{
+    const rx_packet_t *Packet = Event->Packet;
+    int Channel = Event->Channel;
+
+    // Injected packets didn't come over the air
+    if ( Packet == NULL )
+        return;
+
+    ChannelPrintf( Channel, 10, 1, "Packet SNR = %d, RSSI = %d      ",
+                   ( int ) Packet->SNR, Packet->RSSI );
+    ChannelPrintf( Channel, 11, 1, "Freq. Error = %5.1lfkHz ",
+                   Packet->FreqError );
+
+    LogPacket( Channel, Packet, Event->Dedup.Copies, Event->Dedup.Best );
+
+    if ( Packet->Retune != 0 )
+    {
+        LogMessage( "Retune by %lf kHz\n", Packet->Retune );
+        ShowFrequency( Channel );
+    }
+}
+
+void
+ActivityEvent( packet_event_t * Event )
+{
+    int Channel = Event->Channel;
+
+    if ( Config.LoRaDevices[Channel].ActivityLED >= 0 )
+    {
+        HalDigitalWrite( Config.LoRaDevices[Channel].ActivityLED, 1 );
+        LEDCounts[Channel] = 5;
+    }
+
+    Config.LoRaDevices[Channel].LastPacketAt = Event->RxTime.tv_sec;
+
+    if ( Config.LoRaDevices[Channel].InCallingMode
+         && ( Config.CallingTimeout > 0 ) )
+    {
+        Config.LoRaDevices[Channel].ReturnToCallingModeAt =
+            time( NULL ) + Config.CallingTimeout;
+    }
+
+    ShowPacketCounts( Channel );
+}
+
+void
+TelemetryEvent( packet_event_t * Event )
+{
+    ProcessTelemetryMessage( Event->Channel, Event->Message + 1,
+                             &Event->RxTime );
+}
+
+void
+SMSAcknowledgementEvent( packet_event_t * Event )
+{
+    TestMessageForSMSAcknowledgement( Event->Channel, Event->Message + 1 );
+}
+
+void
+BinaryTelemetryEvent( packet_event_t * Event )
+{
+    ProcessBinaryTelemetry( Event->Channel, Event->Message + 1, Event->Bytes,
+                            &Event->RxTime );
+}
+
+void
+SSDVEvent( packet_event_t * Event )
+{
+    if ( Event->Corrected > 0 )
+    {
+        LogMessage( "Ch%d: SSDV packet repaired, %d bytes corrected\n",
+                    Event->Channel, Event->Corrected );
+        Config.LoRaDevices[Event->Channel].SSDVFixedCount++;
+    }
+
+    ProcessSSDVMessage( Event->Channel, Event->Message, &Event->RxTime );
+}
+
+// Too damaged for the FEC; drop it rather than store or upload it, and
+// let it be resent as a missing packet
+void
+SSDVErrorEvent( packet_event_t * Event )
+{
+    int Channel = Event->Channel;
+
+    LogMessage( "Ch%d: SSDV packet failed CRC, not repairable\n", Channel );
+    ChannelPrintf( Channel, 3, 1, "SSDV packet damaged             " );
+    Config.LoRaDevices[Channel].SSDVBadCount++;
+    ShowPacketCounts( Channel );
+}
+
+void
+CallingEvent( packet_event_t * Event )
+{
+    ProcessCallingMessage( Event->Channel, Event->Message + 1 );
+}
+
+void
+UploadEvent( packet_event_t * Event )
+{
+    ProcessUploadMessage( Event->Channel, Event->Message + 1 );
+}
+
+void
+FlightControllerEvent( packet_event_t * Event )
+{
+    LogMessage( "Flight Controller message %d bytes = %s", Event->Bytes,
+                Event->Message + 1 );
+}
+
+void
+UplinkCommandEvent( packet_event_t * Event )
+{
+    LogMessage( "Uplink Command message %d bytes = %s", Event->Bytes,
+                Event->Message + 1 );
+}
+
+void
+UnknownPacketEvent( packet_event_t * Event )
+{
+    int Channel = Event->Channel;
+
+    LogMessage( "Unknown packet type is %02Xh, RSSI %d\n",
+                ( unsigned char ) Event->Message[1],
+                Event->Packet ? Event->Packet->RSSI : 0 );
+    ChannelPrintf( Channel, 3, 1, "Unknown Packet %d, %d bytes",
+                   Event->Message[0], Event->Bytes );
+    Config.LoRaDevices[Channel].UnknownCount++;
+}
+
+void
+CRCErrorEvent( packet_event_t * Event )
+{
+    int Channel = Event->Channel;
+
+    LogMessage( "Ch%d: CRC Failure, RSSI %d\n", Channel, Event->Packet->RSSI );
+    ChannelPrintf( Channel, 3, 1, "CRC Failure %02Xh!!\n",
+                   Event->Packet->IRQFlags );
+    Config.LoRaDevices[Channel].BadCRCCount++;
+    ShowPacketCounts( Channel );
+}
+
+// Payload a telemetry packet is from; 0 if it can't be told
+static int
+TelemetryPayload( const packet_event_t * Event, char *Payload, size_t Size )
+{
+    telemetry_record_t Record;
+    struct TBinaryPacket Binary;
+    const char *Sentence;
+
+    switch ( PacketEventType( Event->Message[1] ) )
+    {
+        case EVENT_TELEMETRY:
+            if ( ( ( Sentence = strstr( Event->Message + 1, "$$" ) ) == NULL )
+                 || ( TelemetryParse( Sentence, &Record,
+                                      TELEMETRY_BASIC_FIELDS ) <= 0 ) )
+                return 0;
+            snprintf( Payload, Size, "%s", Record.Values.Payload );
+            return Payload[0] != '\0';
+
+        case EVENT_BINARY_TELEMETRY:
+            if ( Event->Bytes < sizeof( Binary ) )
+                return 0;
+            memcpy( &Binary, Event->Message + 1, sizeof( Binary ) );
+            BinaryPayloadName( Binary.PayloadIDs & 0x0F, Payload, Size );
+            return 1;
+
+        default:
+            return 0;
+    }
+}
+
+// Repeat of something already heard.  The first copy has been logged and
+// uploaded, and the bytes are the same, so it's just counted; but if this
+// copy was heard better, that channel becomes the payload's channel in the
+// flight table (and so on the server port).
+void
+DuplicateEvent( packet_event_t * Event )
+{
+    int Channel = Event->Channel;
+    char Payload[16];
+
+    if ( Event->Dedup.Best
+         && TelemetryPayload( Event, Payload, sizeof( Payload ) ) )
+    {
+        FlightSetChannel( Payload, Channel );
+    }
+
+    ChannelPrintf( Channel, 3, 1, "Duplicate x%u, best Ch%d SNR %d     ",
+                   Event->Dedup.Copies, Event->Dedup.BestChannel,
+                   Event->Dedup.BestSNR );
+    Config.LoRaDevices[Channel].DuplicateCount++;
+}
+
+// Wire up the packet pipeline.  Subscribers for an event are called in
+// the order they're listed here.
+void
+SubscribePacketHandlers( void )
+{
+    EventSubscribe( EVENT_TELEMETRY, "Telemetry", TelemetryEvent );
+    EventSubscribe( EVENT_TELEMETRY, "SMSAck", SMSAcknowledgementEvent );
+    EventSubscribe( EVENT_BINARY_TELEMETRY, "Binary", BinaryTelemetryEvent );
+    EventSubscribe( EVENT_SSDV, "SSDV", SSDVEvent );
+    EventSubscribe( EVENT_CALLING, "Calling", CallingEvent );
+    EventSubscribe( EVENT_UPLOAD, "Upload", UploadEvent );
+    EventSubscribe( EVENT_FLIGHT_CONTROLLER, "Log",
+                    FlightControllerEvent );
+    EventSubscribe( EVENT_UPLINK_COMMAND, "Log", UplinkCommandEvent );
+    EventSubscribe( EVENT_UNKNOWN, "Unknown", UnknownPacketEvent );
+    EventSubscribe( EVENT_CRC_ERROR, "CRCError", CRCErrorEvent );
+    EventSubscribe( EVENT_SSDV_ERROR, "SSDVError", SSDVErrorEvent );
+    EventSubscribe( EVENT_DUPLICATE, "Duplicate", DuplicateEvent );
+    EventSubscribe( EVENT_RECEIVED, "Signal", ShowSignalEvent );
+    EventSubscribe( EVENT_RECEIVED, "Activity", ActivityEvent );
+}
+
+void *
+PacketLoop( void *some_void_ptr )
+{
+    int Channel;
+    rx_packet_t *Packet;
+
+    Channel = ( int ) ( long ) some_void_ptr;
+
+    // Keep going until the parent quits and the queue has been drained
+    while ( run || !RxQueueEmpty( &RxQueues[Channel] ) )
+    {
+        if ( ( Packet = RxQueuePeek( &RxQueues[Channel], 100 ) ) != NULL )
+        {
+            ProcessPacket( Channel, Packet );
+            RxQueueRelease( &RxQueues[Channel] );
+        }
+    }
+
+    return NULL;
+}
+
+// Put the chip into LoRa mode with the default settings, and start
+// receiving.  Used at startup and after a channel reset.
+int
+InitialiseRadio( int Channel )
+{
+    // Nothing is known about the chip's registers yet
+    RegShadowInit( &Shadows[Channel] );
+    Radios[Channel].State = RADIO_UNKNOWN;
+    Config.LoRaDevices[Channel].Sending = 0;
+
+    // LoRa mode 
+    if ( setLoRaMode( Channel ) < 0 )
+        return -1;
+
+    // Only the low bits of REG_DETECT_OPT are ours, so read it once here
+    // rather than on every mode change
+    RegShadowNote( &Shadows[Channel], REG_DETECT_OPT,
+                   readRegister( Channel, REG_DETECT_OPT ) );
+
+    SetDefaultLoRaParameters( Channel );
+
+    return startReceiving( Channel );
+}
+
+// Radio thread: service the chip after DIO0 has fired
+void
+HandleDIO0( int Channel )
 {
+    static rx_packet_t Discard[MAX_LORA_DEVICES];
+    rx_packet_t *Packet;
+
+    // The packet, or end-of-transmission event, goes into the channel's
+    // queue for PacketLoop() to process
+    if ( ( Packet = RxQueueReserve( &RxQueues[Channel] ) ) == NULL )
+    {
+        // Queue full - still service the chip, but drop the packet
+        Packet = &Discard[Channel];
+    }
+
+    Packet->RxMono = Radios[Channel].DIO0Mono;
+    Packet->RxTime = Radios[Channel].DIO0Time;
+
     if ( Config.LoRaDevices[Channel].Sending )
     {
         Config.LoRaDevices[Channel].Sending = 0;
-        LogMessage( "Ch%d: End of Tx\n", Channel );
+
+        // The chip drops back to standby by itself after TxDone
+        Radios[Channel].State = RADIO_STANDBY;
 
         setLoRaMode( Channel );
         SetDefaultLoRaParameters( Channel );
         startReceiving( Channel );
+
+        Packet->Status = PACKET_TX_DONE;
     }
     else
     {
-        int Bytes;
-        char Message[257];
+        receiveMessage( Channel, Packet );
+    }
 
-        Bytes = receiveMessage( Channel, Message + 1 );
+    if ( Packet != &Discard[Channel] )
+    {
+        RxQueueCommit( &RxQueues[Channel] );
+    }
+}
 
-        // hexdump_buffer ("Raw Data", Message, 257);
+// Radio thread: tell the packet thread that something has changed
+void
+PostRadioEvent( int Channel, int Status, double Retune )
+{
+    rx_packet_t *Packet;
 
+    if ( ( Packet = RxQueueReserve( &RxQueues[Channel] ) ) != NULL )
+    {
+        Packet->Status = Status;
+        Packet->Retune = Retune;
+        RxQueueCommit( &RxQueues[Channel] );
+    }
+}
 
-        if ( Bytes > 0 )
-        {
-            if ( Config.LoRaDevices[Channel].ActivityLED >= 0 )
-            {
-                digitalWrite( Config.LoRaDevices[Channel].ActivityLED, 1 );
-                LEDCounts[Channel] = 5;
-            }
+long long
+TimespecNS( const struct timespec *Time )
+{
+    return ( long long ) Time->tv_sec * 1000000000LL + Time->tv_nsec;
+}
 
-            if ( Message[1] == '!' )
-            {
-                ProcessUploadMessage( Channel, Message + 1 );
-            }
-            else if ( Message[1] == '^' )
-            {
-                ProcessCallingMessage( Channel, Message + 1 );
-            }
-            else if ( Message[1] == '$' )
+void
+RunRadioCommand( int Channel, radio_command_t * Command )
+{
+    switch ( Command->Type )
+    {
+        case RADIO_CMD_SEND:
+            if ( Command->SendAt.tv_sec )
             {
-                ProcessTelemetryMessage( Channel, Message + 1 );
-                TestMessageForSMSAcknowledgement( Channel, Message + 1 );
+                struct timespec Now;
+
+                clock_gettime( CLOCK_REALTIME, &Now );
+                Radios[Channel].UplinkLateUS =
+                    ( TimespecNS( &Now ) - TimespecNS( &Command->SendAt ) ) / 1000;
             }
-            else if ( Message[1] == '>' )
+            else
             {
-                LogMessage( "Flight Controller message %d bytes = %s", Bytes,
-                            Message + 1 );
+                Radios[Channel].UplinkLateUS = -1;
             }
-            else if ( Message[1] == '*' )
+            if ( SendLoRaData( Channel, Command->Data, Command->Length ) < 0 )
+                break;
+            if ( Config.LoRaDevices[Channel].UplinkFrequency > 0 )
             {
-                LogMessage( "Uplink Command message %d bytes = %s", Bytes,
-                            Message + 1 );
+                PostRadioEvent( Channel, PACKET_RETUNED, 0 );
             }
-            else if ((Message[1] == 0x66) || (Message[1] == 0x67) || (Message[1] == 0x68) || (Message[1] == 0x69))
+            break;
+
+        case RADIO_CMD_RETUNE:
+            if ( ReTune( Channel, Command->Frequency ) < 0 )
+                break;
+            PostRadioEvent( Channel, PACKET_RETUNED, Command->Frequency * 1000 );
+            break;
+
+        case RADIO_CMD_SET_MODEM:
+            if ( setMode( Channel, RADIO_SLEEP ) < 0 )
+                break;
+            setFrequency( Channel, Command->Frequency );
+            SetLoRaParameters( Channel, Command->ImplicitOrExplicit,
+                               Command->ErrorCoding, Command->Bandwidth,
+                               Command->SpreadingFactor,
+                               Command->LowDataRateOptimize );
+            if ( setMode( Channel, RADIO_RX ) < 0 )
+                break;
+            PostRadioEvent( Channel, PACKET_RETUNED, 0 );
+            break;
+
+        case RADIO_CMD_DEFAULT:
+            if ( setLoRaMode( Channel ) < 0 )
+                break;
+            SetDefaultLoRaParameters( Channel );
+            setMode( Channel, RADIO_RX );
+            break;
+    }
+}
+
+// One per channel in use; the only thread that talks to that chip once
+// setup is done
+void *
+RadioLoop( void *some_void_ptr )
+{
+    int Channel, Scheduled;
+    radio_t *Radio;
+    radio_command_t Command, Uplink;
+    time_t LastRSSIAt;
+
+    Channel = ( int ) ( long ) some_void_ptr;
+    Radio = &Radios[Channel];
+    LastRSSIAt = 0;
+    Scheduled = 0;
+
+    while ( run )
+    {
+        struct timespec Deadline;
+
+        clock_gettime( CLOCK_REALTIME, &Deadline );
+        Deadline.tv_nsec += 100000000L;
+        Deadline.tv_sec += Deadline.tv_nsec / 1000000000L;
+        Deadline.tv_nsec %= 1000000000L;
+
+        // Wake up exactly on the uplink slot if there's one coming
+        if ( Scheduled
+             && ( TimespecNS( &Uplink.SendAt ) < TimespecNS( &Deadline ) ) )
+        {
+            Deadline = Uplink.SendAt;
+        }
+
+        if ( RadioWait( Radio, &Deadline ) )
+        {
+            HandleDIO0( Channel );
+        }
+
+        while ( RadioNextCommand( Radio, &Command ) )
+        {
+            if ( ( Command.Type == RADIO_CMD_SEND ) && Command.SendAt.tv_sec )
             {
-                ProcessSSDVMessage( Channel, Message );
+                // Prepared ahead of its slot; a newer one replaces it
+                Uplink = Command;
+                Scheduled = 1;
             }
             else
             {
-                LogMessage( "Unknown packet type is %02Xh, RSSI %d\n",
-                            Message[1], readRegister( Channel,
-                                                      REG_PACKET_RSSI ) -
-                            157 );
-                ChannelPrintf( Channel, 3, 1, "Unknown Packet %d, %d bytes",
-                               Message[0], Bytes );
-                Config.LoRaDevices[Channel].UnknownCount++;
+                RunRadioCommand( Channel, &Command );
             }
+        }
+
+        if ( Scheduled )
+        {
+            struct timespec Now;
 
-            Config.LoRaDevices[Channel].LastPacketAt = time( NULL );
+            clock_gettime( CLOCK_REALTIME, &Now );
+            if ( TimespecNS( &Now ) >= TimespecNS( &Uplink.SendAt ) )
+            {
+                Scheduled = 0;
+                RunRadioCommand( Channel, &Uplink );
+            }
+        }
 
-            if ( Config.LoRaDevices[Channel].InCallingMode
-                 && ( Config.CallingTimeout > 0 ) )
+        // A mode change timed out - start the chip again from scratch.  If
+        // it's still not answering we'll try again next time round.
+        if ( Radio->ResetPending )
+        {
+            Radio->ResetPending = 0;
+            Radio->Resets++;
+            if ( InitialiseRadio( Channel ) == 0 )
             {
-                Config.LoRaDevices[Channel].ReturnToCallingModeAt =
-                    time( NULL ) + Config.CallingTimeout;
+                PostRadioEvent( Channel, PACKET_RADIO_RESET, 0 );
             }
+        }
 
-            ShowPacketCounts( Channel );
+        // Keep the current RSSI for the display
+        if ( ( Radio->State == RADIO_RX ) && ( time( NULL ) != LastRSSIAt ) )
+        {
+            Radio->CurrentRSSI =
+                readRegister( Channel, REG_CURRENT_RSSI ) - 157;
+            LastRSSIAt = time( NULL );
         }
     }
-}
 
-void DIO_Ignore_Interrupt_0( void )
-{
-    // nothing, obviously!
+    return NULL;
 }
 
-void
-DIO0_Interrupt_0( void )
+void DIO_Ignore_Interrupt( void *Radio )
 {
-    DIO0_Interrupt( 0 );
+    // nothing, obviously!
 }
 
 void
-DIO0_Interrupt_1( void )
+DIO0_Interrupt( void *Radio )
 {
-    DIO0_Interrupt( 1 );
+    RadioInterrupt( ( radio_t * ) Radio );
 }
 
 void
@@ -1197,25 +1870,29 @@ setupRFM98( int Channel )
     if ( Config.LoRaDevices[Channel].InUse )
     {
         // initialize the pins
-        pinMode( Config.LoRaDevices[Channel].DIO0, INPUT );
-        pinMode( Config.LoRaDevices[Channel].DIO5, INPUT );
+        HalPinMode( Config.LoRaDevices[Channel].DIO0, HAL_INPUT );
+        HalPinMode( Config.LoRaDevices[Channel].DIO5, HAL_INPUT );
 
-        wiringPiISR( Config.LoRaDevices[Channel].DIO0, INT_EDGE_RISING,
-                     Channel > 0 ? &DIO0_Interrupt_1 : &DIO0_Interrupt_0 );
-
-        if ( wiringPiSPISetup( Channel, 500000 ) < 0 )
+        if ( HalSPISetup( Channel, Config.LoRaDevices[Channel].SPIBus,
+                          Config.LoRaDevices[Channel].SPIChipSelect,
+                          500000 ) < 0 )
         {
             fprintf( stderr,
                      "Failed to open SPI port.  Try loading spi library with 'gpio load spi'" );
             exit( 1 );
         }
 
-        // LoRa mode 
-        setLoRaMode( Channel );
+        HalISR( Config.LoRaDevices[Channel].DIO0, &DIO0_Interrupt,
+                &Radios[Channel] );
 
-        SetDefaultLoRaParameters( Channel );
+        if ( InitialiseRadio( Channel ) < 0 )
+        {
+            // The radio thread will keep trying
+            LogMessage( "Ch%d: Radio not responding\n", Channel );
+        }
 
-        startReceiving( Channel );
+        ShowFrequency( Channel );
+        ShowDefaultLoRaParameters( Channel );
     }
 }
 
@@ -1249,18 +1926,19 @@ FrequencyReference( int Channel )
     return 0;
 }
 
+// Reg points to the 3 bytes read from REG_FREQ_ERROR onwards
 double
-FrequencyError( int Channel )
+FrequencyError( int Channel, const uint8_t * Reg )
 {
     int32_t Temp;
 
-    Temp = ( int32_t ) readRegister( Channel, REG_FREQ_ERROR ) & 7;
+    Temp = ( int32_t ) Reg[0] & 7;
     Temp <<= 8L;
-    Temp += ( int32_t ) readRegister( Channel, REG_FREQ_ERROR + 1 );
+    Temp += ( int32_t ) Reg[1];
     Temp <<= 8L;
-    Temp += ( int32_t ) readRegister( Channel, REG_FREQ_ERROR + 2 );
+    Temp += ( int32_t ) Reg[2];
 
-    if ( readRegister( Channel, REG_FREQ_ERROR ) & 8 )
+    if ( Reg[0] & 8 )
     {
         Temp = Temp - 524288;
     }
@@ -1269,76 +1947,76 @@ FrequencyError( int Channel )
         ( FrequencyReference( Channel ) / 500000.0 );
 }
 
+// Registers REG_FIFO_RX_CURRENT_ADDR to REG_PACKET_RSSI are read in one burst
+#define RX_STATUS_COUNT     ( REG_PACKET_RSSI - REG_FIFO_RX_CURRENT_ADDR + 1 )
+#define RX_STATUS( reg )    Status[( reg ) - REG_FIFO_RX_CURRENT_ADDR + 1]
+
 int
-receiveMessage( int Channel, char *message )
+receiveMessage( int Channel, rx_packet_t * Packet )
 {
-    int i, Bytes, currentAddr, x;
-    unsigned char data[257];
-    double FreqError;
+    uint8_t Status[RX_STATUS_COUNT + 1];
+    int Bytes, x;
 
     Bytes = 0;
+    Packet->Retune = 0;
 
-    x = readRegister( Channel, REG_IRQ_FLAGS );
-    // LogMessage("Message status = %02Xh\n", x);
+    readRegisters( Channel, REG_FIFO_RX_CURRENT_ADDR, Status,
+                   RX_STATUS_COUNT );
 
-    // clear the rxDone flag
-    writeRegister( Channel, REG_IRQ_FLAGS, 0x40 );
+    x = RX_STATUS( REG_IRQ_FLAGS );
+    Packet->IRQFlags = x;
 
     // check for payload crc issues (0x20 is the bit we are looking for
     if ( ( x & 0x20 ) == 0x20 )
     {
-        LogMessage( "Ch%d: CRC Failure, RSSI %d\n", Channel,
-                    readRegister( Channel, REG_PACKET_RSSI ) - 157 );
-        // reset the crc flags
-        writeRegister( Channel, REG_IRQ_FLAGS, 0x20 );
-        ChannelPrintf( Channel, 3, 1, "CRC Failure %02Xh!!\n", x );
-        Config.LoRaDevices[Channel].BadCRCCount++;
-        ShowPacketCounts( Channel );
+        Packet->Status = PACKET_CRC_ERROR;
+        Packet->RSSI = RX_STATUS( REG_PACKET_RSSI ) - 157;
     }
     else
     {
+        uint8_t FreqError[3 + 1];
         int8_t SNR;
         int RSSI;
 
-        currentAddr = readRegister( Channel, REG_FIFO_RX_CURRENT_ADDR );
-        Bytes = readRegister( Channel, REG_RX_NB_BYTES );
+        Packet->Status = PACKET_OK;
+
+        Bytes = RX_STATUS( REG_RX_NB_BYTES );
 
-        SNR = readRegister( Channel, REG_PACKET_SNR );
+        SNR = ( int8_t ) RX_STATUS( REG_PACKET_SNR );
         SNR /= 4;
-        RSSI = readRegister( Channel, REG_PACKET_RSSI ) - 157;
+        RSSI = RX_STATUS( REG_PACKET_RSSI ) - 157;
         if ( SNR < 0 )
         {
             RSSI += SNR;
         }
 
-        ChannelPrintf( Channel, 10, 1, "Packet SNR = %d, RSSI = %d      ",
-                       ( int ) SNR, RSSI );
-
-        FreqError = FrequencyError( Channel ) / 1000;
-        ChannelPrintf( Channel, 11, 1, "Freq. Error = %5.1lfkHz ",
-                       FreqError );
-
+        readRegisters( Channel, REG_FREQ_ERROR, FreqError, 3 );
 
-        writeRegister( Channel, REG_FIFO_ADDR_PTR, currentAddr );
+        Packet->SNR = SNR;
+        Packet->RSSI = RSSI;
+        Packet->FreqError = FrequencyError( Channel, FreqError + 1 ) / 1000;
 
-        data[0] = REG_FIFO;
-        wiringPiSPIDataRW( Channel, data, Bytes + 1 );
-        for ( i = 0; i <= Bytes; i++ )
-        {
-            message[i] = data[i + 1];
-        }
+        writeRegister( Channel, REG_FIFO_ADDR_PTR,
+                       RX_STATUS( REG_FIFO_RX_CURRENT_ADDR ) );
 
-        message[Bytes] = '\0';
+        // Payload goes straight into Message[1] onwards; Message[0] is
+        // used for the FIFO address byte of the transfer
+        readRegisters( Channel, REG_FIFO, ( uint8_t * ) Packet->Message,
+                       Bytes );
 
-        LogPacket( Channel, SNR, RSSI, FreqError, Bytes, message[1] );
+        Packet->Message[Bytes + 1] = '\0';
 
-        if ( Config.LoRaDevices[Channel].AFC && ( fabs( FreqError ) > 0.5 ) )
+        if ( Config.LoRaDevices[Channel].AFC
+             && ( fabs( Packet->FreqError ) > 0.5 ) )
         {
-            ReTune( Channel, FreqError / 1000 );
+            ReTune( Channel, Packet->FreqError / 1000 );
+            Packet->Retune = Packet->FreqError;
         }
     }
 
-    // Clear all flags
+    Packet->Bytes = Bytes;
+
+    // Clear all flags, including RxDone and PayloadCrcError
     writeRegister( Channel, REG_IRQ_FLAGS, 0xFF );
 
     return Bytes;
@@ -1426,8 +2104,19 @@ void LoadConfigFile(void)
     int Channel, Temp;
     char TempString[16];
 
-    Config.LoRaDevices[0].InUse = 0;
-    Config.LoRaDevices[1].InUse = 0;
+    for ( Channel = 0; Channel < MAX_LORA_DEVICES; Channel++ )
+    {
+        Config.LoRaDevices[Channel].InUse = 0;
+
+        // Default SPI port: CE0 and CE1 on bus 0, then on to bus 1 etc.
+        Config.LoRaDevices[Channel].SPIBus = Channel / 2;
+        Config.LoRaDevices[Channel].SPIChipSelect = Channel % 2;
+
+        // Only the first two modules have default pins
+        Config.LoRaDevices[Channel].DIO0 = -1;
+        Config.LoRaDevices[Channel].DIO5 = -1;
+    }
+    Config.LoRaDeviceCount = 0;
     Config.EnableHabitat = 1;
     Config.EnableSSDV = 1;
     Config.EnableTelemetryLogging = 0;
@@ -1477,10 +2166,12 @@ void LoadConfigFile(void)
     // LED allocations
     Config.NetworkLED = ReadInteger( fp, "NetworkLED", 0, -1 );
     Config.InternetLED = ReadInteger( fp, "InternetLED", 0, -1 );
-    Config.LoRaDevices[0].ActivityLED =
-        ReadInteger( fp, "ActivityLED_0", 0, -1 );
-    Config.LoRaDevices[1].ActivityLED =
-        ReadInteger( fp, "ActivityLED_1", 0, -1 );
+    for ( Channel = 0; Channel < MAX_LORA_DEVICES; Channel++ )
+    {
+        sprintf( Keyword, "ActivityLED_%d", Channel );
+        Config.LoRaDevices[Channel].ActivityLED =
+            ReadInteger( fp, Keyword, 0, -1 );
+    }
 
     // Server Port
     Config.ServerPort = ReadInteger( fp, "ServerPort", 0, -1 );
@@ -1516,6 +2207,9 @@ void LoadConfigFile(void)
     // Dev mode
     ReadBoolean( fp, "EnableDev", 0, &Config.EnableDev );
 
+    // Repeats of the same packet within this many seconds aren't uploaded
+    DedupSetWindow( ReadInteger( fp, "DuplicateWindow", 0, 30 ) );
+
     // SMS upload to tracker
     Config.SMSFolder[0] = '\0';
     ReadString(fp, "SMSFolder", Config.SMSFolder, sizeof( Config.SMSFolder ), 0);
@@ -1525,7 +2219,7 @@ void LoadConfigFile(void)
                     Config.SMSFolder );
     }
 
-    for ( Channel = 0; Channel <= 1; Channel++ )
+    for ( Channel = 0; Channel < MAX_LORA_DEVICES; Channel++ )
     {
         // Defaults
         Config.LoRaDevices[Channel].Frequency[0] = '\0';
@@ -1561,6 +2255,32 @@ void LoadConfigFile(void)
                         Config.LoRaDevices[Channel].DIO0,
                         Config.LoRaDevices[Channel].DIO5 );
 
+            if ( ( Config.LoRaDevices[Channel].DIO0 < 0 )
+                 || ( Config.LoRaDevices[Channel].DIO5 < 0 ) )
+            {
+                LogMessage( "Channel %d needs DIO0_%d and DIO5_%d - disabled\n",
+                            Channel, Channel, Channel );
+                Config.LoRaDevices[Channel].InUse = 0;
+                continue;
+            }
+
+            // SPI bus / chip select overrides
+            sprintf( Keyword, "SPIBus_%d", Channel );
+            Config.LoRaDevices[Channel].SPIBus =
+                ReadInteger( fp, Keyword, 0,
+                             Config.LoRaDevices[Channel].SPIBus );
+
+            sprintf( Keyword, "SPIChipSelect_%d", Channel );
+            Config.LoRaDevices[Channel].SPIChipSelect =
+                ReadInteger( fp, Keyword, 0,
+                             Config.LoRaDevices[Channel].SPIChipSelect );
+
+            LogMessage( "LoRa Channel %d on /dev/spidev%d.%d\n", Channel,
+                        Config.LoRaDevices[Channel].SPIBus,
+                        Config.LoRaDevices[Channel].SPIChipSelect );
+
+            Config.LoRaDeviceCount = Channel + 1;
+
             // Uplink
             sprintf( Keyword, "UplinkTime_%d", Channel );
             Config.LoRaDevices[Channel].UplinkTime = ReadInteger( fp, Keyword, 0, 0 );
@@ -1570,6 +2290,10 @@ void LoadConfigFile(void)
                         Config.LoRaDevices[Channel].UplinkTime,
                         Config.LoRaDevices[Channel].UplinkCycle );
 
+            sprintf( Keyword, "BinaryResend_%d", Channel );
+            ReadBoolean( fp, Keyword, 0,
+                         &Config.LoRaDevices[Channel].BinaryResend );
+
             sprintf( Keyword, "Power_%d", Channel );
             Config.LoRaDevices[Channel].Power = ReadInteger( fp, Keyword, 0, PA_MAX_UK );
             LogMessage( "Channel %d power set to %02Xh\n", Channel, Config.LoRaDevices[Channel].Power );
@@ -1740,7 +2464,6 @@ WINDOW *
 InitDisplay( void )
 {
     WINDOW *mainwin;
-    int Channel;
 
     /*  Initialize ncurses  */
 
@@ -1775,11 +2498,35 @@ InitDisplay( void )
     mvaddstr( 0, ( 80 - strlen( title ) ) / 2, title );
     refresh(  );
 
-    // Windows for LoRa live data
-    for ( Channel = 0; Channel <= 1; Channel++ )
+    curs_set( 0 );
+
+    return mainwin;
+}
+
+// Windows for LoRa live data, two per row, once we know how many channels
+// there are.  The log window goes underneath.
+void
+InitChannelWindows( void )
+{
+    int Channel, Rows, LogTop;
+
+    Rows = ( Config.LoRaDeviceCount + 1 ) / 2;
+    if ( Rows < 1 )
+    {
+        Rows = 1;
+    }
+    LogTop = 2 + Rows * 14;
+
+    pthread_mutex_lock( &var );
+
+    for ( Channel = 0; Channel < Config.LoRaDeviceCount; Channel++ )
     {
         Config.LoRaDevices[Channel].Window =
-            newwin( 14, 38, 1, Channel ? 41 : 1 );
+            newwin( 14, 38, 1 + ( Channel / 2 ) * 14, ( Channel & 1 ) ? 41 : 1 );
+        if ( Config.LoRaDevices[Channel].Window == NULL )
+        {
+            continue;
+        }
         wbkgd( Config.LoRaDevices[Channel].Window, COLOR_PAIR( 2 ) );
 
         // wcolor_set(Config.LoRaDevices[Channel].Window, 2, NULL);
@@ -1788,9 +2535,14 @@ InitDisplay( void )
         wrefresh( Config.LoRaDevices[Channel].Window );
     }
 
-    curs_set( 0 );
+    if ( ( LogWindow != NULL ) && ( LogTop != 16 ) && ( LogTop < LINES - 2 ) )
+    {
+        wresize( LogWindow, LINES - LogTop, COLS );
+        mvwin( LogWindow, LogTop, 0 );
+        wrefresh( LogWindow );
+    }
 
-    return mainwin;
+    pthread_mutex_unlock( &var );
 }
 
 void
@@ -1803,33 +2555,22 @@ CloseDisplay( WINDOW * mainwin )
 }
 
 
-uint16_t
-CRC16( unsigned char *ptr )
+void
+ProcessKeyPress( int ch )
 {
-    uint16_t CRC;
-    int j;
-
-    CRC = 0xffff;               // Seed
+    static int SelectedChannel = 0;
+    int Channel;
+    double FreqShift = 0;
 
-    for ( ; *ptr; ptr++ )
-    {                           // For speed, repeat calculation instead of looping for each bit
-        CRC ^= ( ( ( unsigned int ) *ptr ) << 8 );
-        for ( j = 0; j < 8; j++ )
-        {
-            if ( CRC & 0x8000 )
-                CRC = ( CRC << 1 ) ^ 0x1021;
-            else
-                CRC <<= 1;
-        }
+    /* number keys choose which channel unshifted keys act on */
+    if ( ch >= '0' && ch < '0' + Config.LoRaDeviceCount )
+    {
+        SelectedChannel = ch - '0';
+        LogMessage( "Keys now act on channel %d\n", SelectedChannel );
+        return;
     }
 
-    return CRC;
-}
-
-void
-ProcessKeyPress( int ch )
-{
-    int Channel = 0;
+    Channel = SelectedChannel;
 
     /* shifted keys act on channel 1 */
     if ( ch >= 'A' && ch <= 'Z' )
@@ -1845,6 +2586,12 @@ ProcessKeyPress( int ch )
         return;
     }
 
+    if ( ch == 't' )
+    {
+        LogEventStats(  );
+        return;
+    }
+
     /* ignore if channel is not in use */
     if ( !Config.LoRaDevices[Channel].InUse )
     {
@@ -1860,27 +2607,36 @@ ProcessKeyPress( int ch )
                            Config.LoRaDevices[Channel].AFC ? "AFC" : "   " );
             break;
         case 'a':
-            ReTune( Channel, 0.1 );
+            FreqShift = 0.1;
             break;
         case 'z':
-            ReTune( Channel, -0.1 );
+            FreqShift = -0.1;
             break;
         case 's':
-            ReTune( Channel, 0.01 );
+            FreqShift = 0.01;
             break;
         case 'x':
-            ReTune( Channel, -0.01 );
+            FreqShift = -0.01;
             break;
         case 'd':
-            ReTune( Channel, 0.001 );
+            FreqShift = 0.001;
             break;
         case 'c':
-            ReTune( Channel, -0.001 );
+            FreqShift = -0.001;
             break;
         default:
             //LogMessage("KeyPress %d\n", ch);
             return;
     }
+
+    if ( FreqShift != 0 )
+    {
+        radio_command_t Command;
+
+        Command.Type = RADIO_CMD_RETUNE;
+        Command.Frequency = FreqShift;
+        RadioPost( &Radios[Channel], &Command );
+    }
 }
 
 int
@@ -1986,149 +2742,231 @@ GetTextMessageToUpload( int Channel, char *Message )
     return Result;
 }
 
+// Ask the payload last heard sending SSDV on this channel for the packets
+// we're missing, in binary if it's been configured to understand that.
+// Returns the message length, or 0 if there's nothing to ask for.
 int
-GetExternalListOfMissingSSDVPackets( int Channel, char *Message )
+GetListOfMissingSSDVPackets( int Channel, char *Message )
 {
-    // First, create request file
-    FILE *fp;
-
-    // LogMessage("GetExternalListOfMissingSSDVPackets()\n");
+    char Callsign[7];
+    int Length;
 
-    // if ((fp = fopen("get_list.txt", "wt")) != NULL)
+    strcpy( Callsign, Config.LoRaDevices[Channel].SSDVCallsign );
+    if ( !Callsign[0] )
     {
-        int i;
-
-        // fprintf(fp, "No Message\n");
-        // fclose(fp);
-
-        // LogMessage("File created\n");
-
-        // Now wait for uplink.txt file to appear.
-        // Timeout before the end of our Tx slot if no file appears
+        return 0;
+    }
 
-        for ( i = 0; i < 20; i++ )
+    if ( Config.LoRaDevices[Channel].BinaryResend )
+    {
+        Length = SSDVImageBinaryResendRequest( Callsign,
+                                               ( unsigned char * ) Message,
+                                               255 );
+        if ( Length )
         {
-            if ( ( fp = fopen( "uplink.txt", "r" ) ) )
-            {
-                Message[0] = '\0';
-                fgets( Message, 256, fp );
-
-                fclose( fp );
+            LogMessage( "Ch%d: Binary resend request, %d bytes\n", Channel,
+                        Length );
+        }
+        return Length;
+    }
 
-                LogMessage( "Got uplink.txt %d bytes\n", strlen( Message ) );
+    if ( SSDVImageResendRequest( Callsign, Message, 255 ) )
+    {
+        LogMessage( "Ch%d: Resend request %s", Channel, Message );
+        return strlen( Message ) + 1;
+    }
 
-                // remove("get_list.txt");
-                remove( "uplink.txt" );
+    return 0;
+}
 
-                return strlen( Message );
-            }
+// In implicit mode the tracker is listening for a fixed 255 bytes, so
+// only explicit mode uplinks can be cut to the length of the message.
+// Nothing longer than 255 bytes can be sent, so longer messages (e.g. a
+// long SMS) are cut short, as they always were.
+int
+UplinkLength( int Channel, int Length )
+{
+    int Mode, ImplicitOrExplicit;
 
-            usleep( 100000 );
-        }
+    Mode = Config.LoRaDevices[Channel].UplinkMode;
+    ImplicitOrExplicit = ( Mode >= 0 ) ? LoRaModes[Mode].ImplicitOrExplicit :
+        Config.LoRaDevices[Channel].ImplicitOrExplicit;
 
-        // LogMessage("Timed out waiting for file\n");
-        // remove("get_list.txt");
+    if ( ( ImplicitOrExplicit == IMPLICIT_MODE ) || ( Length > 255 ) )
+    {
+        return 255;
     }
 
-    return 0;
+    return Length;
 }
 
+#define UPLINK_PREPARE_MS   500
 
-void SendUplinkMessage( int Channel )
+void SendUplinkMessage( int Channel, const struct timespec *SendAt )
 {
-    char Message[512];
+    char Message[512] = "";
+    int Length;
 
     // Decide what type of message we need to send
     if ( GetTextMessageToUpload( Channel, Message ) )
     {
-        SendLoRaData( Channel, Message, 255 );
+        QueueLoRaData( Channel, Message,
+                       UplinkLength( Channel, strlen( Message ) + 1 ), SendAt );
     }
-    else if ( GetExternalListOfMissingSSDVPackets( Channel, Message ) )
+    else if ( ( Length = GetListOfMissingSSDVPackets( Channel, Message ) ) )
     {
-        SendLoRaData( Channel, Message, 255 );
+        QueueLoRaData( Channel, Message, UplinkLength( Channel, Length ),
+                       SendAt );
     }
 }
 
-void
-rjh_post_message( int Channel, char *buffer )
+// Start of the first uplink slot for Channel after After.  Slots are
+// UplinkTime seconds into each UplinkCycle, counting cycles from local
+// midnight.
+time_t
+NextUplinkSlot( int Channel, time_t After )
 {
-    if ( Config.LoRaDevices[Channel].Sending )
+    struct tm tm;
+    time_t Midnight, Slot;
+    int Cycle, Offset;
+
+    Cycle = Config.LoRaDevices[Channel].UplinkCycle;
+    Offset = Config.LoRaDevices[Channel].UplinkTime;
+
+    localtime_r( &After, &tm );
+    Midnight = After - ( tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec );
+
+    Slot = Midnight + ( ( After - Midnight ) / Cycle ) * Cycle + Offset;
+    while ( Slot <= After )
     {
-        Config.LoRaDevices[Channel].Sending = 0;
-        // LogMessage("Ch%d: End of Tx\n", Channel);
+        Slot += Cycle;
+    }
 
-        setLoRaMode( Channel );
-        SetDefaultLoRaParameters( Channel );
-        startReceiving( Channel );
+    // Cycles restart at midnight
+    if ( Slot >= Midnight + 86400 )
+    {
+        Slot = Midnight + 86400 + Offset;
     }
-    else
+
+    return Slot;
+}
+
+// Sleep until the CLOCK_REALTIME time When, waking every 100ms to check for
+// shutdown.  Returns 0 if we're shutting down.
+int
+SleepUntil( const struct timespec *When )
+{
+    struct timespec Now, Until;
+
+    while ( run )
     {
-        int Bytes;
-        char Message[257];
+        clock_gettime( CLOCK_REALTIME, &Now );
+        if ( TimespecNS( &Now ) >= TimespecNS( When ) )
+        {
+            return 1;
+        }
 
-        memcpy( Message + 1, buffer, 256 );
+        Until = Now;
+        Until.tv_nsec += 100000000L;
+        Until.tv_sec += Until.tv_nsec / 1000000000L;
+        Until.tv_nsec %= 1000000000L;
+        if ( TimespecNS( When ) < TimespecNS( &Until ) )
+        {
+            Until = *When;
+        }
 
-        // hexdump_buffer ("RJH Raw Data", Message, 257);
+        clock_nanosleep( CLOCK_REALTIME, TIMER_ABSTIME, &Until, NULL );
+    }
 
-        Bytes = strlen( buffer );
+    return 0;
+}
+
+// Uplink scheduler.  Builds each channel's uplink message a little ahead of
+// its slot and hands it to the radio thread, which sends it on the slot
+// boundary.
+void *
+UplinkLoop( void *some_void_ptr )
+{
+    time_t Slots[MAX_LORA_DEVICES];
+    int Channel;
 
-        if ( Bytes > 0 )
+    for ( Channel = 0; Channel < Config.LoRaDeviceCount; Channel++ )
+    {
+        Slots[Channel] = 0;
+        if ( Config.LoRaDevices[Channel].InUse
+             && ( Config.LoRaDevices[Channel].UplinkTime > 0 )
+             && ( Config.LoRaDevices[Channel].UplinkCycle > 0 ) )
         {
-            if ( Config.LoRaDevices[Channel].ActivityLED >= 0 )
-            {
-                digitalWrite( Config.LoRaDevices[Channel].ActivityLED, 1 );
-                LEDCounts[Channel] = 5;
-            }
+            Slots[Channel] = NextUplinkSlot( Channel, time( NULL ) );
+        }
+    }
 
-            if ( Message[1] == '!' )
-            {
-                ProcessUploadMessage( Channel, Message + 1 );
-            }
-            else if ( Message[1] == '^' )
-            {
-                ProcessCallingMessage( Channel, Message + 1 );
-            }
-            else if ( Message[1] == '$' )
-            {
-                //LogMessage("Ch %d: Uploaded message %s\n", Channel, Message+1);
-                ProcessTelemetryMessage( Channel, Message + 1 );
-            }
-            else if ( Message[1] == '>' )
-            {
-                LogMessage( "Flight Controller message %d bytes = %s", Bytes,
-                            Message + 1 );
-            }
-            else if ( Message[1] == '*' )
-            {
-                LogMessage( "Uplink Command message %d bytes = %s", Bytes,
-                            Message + 1 );
-            }
-            else if ( Message[1] == 0x66 || Message[1] == 0x68 )
-            {
-                ProcessSSDVMessage( Channel, Message );
-            }
-            else
+    while ( run )
+    {
+        struct timespec PrepareAt, SendAt;
+        long long Lead;
+        int Next;
+
+        Next = -1;
+        for ( Channel = 0; Channel < Config.LoRaDeviceCount; Channel++ )
+        {
+            if ( Slots[Channel] && ( ( Next < 0 ) || ( Slots[Channel] < Slots[Next] ) ) )
             {
-                LogMessage( "Unknown packet type is %02Xh, RSSI %d\n",
-                            Message[1], readRegister( Channel,
-                                                      REG_PACKET_RSSI ) -
-                            157 );
-                ChannelPrintf( Channel, 3, 1, "Unknown Packet %d, %d bytes",
-                               Message[0], Bytes );
-                Config.LoRaDevices[Channel].UnknownCount++;
+                Next = Channel;
             }
+        }
+        if ( Next < 0 )
+        {
+            break;
+        }
 
-            Config.LoRaDevices[Channel].LastPacketAt = time( NULL );
+        // Don't prepare so early that we overtake the previous slot
+        Lead = UPLINK_PREPARE_MS;
+        if ( Lead > Config.LoRaDevices[Next].UplinkCycle * 500LL )
+        {
+            Lead = Config.LoRaDevices[Next].UplinkCycle * 500LL;
+        }
 
-            if ( Config.LoRaDevices[Channel].InCallingMode
-                 && ( Config.CallingTimeout > 0 ) )
-            {
-                Config.LoRaDevices[Channel].ReturnToCallingModeAt =
-                    time( NULL ) + Config.CallingTimeout;
-            }
+        SendAt.tv_sec = Slots[Next];
+        SendAt.tv_nsec = 0;
+        PrepareAt.tv_sec = Slots[Next] - ( Lead + 999 ) / 1000;
+        PrepareAt.tv_nsec = ( ( Lead + 999 ) / 1000 * 1000 - Lead ) * 1000000L;
 
-            ShowPacketCounts( Channel );
+        if ( !SleepUntil( &PrepareAt ) )
+        {
+            break;
         }
+
+        SendUplinkMessage( Next, &SendAt );
+
+        Slots[Next] = NextUplinkSlot( Next, Slots[Next] );
+    }
+
+    return NULL;
+}
+
+// Inject a test packet into the pipeline as if it had been received on
+// Channel
+void
+rjh_post_message( int Channel, char *buffer, int Length )
+{
+    // End of transmission is handled by the radio thread, so just don't
+    // inject anything while the channel is sending
+    if ( !Config.LoRaDevices[Channel].Sending && ( Length > 0 ) )
+    {
+        char Message[257];
+        struct timespec RxTime;
+
+        clock_gettime( CLOCK_REALTIME, &RxTime );
+
+        if ( Length > 255 )
+            Length = 255;
+        memcpy( Message + 1, buffer, Length );
+        Message[Length + 1] = '\0';
+
+        // hexdump_buffer ("RJH Raw Data", Message, 257);
+
+        PublishPacket( Channel, Message, Length, NULL, &RxTime );
     }
 }
 
@@ -2138,8 +2976,10 @@ main( int argc, char **argv )
     int ch;
     int LoopPeriod;
 	int Channel;
-    pthread_t SSDVThread, FTPThread, NetworkThread, HabitatThread,
-        ServerThread;
+    pthread_t SSDVThread, NetworkThread, HabitatThread,
+        ServerThread, UplinkThread, PacketThreads[MAX_LORA_DEVICES],
+        RadioThreads[MAX_LORA_DEVICES];
+    radio_command_t Command;
     WINDOW *mainwin;
 
     if ( prog_count( "gateway" ) > 1 )
@@ -2158,15 +2998,16 @@ main( int argc, char **argv )
     nodelay( stdscr, TRUE );
     keypad( stdscr, TRUE );
 
-    LEDCounts[0] = 0;
-    LEDCounts[1] = 0;
-
     // Remove any old SSDV files
     // system("rm -f /tmp/*.bin");  
 
     LoadConfigFile();
+    InitChannelWindows(  );
+    BuildRegisterImages(  );
     LoadPayloadFiles(  );
 
+    SubscribePacketHandlers(  );
+
     int result;
 
     result = pipe( telem_pipe_fd );
@@ -2183,26 +3024,69 @@ main( int argc, char **argv )
         return 1;
     }
 
-    if ( wiringPiSetup(  ) < 0 )
+    if ( HalSetup(  ) < 0 )
     {
-        fprintf( stderr, "Failed to open wiringPi\n" );
+        fprintf( stderr, "Failed to initialise GPIO\n" );
         exit( 1 );
     }
 
-    if ( Config.LoRaDevices[0].ActivityLED >= 0 )
-        pinMode( Config.LoRaDevices[0].ActivityLED, OUTPUT );
-    if ( Config.LoRaDevices[1].ActivityLED >= 0 )
-        pinMode( Config.LoRaDevices[1].ActivityLED, OUTPUT );
+    for ( Channel = 0; Channel < Config.LoRaDeviceCount; Channel++ )
+    {
+        LEDCounts[Channel] = 0;
+        if ( Config.LoRaDevices[Channel].ActivityLED >= 0 )
+            HalPinMode( Config.LoRaDevices[Channel].ActivityLED, HAL_OUTPUT );
+    }
     if ( Config.InternetLED >= 0 )
-        pinMode( Config.InternetLED, OUTPUT );
+        HalPinMode( Config.InternetLED, HAL_OUTPUT );
     if ( Config.NetworkLED >= 0 )
-        pinMode( Config.NetworkLED, OUTPUT );
+        HalPinMode( Config.NetworkLED, HAL_OUTPUT );
+
+    // Packet workers must be running before the DIO0 interrupts are enabled
+    for ( Channel = 0; Channel < Config.LoRaDeviceCount; Channel++ )
+    {
+        RadioInit( &Radios[Channel] );
+        RxQueueInit( &RxQueues[Channel] );
+
+        if ( pthread_create
+             ( &PacketThreads[Channel], NULL, PacketLoop,
+               ( void * ) ( long ) Channel ) )
+        {
+            fprintf( stderr, "Error creating packet thread\n" );
+            return 1;
+        }
+    }
+
+    for ( Channel = 0; Channel < Config.LoRaDeviceCount; Channel++ )
+    {
+        setupRFM98( Channel );
+    }
+
+    // From here on each chip belongs to its radio thread
+    for ( Channel = 0; Channel < Config.LoRaDeviceCount; Channel++ )
+    {
+        if ( Config.LoRaDevices[Channel].InUse )
+        {
+            if ( pthread_create
+                 ( &RadioThreads[Channel], NULL, RadioLoop,
+                   ( void * ) ( long ) Channel ) )
+            {
+                fprintf( stderr, "Error creating radio thread\n" );
+                return 1;
+            }
+        }
+    }
 
-    setupRFM98( 0 );
-    setupRFM98( 1 );
+    // Exits straight away if there are no uplink slots configured
+    if ( pthread_create( &UplinkThread, NULL, UplinkLoop, NULL ) )
+    {
+        fprintf( stderr, "Error creating uplink thread\n" );
+        return 1;
+    }
 
-    ShowPacketCounts( 0 );
-    ShowPacketCounts( 1 );
+    for ( Channel = 0; Channel < Config.LoRaDeviceCount; Channel++ )
+    {
+        ShowPacketCounts( Channel );
+    }
 
 
     LoopPeriod = 0;
@@ -2217,11 +3101,7 @@ main( int argc, char **argv )
         return 1;
     }
 
-    if ( pthread_create( &FTPThread, NULL, FTPLoop, NULL ) )
-    {
-        fprintf( stderr, "Error creating FTP thread\n" );
-        return 1;
-    }
+    StartConversionThreads(  );
 
 
     // Initialise the vars
@@ -2266,11 +3146,13 @@ main( int argc, char **argv )
     char ssdv_buff[257];
     int message_count = 0;
 
+    // The simulated radios already receive these files, so feeding them
+    // in here as well would deliver everything twice
     char fileName[20] = "telem.txt";
-    FILE *file_telem = fopen( fileName, "r" );
+    FILE *file_telem = HalSimulated(  ) ? NULL : fopen( fileName, "r" );
 
     char fileName_ssdv[20] = "ssdv.bin";
-    FILE *file_ssdv = fopen( fileName_ssdv, "rb" );
+    FILE *file_ssdv = HalSimulated(  ) ? NULL : fopen( fileName_ssdv, "rb" );
 
     LogMessage( "Starting now ...\n" );
 
@@ -2288,7 +3170,7 @@ main( int argc, char **argv )
             {
                 if ( fgets( buffer, sizeof( buffer ), file_telem ) )
                 {
-                    rjh_post_message( 1, buffer );
+                    rjh_post_message( 1, buffer, strlen( buffer ) );
                 }
             }
             message_count++;    // We need to increment this here or we will lock
@@ -2300,7 +3182,7 @@ main( int argc, char **argv )
                 if ( fread( ssdv_buff, 256, 1, file_ssdv ) )
                 {
                     ssdv_buff[256] = '\0';
-                    rjh_post_message( 1, &ssdv_buff[1] );
+                    rjh_post_message( 1, &ssdv_buff[1], 255 );
                 }
             }
             message_count++;    // We need to increment this here or we will lock
@@ -2311,25 +3193,19 @@ main( int argc, char **argv )
         if ( LoopPeriod > 1000 )
         {
             // Every 1 second
-            time_t now;
-            struct tm *tm;
-
-            now = time( 0 );
-            tm = localtime( &now );
-
             LoopPeriod = 0;
 
 
-            for ( Channel = 0; Channel <= 1; Channel++ )
+            for ( Channel = 0; Channel < Config.LoRaDeviceCount; Channel++ )
             {
                 if ( Config.LoRaDevices[Channel].InUse )
                 {
 
                     ShowPacketCounts( Channel );
 
-                    ChannelPrintf( Channel, 12, 1, "Current RSSI = %4d   ",
-                                   readRegister( Channel,
-                                                 REG_CURRENT_RSSI ) - 157 );
+                    ChannelPrintf( Channel, 12, 1,
+                                   "Current RSSI = %4d  %-7s", Radios[Channel].CurrentRSSI,
+                                   RadioStateName( Radios[Channel].State ) );
 
                     // if (Config.LoRaDevices[Channel].LastPacketAt > 0)
                     // {
@@ -2349,11 +3225,10 @@ main( int argc, char **argv )
 
                         LogMessage( "Return to calling mode\n" );
 
-                        setLoRaMode( Channel );
+                        Command.Type = RADIO_CMD_DEFAULT;
+                        RadioPost( &Radios[Channel], &Command );
 
-                        SetDefaultLoRaParameters( Channel );
-
-                        setMode( Channel, RF98_MODE_RX_CONTINUOUS );
+                        ShowDefaultLoRaParameters( Channel );
 
                         ChannelPrintf( Channel, 1, 1,
                                        "Channel %d %sMHz  %s mode", Channel,
@@ -2362,52 +3237,59 @@ main( int argc, char **argv )
                                              [Channel].SpeedMode] );
                     }
 
-                    if ( ( Config.LoRaDevices[Channel].UplinkTime > 0 )
-                         && ( Config.LoRaDevices[Channel].UplinkCycle > 0 ) )
-                    {
-                        long CycleSeconds;
-
-
-                        CycleSeconds =
-                            ( tm->tm_hour * 3600 + tm->tm_min * 60 +
-                              tm->tm_sec ) %
-                            Config.LoRaDevices[Channel].UplinkCycle;
-
-                        if ( CycleSeconds ==
-                             Config.LoRaDevices[Channel].UplinkTime )
-                        {
-                            // LogMessage("%02d:%02d:%02d - Time to send uplink message\n", tm->tm_hour, tm->tm_min, tm->tm_sec);
-
-                            SendUplinkMessage( Channel );
-                        }
-                    }
-
                     if ( LEDCounts[Channel]
                          && ( Config.LoRaDevices[Channel].ActivityLED >= 0 ) )
                     {
                         if ( --LEDCounts[Channel] == 0 )
                         {
-                            digitalWrite( Config.LoRaDevices[Channel].
+                            HalDigitalWrite( Config.LoRaDevices[Channel].
                                           ActivityLED, 0 );
                         }
                     }
                 }
             }
+
+            SSDVImageFlush( time( NULL ), 0 );
         }
 
-        delay( 10 );
+        HalDelay( 10 );
         LoopPeriod += 10;
     }
 	
 	LogMessage("Disabling DIO0 ISRs\n");
-	for (Channel=0; Channel<2; Channel++)
+	for (Channel=0; Channel<Config.LoRaDeviceCount; Channel++)
 	{
 		if (Config.LoRaDevices[Channel].InUse)
 		{
-			wiringPiISR(Config.LoRaDevices[Channel].DIO0, INT_EDGE_RISING, &DIO_Ignore_Interrupt_0);
+			HalISR(Config.LoRaDevices[Channel].DIO0, &DIO_Ignore_Interrupt, &Radios[Channel]);
 		}
 	}
 
+    pthread_join( UplinkThread, NULL );
+
+    LogMessage( "Waiting for radio threads to close ...\n" );
+    for ( Channel = 0; Channel < Config.LoRaDeviceCount; Channel++ )
+    {
+        if ( Config.LoRaDevices[Channel].InUse )
+        {
+            pthread_join( RadioThreads[Channel], NULL );
+        }
+    }
+    LogMessage( "Radio threads closed\n" );
+
+    LogMessage( "Waiting for packet threads to close ...\n" );
+    for ( Channel = 0; Channel < Config.LoRaDeviceCount; Channel++ )
+    {
+        pthread_join( PacketThreads[Channel], NULL );
+    }
+    LogMessage( "Packet threads closed\n" );
+
+    // Write out any partly received images
+    StopConversionThreads(  );
+    SSDVImageFlush( time( NULL ), 1 );
+
+    LogEventStats(  );
+
     LogMessage( "Closing SSDV pipe\n" );
     close( ssdv_pipe_fd[1] );
 
@@ -2436,13 +3318,14 @@ main( int argc, char **argv )
     curl_global_cleanup(  );    // RJH thread safe
 
     if ( Config.NetworkLED >= 0 )
-        digitalWrite( Config.NetworkLED, 0 );
+        HalDigitalWrite( Config.NetworkLED, 0 );
     if ( Config.InternetLED >= 0 )
-        digitalWrite( Config.InternetLED, 0 );
-    if ( Config.LoRaDevices[0].ActivityLED >= 0 )
-        digitalWrite( Config.LoRaDevices[0].ActivityLED, 0 );
-    if ( Config.LoRaDevices[1].ActivityLED >= 0 )
-        digitalWrite( Config.LoRaDevices[1].ActivityLED, 0 );
+        HalDigitalWrite( Config.InternetLED, 0 );
+    for ( Channel = 0; Channel < Config.LoRaDeviceCount; Channel++ )
+    {
+        if ( Config.LoRaDevices[Channel].ActivityLED >= 0 )
+            HalDigitalWrite( Config.LoRaDevices[Channel].ActivityLED, 0 );
+    }
 
     return 0;
 
@@ -1,14 +1,18 @@
 #ifndef _H_Gateway
 #define _H_Gateway
 
-int receiveMessage( int Channel, char *message );
+#include "rxqueue.h"
+
+int receiveMessage( int Channel, rx_packet_t * Packet );
 void hexdump_buffer( const char *title, const char *buffer,
                      const int len_buffer );
-void LogPacket( int Channel, int8_t SNR, int RSSI, double FreqError,
-                int Bytes, unsigned char MessageType );
+void FormatTimestamp( char *Buffer, const struct timespec *Time );
+void LogPacket( int Channel, const rx_packet_t * Packet, unsigned int Copy,
+                int Best );
 void LogTelemetryPacket( char *Telemetry );
 void LogMessage( const char *format, ... );
 void ChannelPrintf( int Channel, int row, int column, const char *format,
                     ... );
+int ReadInteger( FILE * fp, char *keyword, int NeedValue, int DefaultValue );
 
 #endif
@@ -1,18 +1,17 @@
 #include <curses.h>
+#include <time.h>
 
 #define RUNNING 1               // The main program is running
 #define STOPPED 0               // The main program has stopped
+
+#define MAX_LORA_DEVICES 8      // Most LoRa modules one gateway can drive
 struct TSSDVPacket  {
     char Packet[256];
      char Callsign[7];
  };
- struct TSSDVPackets  {
-    int ImageNumber;
-     int HighestPacket;
-     bool Packets[1024];
- };
  struct TLoRaDevice  {
     int InUse;
+     int SPIBus, SPIChipSelect;
      int DIO0;
      int DIO5;
      char Frequency[16];
@@ -29,18 +28,14 @@
      int CurrentBandwidth;
     WINDOW * Window;
     unsigned int TelemetryCount, SSDVCount, BadCRCCount, UnknownCount;
+     unsigned int BadChecksumCount;    // Telemetry that failed its *XXXX check
+     unsigned int DuplicateCount;      // Already heard, on this or another channel
+     unsigned int SSDVFixedCount;      // SSDV packets repaired by the FEC
+     unsigned int SSDVBadCount;        // and ones it couldn't repair
     int Sending;
     char Telemetry[256];
-     char Payload[16], Time[12];
-     unsigned int Counter, LastCounter;
-     unsigned long Seconds;
-     double PredictedLongitude, PredictedLatitude;
-     double Longitude, Latitude;
-     unsigned int Altitude, PreviousAltitude;
-     unsigned int Satellites;
-     unsigned long LastPositionAt;
      time_t LastPacketAt, LastSSDVPacketAt, LastTelemetryPacketAt;
-     float AscentRate;
+     char SSDVCallsign[7];       // Sender of the last SSDV packet, for resend requests
      time_t ReturnToCallingModeAt;
      int InCallingMode;
      int ActivityLED;
@@ -48,16 +43,11 @@
 double UplinkFrequency;
 
 int UplinkMode;
-    int Speed, Heading, PredictedTime, CompassActual, CompassTarget,
-        AirDirection, ServoLeft, ServoRight, ServoTime, FlightMode;
-     double cda, PredictedLandingSpeed, AirSpeed, GlideRatio;
     
         // Normal (non TDM) uplink
     int UplinkTime;
      int UplinkCycle;
-    
-        // SSDV Packet Log
-    struct TSSDVPackets SSDVPackets[3];
+     int BinaryResend;          // Tracker takes SSDV resend requests in binary
  };
  struct TConfig  {
     char Tracker[16];
@@ -71,7 +61,8 @@ int UplinkMode;
      char ftpUser[32];
      char ftpPassword[32];
      char ftpFolder[64];
-     struct TLoRaDevice LoRaDevices[2];
+     int LoRaDeviceCount;      // Channels 0 to LoRaDeviceCount-1 may be in use
+     struct TLoRaDevice LoRaDevices[MAX_LORA_DEVICES];
      int NetworkLED;
      int InternetLED;
      int ServerPort;
@@ -89,12 +80,14 @@ typedef struct {
     short int Channel;
     char Telemetry[257];
     int Packet_Number;
+    struct timespec RxTime;     // When the packet arrived, CLOCK_REALTIME
 } telemetry_t;
 
 typedef struct {
     short int Channel;
     char SSDV_Packet[257];
     int Packet_Number;
+    struct timespec RxTime;
 } ssdv_t;
 
 extern struct TConfig Config;
@@ -15,13 +15,12 @@
 #include <math.h>
 #include <pthread.h>
 #include <curl/curl.h>
-#include <wiringPi.h>
 
 #include "base64.h"
 #include "habitat.h"
 #include "global.h"
+#include "json.h"
 #include "sha256.h"
-#include "wiringPi.h"
 #include "gateway.h"
 
 extern int telem_pipe_fd[2];
@@ -39,11 +38,13 @@ habitat_write_data( void *buffer, size_t size, size_t nmemb, void *userp )
 void
 hash_to_hex( unsigned char *hash, char *line )
 {
+    static const char hex_digits[] = "0123456789abcdef";
     int idx;
 
     for ( idx = 0; idx < 32; idx++ )
     {
-        sprintf( &( line[idx * 2] ), "%02x", hash[idx] );
+        line[idx * 2] = hex_digits[hash[idx] >> 4];
+        line[idx * 2 + 1] = hex_digits[hash[idx] & 0x0F];
     }
     line[64] = '\0';
 
@@ -67,7 +68,8 @@ UploadTelemetryPacket( telemetry_t * t )
         SHA256_CTX ctx;
         unsigned char hash[32];
         char doc_id[100];
-        char json[1000], now[32];
+        char json[1000], now[32], created[32];
+        json_writer_t Writer;
         char Sentence[512];
         struct curl_slist *headers = NULL;
         time_t rawtime;
@@ -78,6 +80,9 @@ UploadTelemetryPacket( telemetry_t * t )
         tm = gmtime( &rawtime );
         strftime( now, sizeof( now ), "%Y-%0m-%0dT%H:%M:%SZ", tm );
 
+        // and when it was actually received
+        FormatTimestamp( created, &t->RxTime );
+
         // So that the response to the curl PUT doesn't mess up my finely crafted display!
         curl_easy_setopt( curl, CURLOPT_WRITEFUNCTION, habitat_write_data );
 
@@ -108,10 +113,27 @@ UploadTelemetryPacket( telemetry_t * t )
         char counter[10];
         sprintf( counter, "%d", t->Packet_Number );
 
-        // Create json with the base64 data in hex, the tracker callsign and the current timestamp
-        sprintf( json,
-                 "{\"data\": {\"_raw\": \"%s\"},\"receivers\": {\"%s\": {\"time_created\": \"%s\",\"time_uploaded\": \"%s\"}}}",
-                 base64_data, Config.Tracker, now, now );
+        // Create json with the base64 data, the tracker callsign and the
+        // current timestamp
+        JSONBegin( &Writer, json, sizeof( json ) );
+        JSONBeginObject( &Writer, NULL );
+        JSONBeginObject( &Writer, "data" );
+        JSONStringN( &Writer, "_raw", base64_data, base64_length );
+        JSONEndObject( &Writer );
+        JSONBeginObject( &Writer, "receivers" );
+        JSONBeginObject( &Writer, Config.Tracker );
+        JSONString( &Writer, "time_created", created );
+        JSONString( &Writer, "time_uploaded", now );
+        JSONEndObject( &Writer );
+        JSONEndObject( &Writer );
+        JSONEndObject( &Writer );
+
+        if ( JSONEnd( &Writer ) < 0 )
+        {
+            LogMessage( "Telemetry upload too big, not sent\n" );
+            curl_easy_cleanup( curl );
+            return;
+        }
 
         // LogTelemetryPacket(json);
 
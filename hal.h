@@ -0,0 +1,29 @@
+#ifndef _H_Hal
+#define _H_Hal
+
+// Hardware abstraction layer.  All SPI and GPIO access to the LoRa modules
+// (and the status LEDs) goes through these calls.  hal_pi.c implements them
+// with wiringPi for a real Raspberry Pi; hal_sim.c implements them with a
+// register-level SX127x simulator for the gateway-sim build.
+//
+// Channel is the LoRa channel number (0 to MAX_LORA_DEVICES-1); each channel
+// is opened on its own SPI bus / chip select.  Interrupt handlers are called
+// with the Arg they were registered with, on a thread per pin.
+//
+// HalSimulated() is 1 for the simulator, whose radios receive packets from
+// telem.txt and ssdv.bin themselves.
+
+#define HAL_INPUT   0
+#define HAL_OUTPUT  1
+
+int HalSetup( void );
+int HalSPISetup( int Channel, int Bus, int ChipSelect, int Speed );
+int HalSPIDataRW( int Channel, unsigned char *data, int len );
+void HalPinMode( int Pin, int Mode );
+int HalDigitalRead( int Pin );
+void HalDigitalWrite( int Pin, int Value );
+int HalISR( int Pin, void ( *Function ) ( void * ), void *Arg );
+void HalDelay( unsigned int ms );
+int HalSimulated( void );
+
+#endif
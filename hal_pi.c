@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <linux/spi/spidev.h>
+#include <wiringPi.h>
+
+#include "global.h"
+#include "hal.h"
+
+// SPI is done directly through spidev rather than wiringPiSPI, which only
+// knows about the two chip selects on bus 0
+static int SPIHandles[MAX_LORA_DEVICES];
+static uint32_t SPISpeeds[MAX_LORA_DEVICES];
+
+// wiringPiISR() handlers take no argument, so each registered pin gets one
+// of these slots and a matching stub that passes the argument on
+struct TISRSlot {
+    int Pin;
+    void ( *Function ) ( void * );
+    void *Arg;
+};
+
+static struct TISRSlot ISRSlots[MAX_LORA_DEVICES];
+static int ISRSlotCount = 0;
+
+#define ISR_STUB( n ) \
+    static void ISRStub##n( void ) \
+    { \
+        ISRSlots[n].Function( ISRSlots[n].Arg ); \
+    }
+
+ISR_STUB( 0 )
+ISR_STUB( 1 )
+ISR_STUB( 2 )
+ISR_STUB( 3 )
+ISR_STUB( 4 )
+ISR_STUB( 5 )
+ISR_STUB( 6 )
+ISR_STUB( 7 )
+
+static void ( *const ISRStubs[MAX_LORA_DEVICES] ) ( void ) =
+{
+ISRStub0, ISRStub1, ISRStub2, ISRStub3, ISRStub4, ISRStub5, ISRStub6,
+        ISRStub7};
+
+int
+HalSetup( void )
+{
+    return wiringPiSetup(  );
+}
+
+int
+HalSPISetup( int Channel, int Bus, int ChipSelect, int Speed )
+{
+    char Device[32];
+    uint8_t Mode, Bits;
+    uint32_t Hz;
+    int fd;
+
+    if ( ( Channel < 0 ) || ( Channel >= MAX_LORA_DEVICES ) )
+    {
+        return -1;
+    }
+
+    sprintf( Device, "/dev/spidev%d.%d", Bus, ChipSelect );
+    if ( ( fd = open( Device, O_RDWR ) ) < 0 )
+    {
+        return -1;
+    }
+
+    Mode = SPI_MODE_0;
+    Bits = 8;
+    Hz = Speed;
+
+    if ( ( ioctl( fd, SPI_IOC_WR_MODE, &Mode ) < 0 )
+         || ( ioctl( fd, SPI_IOC_WR_BITS_PER_WORD, &Bits ) < 0 )
+         || ( ioctl( fd, SPI_IOC_WR_MAX_SPEED_HZ, &Hz ) < 0 ) )
+    {
+        close( fd );
+        return -1;
+    }
+
+    SPIHandles[Channel] = fd;
+    SPISpeeds[Channel] = Hz;
+
+    return fd;
+}
+
+int
+HalSPIDataRW( int Channel, unsigned char *data, int len )
+{
+    struct spi_ioc_transfer Transfer;
+
+    memset( &Transfer, 0, sizeof( Transfer ) );
+    Transfer.tx_buf = ( unsigned long ) data;
+    Transfer.rx_buf = ( unsigned long ) data;
+    Transfer.len = len;
+    Transfer.speed_hz = SPISpeeds[Channel];
+    Transfer.bits_per_word = 8;
+
+    return ioctl( SPIHandles[Channel], SPI_IOC_MESSAGE( 1 ), &Transfer );
+}
+
+void
+HalPinMode( int Pin, int Mode )
+{
+    pinMode( Pin, Mode == HAL_OUTPUT ? OUTPUT : INPUT );
+}
+
+int
+HalDigitalRead( int Pin )
+{
+    return digitalRead( Pin );
+}
+
+void
+HalDigitalWrite( int Pin, int Value )
+{
+    digitalWrite( Pin, Value );
+}
+
+int
+HalISR( int Pin, void ( *Function ) ( void * ), void *Arg )
+{
+    int Slot;
+
+    // Re-registering a pin just swaps its handler
+    for ( Slot = 0; Slot < ISRSlotCount; Slot++ )
+    {
+        if ( ISRSlots[Slot].Pin == Pin )
+        {
+            ISRSlots[Slot].Arg = Arg;
+            ISRSlots[Slot].Function = Function;
+            return 0;
+        }
+    }
+
+    if ( ISRSlotCount >= MAX_LORA_DEVICES )
+    {
+        return -1;
+    }
+
+    Slot = ISRSlotCount++;
+    ISRSlots[Slot].Pin = Pin;
+    ISRSlots[Slot].Arg = Arg;
+    ISRSlots[Slot].Function = Function;
+
+    return wiringPiISR( Pin, INT_EDGE_RISING, ISRStubs[Slot] );
+}
+
+void
+HalDelay( unsigned int ms )
+{
+    delay( ms );
+}
+
+int
+HalSimulated( void )
+{
+    return 0;
+}
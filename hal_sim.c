@@ -0,0 +1,643 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "global.h"
+#include "gateway.h"
+#include "crc.h"
+#include "sx127x.h"
+#include "hal.h"
+
+// Register-level SX127x simulator.  Each SPI channel gets a simulated chip
+// with its own register file, 256-byte FIFO, IRQ flags and DIO0/DIO5 lines.
+// An "air" thread per chip delivers packets into the FIFO while the chip is
+// in RX continuous mode, completes transmissions after the real LoRa airtime
+// for the programmed modem settings, and raises DIO0 exactly as the chip
+// would.  A separate ISR thread per chip calls the handler registered with
+// HalISR(), like wiringPi does on a Pi.
+//
+// Packets come from telem.txt (one sentence per line) and ssdv.bin (256-byte
+// SSDV packets) in the working folder, or are synthesised if neither exists.
+// Optional gateway.txt settings:
+//
+//   SimPacketInterval=<ms>  time between packets (default: back-to-back airtime)
+//   SimCRCErrors=<percent>  percentage of packets received with a bad CRC
+//   SimBinary=<percent>     percentage of generated telemetry sent as binary
+
+struct TSimChip {
+    int InUse;
+    int Channel;
+    pthread_mutex_t Lock;
+    uint8_t Registers[128];
+    uint8_t FIFO[256];
+    int DIO0;
+    struct timespec ModeReadyAt;
+    struct timespec NextPacketAt;
+    struct timespec TxDoneAt;
+    unsigned int Seed;
+    unsigned long PacketCount;
+    FILE *TelemetryFile;
+    FILE *SSDVFile;
+    pthread_t AirThread;
+
+    // ISR dispatch
+    void ( *ISR ) ( void * );
+    void *ISRArg;
+    int ISRPending;
+    pthread_cond_t ISRCond;
+    pthread_t ISRThread;
+};
+
+static struct TSimChip Chips[MAX_LORA_DEVICES];
+static int SimPacketInterval = 0;
+static int SimCRCErrors = 0;
+static int SimBinary = 0;
+
+static void
+TimeAddSeconds( struct timespec *t, double Seconds )
+{
+    long ns;
+
+    ns = t->tv_nsec + ( long ) ( Seconds * 1e9 );
+    t->tv_sec += ns / 1000000000L;
+    t->tv_nsec = ns % 1000000000L;
+}
+
+static int
+TimeReached( struct timespec *Now, struct timespec *t )
+{
+    return ( Now->tv_sec > t->tv_sec ) || ( ( Now->tv_sec == t->tv_sec )
+                                            && ( Now->tv_nsec >=
+                                                 t->tv_nsec ) );
+}
+
+static struct TSimChip *
+ChipForPin( int Pin, int *IsDIO0 )
+{
+    int Channel;
+
+    for ( Channel = 0; Channel < MAX_LORA_DEVICES; Channel++ )
+    {
+        if ( Chips[Channel].InUse )
+        {
+            if ( Config.LoRaDevices[Channel].DIO0 == Pin )
+            {
+                *IsDIO0 = 1;
+                return &Chips[Channel];
+            }
+            if ( Config.LoRaDevices[Channel].DIO5 == Pin )
+            {
+                *IsDIO0 = 0;
+                return &Chips[Channel];
+            }
+        }
+    }
+
+    return NULL;
+}
+
+// Time on air in seconds for a packet of Length bytes, from the chip's
+// current modem configuration (SX1276 datasheet section 4.1.1.7)
+static double
+SimAirtime( struct TSimChip *Chip, int Length )
+{
+    static const double Bandwidths[10] =
+        { 7800, 10400, 15600, 20800, 31250, 41700, 62500, 125000, 250000,
+        500000
+    };
+    int BandwidthIndex, CodingRate, Implicit, SF, CRC, LowDataRate;
+    int Numerator, Denominator, PayloadSymbols;
+    double SymbolTime;
+
+    BandwidthIndex = Chip->Registers[REG_MODEM_CONFIG] >> 4;
+    if ( BandwidthIndex > 9 )
+        BandwidthIndex = 9;
+    CodingRate = ( Chip->Registers[REG_MODEM_CONFIG] >> 1 ) & 7;
+    Implicit = Chip->Registers[REG_MODEM_CONFIG] & 1;
+    SF = Chip->Registers[REG_MODEM_CONFIG2] >> 4;
+    CRC = ( Chip->Registers[REG_MODEM_CONFIG2] >> 2 ) & 1;
+    LowDataRate = ( Chip->Registers[REG_MODEM_CONFIG3] >> 3 ) & 1;
+
+    if ( SF < 6 )
+        SF = 6;
+    if ( CodingRate < 1 )
+        CodingRate = 1;
+
+    SymbolTime = ( double ) ( 1 << SF ) / Bandwidths[BandwidthIndex];
+
+    Numerator = 8 * Length - 4 * SF + 28 + 16 * CRC - 20 * Implicit;
+    Denominator = 4 * ( SF - 2 * LowDataRate );
+    PayloadSymbols =
+        8 +
+        ( Numerator >
+          0 ? ( ( Numerator + Denominator - 1 ) / Denominator ) *
+          ( CodingRate + 4 ) : 0 );
+
+    return ( 8 + 4.25 ) * SymbolTime + PayloadSymbols * SymbolTime;
+}
+
+static void
+SimUpdateDIO0( struct TSimChip *Chip )
+{
+    int Mapping, Flags, Level;
+
+    Mapping = Chip->Registers[REG_DIO_MAPPING_1] >> 6;
+    Flags = Chip->Registers[REG_IRQ_FLAGS];
+
+    if ( Mapping == 0 )
+        Level = ( Flags & IRQ_RX_DONE ) != 0;
+    else if ( Mapping == 1 )
+        Level = ( Flags & IRQ_TX_DONE ) != 0;
+    else if ( Mapping == 2 )
+        Level = ( Flags & IRQ_CAD_DONE ) != 0;
+    else
+        Level = 0;
+
+    if ( Level && !Chip->DIO0 )
+    {
+        // Rising edge
+        Chip->ISRPending = 1;
+        pthread_cond_signal( &Chip->ISRCond );
+    }
+
+    Chip->DIO0 = Level;
+}
+
+static int
+SimNextPacket( struct TSimChip *Chip, uint8_t *Packet )
+{
+    char Line[256];
+    int Length;
+
+    Chip->PacketCount++;
+
+    // Same mix as a typical flight: nine image packets to one telemetry
+    if ( Chip->SSDVFile && ( Chip->PacketCount % 10 ) )
+    {
+        unsigned char SSDV[256];
+
+        if ( fread( SSDV, 256, 1, Chip->SSDVFile ) != 1 )
+        {
+            rewind( Chip->SSDVFile );
+            if ( fread( SSDV, 256, 1, Chip->SSDVFile ) != 1 )
+            {
+                return 0;
+            }
+        }
+
+        // Sync byte is not sent over LoRa
+        memcpy( Packet, SSDV + 1, 255 );
+        return 255;
+    }
+
+    if ( Chip->TelemetryFile )
+    {
+        if ( !fgets( Line, sizeof( Line ), Chip->TelemetryFile ) )
+        {
+            rewind( Chip->TelemetryFile );
+            if ( !fgets( Line, sizeof( Line ), Chip->TelemetryFile ) )
+            {
+                Line[0] = '\0';
+            }
+        }
+    }
+    else if ( ( rand_r( &Chip->Seed ) % 100 ) < SimBinary )
+    {
+        // struct TBinaryPacket, payload ID = channel
+        float Latitude, Longitude;
+        uint16_t Value;
+
+        Packet[0] = 0xC0 | Chip->Channel;
+        Value = Chip->PacketCount;
+        memcpy( Packet + 1, &Value, 2 );
+        Value = ( Chip->PacketCount * 5 / 2 ) % 43200;
+        memcpy( Packet + 3, &Value, 2 );
+        Latitude = 51.95 + Chip->PacketCount * 0.0001;
+        Longitude = -2.54 + Chip->PacketCount * 0.0001;
+        memcpy( Packet + 5, &Latitude, 4 );
+        memcpy( Packet + 9, &Longitude, 4 );
+        Value = ( Chip->PacketCount * 25 ) % 40000;
+        memcpy( Packet + 13, &Value, 2 );
+
+        return 15;
+    }
+    else
+    {
+        char Sentence[200];
+        unsigned long Seconds;
+
+        Seconds = Chip->PacketCount * 5;
+        sprintf( Sentence, "SIM%d,%lu,%02lu:%02lu:%02lu,%.5lf,%.5lf,%05lu",
+                 Chip->Channel, Chip->PacketCount, ( Seconds / 3600 ) % 24,
+                 ( Seconds / 60 ) % 60, Seconds % 60,
+                 51.95 + Chip->PacketCount * 0.0001,
+                 -2.54 + Chip->PacketCount * 0.0001,
+                 ( Chip->PacketCount * 25 ) % 40000 );
+        sprintf( Line, "$$%s*%04X\n", Sentence,
+                 CRC16( ( unsigned char * ) Sentence ) );
+    }
+
+    Length = strlen( Line );
+    if ( Length > 255 )
+        Length = 255;
+    memcpy( Packet, Line, Length );
+
+    return Length;
+}
+
+static void
+SimReceivePacket( struct TSimChip *Chip )
+{
+    uint8_t Packet[256];
+    int i, Length, Address, SNR, RSSI;
+    int32_t FEI;
+
+    memset( Packet, 0, sizeof( Packet ) );
+
+    if ( ( Length = SimNextPacket( Chip, Packet ) ) <= 0 )
+    {
+        return;
+    }
+
+    if ( Chip->Registers[REG_MODEM_CONFIG] & IMPLICIT_MODE )
+    {
+        // Implicit header: receiver always takes the programmed length
+        Length = Chip->Registers[REG_PAYLOAD_LENGTH];
+    }
+
+    // Packets are written at the FIFO RX byte pointer, wrapping at 256
+    Address = Chip->Registers[REG_FIFO_RX_BYTE_ADDR];
+    for ( i = 0; i < Length; i++ )
+    {
+        Chip->FIFO[( Address + i ) & 0xFF] = Packet[i];
+    }
+    Chip->Registers[REG_FIFO_RX_CURRENT_ADDR] = Address;
+    Chip->Registers[REG_FIFO_RX_BYTE_ADDR] = ( Address + Length ) & 0xFF;
+    Chip->Registers[REG_RX_NB_BYTES] = Length;
+
+    // Link quality
+    SNR = 5 + rand_r( &Chip->Seed ) % 6;
+    RSSI = -90 + rand_r( &Chip->Seed ) % 30;
+    Chip->Registers[REG_PACKET_SNR] = ( uint8_t ) ( int8_t ) ( SNR * 4 );
+    Chip->Registers[REG_PACKET_RSSI] = RSSI + 157;
+
+    // Frequency error of up to +/- 20 FEI counts (a few hundred Hz)
+    FEI = ( rand_r( &Chip->Seed ) % 41 ) - 20;
+    Chip->Registers[REG_FREQ_ERROR] = ( FEI >> 16 ) & 0x0F;
+    Chip->Registers[REG_FREQ_ERROR + 1] = ( FEI >> 8 ) & 0xFF;
+    Chip->Registers[REG_FREQ_ERROR + 2] = FEI & 0xFF;
+
+    Chip->Registers[REG_IRQ_FLAGS] |= IRQ_RX_DONE | IRQ_VALID_HEADER;
+    if ( ( SimCRCErrors > 0 )
+         && ( ( rand_r( &Chip->Seed ) % 100 ) < SimCRCErrors ) )
+    {
+        Chip->Registers[REG_IRQ_FLAGS] |= IRQ_PAYLOAD_CRC_ERROR;
+    }
+
+    SimUpdateDIO0( Chip );
+}
+
+static void
+SimSetOpMode( struct TSimChip *Chip, uint8_t Value )
+{
+    int OldMode, NewMode;
+    struct timespec Now;
+
+    OldMode = Chip->Registers[REG_OPMODE] & 0x07;
+    NewMode = Value & 0x07;
+
+    Chip->Registers[REG_OPMODE] = Value;
+
+    clock_gettime( CLOCK_MONOTONIC, &Now );
+
+    // DIO5 (ModeReady) drops until the oscillator / PLL has settled
+    Chip->ModeReadyAt = Now;
+    TimeAddSeconds( &Chip->ModeReadyAt, OldMode == 0 ? 250e-6 : 60e-6 );
+
+    if ( ( NewMode == 5 ) && ( OldMode != 5 ) )
+    {
+        // Entering RX continuous
+        Chip->Registers[REG_FIFO_RX_BYTE_ADDR] =
+            Chip->Registers[REG_FIFO_RX_BASE_AD];
+        Chip->NextPacketAt = Chip->ModeReadyAt;
+        TimeAddSeconds( &Chip->NextPacketAt,
+                        SimPacketInterval >
+                        0 ? SimPacketInterval /
+                        1000.0 : SimAirtime( Chip, 255 ) );
+    }
+    else if ( NewMode == 3 )
+    {
+        // Transmit whatever is in the FIFO
+        Chip->TxDoneAt = Chip->ModeReadyAt;
+        TimeAddSeconds( &Chip->TxDoneAt,
+                        SimAirtime( Chip,
+                                    Chip->Registers[REG_PAYLOAD_LENGTH] ) );
+    }
+}
+
+static uint8_t
+SimReadRegister( struct TSimChip *Chip, uint8_t Address )
+{
+    if ( Address == REG_FIFO )
+    {
+        return Chip->FIFO[Chip->Registers[REG_FIFO_ADDR_PTR]++];
+    }
+
+    if ( Address == REG_CURRENT_RSSI )
+    {
+        return 157 - 110 + rand_r( &Chip->Seed ) % 4;
+    }
+
+    return Chip->Registers[Address & 0x7F];
+}
+
+static void
+SimWriteRegister( struct TSimChip *Chip, uint8_t Address, uint8_t Value )
+{
+    switch ( Address )
+    {
+        case REG_FIFO:
+            Chip->FIFO[Chip->Registers[REG_FIFO_ADDR_PTR]++] = Value;
+            break;
+        case REG_OPMODE:
+            SimSetOpMode( Chip, Value );
+            break;
+        case REG_IRQ_FLAGS:
+            // Write 1 to clear
+            Chip->Registers[REG_IRQ_FLAGS] &= ~Value;
+            SimUpdateDIO0( Chip );
+            break;
+        case REG_DIO_MAPPING_1:
+            Chip->Registers[Address] = Value;
+            SimUpdateDIO0( Chip );
+            break;
+        case REG_FIFO_RX_CURRENT_ADDR:
+        case REG_RX_NB_BYTES:
+        case REG_PACKET_SNR:
+        case REG_PACKET_RSSI:
+        case REG_CURRENT_RSSI:
+        case REG_FIFO_RX_BYTE_ADDR:
+        case REG_FREQ_ERROR:
+        case REG_FREQ_ERROR + 1:
+        case REG_FREQ_ERROR + 2:
+        case REG_VERSION:
+            // Read only
+            break;
+        default:
+            Chip->Registers[Address & 0x7F] = Value;
+            break;
+    }
+}
+
+static void *
+SimAirLoop( void *Param )
+{
+    struct TSimChip *Chip = Param;
+    struct timespec Now, Wake;
+
+    while ( 1 )
+    {
+        int Mode;
+
+        pthread_mutex_lock( &Chip->Lock );
+
+        clock_gettime( CLOCK_MONOTONIC, &Now );
+        Mode = Chip->Registers[REG_OPMODE] & 0x07;
+
+        if ( ( Mode == 5 ) && TimeReached( &Now, &Chip->NextPacketAt ) )
+        {
+            SimReceivePacket( Chip );
+            TimeAddSeconds( &Chip->NextPacketAt,
+                            SimPacketInterval >
+                            0 ? SimPacketInterval /
+                            1000.0 : SimAirtime( Chip, 255 ) );
+        }
+        else if ( ( Mode == 3 ) && TimeReached( &Now, &Chip->TxDoneAt ) )
+        {
+            // End of transmission; chip drops back to standby
+            Chip->Registers[REG_OPMODE] =
+                ( Chip->Registers[REG_OPMODE] & 0xF8 ) | 0x01;
+            Chip->Registers[REG_IRQ_FLAGS] |= IRQ_TX_DONE;
+            SimUpdateDIO0( Chip );
+        }
+
+        pthread_mutex_unlock( &Chip->Lock );
+
+        // 1ms resolution is plenty against LoRa airtimes
+        Wake = Now;
+        TimeAddSeconds( &Wake, 0.001 );
+        clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &Wake, NULL );
+    }
+
+    return NULL;
+}
+
+static void *
+SimISRLoop( void *Param )
+{
+    struct TSimChip *Chip = Param;
+
+    while ( 1 )
+    {
+        void ( *ISR ) ( void * );
+        void *Arg;
+
+        pthread_mutex_lock( &Chip->Lock );
+        while ( !Chip->ISRPending )
+        {
+            pthread_cond_wait( &Chip->ISRCond, &Chip->Lock );
+        }
+        Chip->ISRPending = 0;
+        ISR = Chip->ISR;
+        Arg = Chip->ISRArg;
+        pthread_mutex_unlock( &Chip->Lock );
+
+        if ( ISR )
+        {
+            ISR( Arg );
+        }
+    }
+
+    return NULL;
+}
+
+int
+HalSetup( void )
+{
+    FILE *fp;
+
+    if ( ( fp = fopen( "gateway.txt", "r" ) ) != NULL )
+    {
+        SimPacketInterval = ReadInteger( fp, "SimPacketInterval", 0, 0 );
+        SimCRCErrors = ReadInteger( fp, "SimCRCErrors", 0, 0 );
+        SimBinary = ReadInteger( fp, "SimBinary", 0, 0 );
+        fclose( fp );
+    }
+
+    LogMessage( "Using simulated SX127x radios\n" );
+
+    return 0;
+}
+
+int
+HalSPISetup( int Channel, int Bus, int ChipSelect, int Speed )
+{
+    struct TSimChip *Chip;
+
+    if ( ( Channel < 0 ) || ( Channel >= MAX_LORA_DEVICES ) )
+    {
+        return -1;
+    }
+
+    Chip = &Chips[Channel];
+    if ( Chip->InUse )
+    {
+        return 0;
+    }
+
+    memset( Chip, 0, sizeof( *Chip ) );
+    Chip->Channel = Channel;
+    Chip->Seed = 1234 + Channel;
+    pthread_mutex_init( &Chip->Lock, NULL );
+    pthread_cond_init( &Chip->ISRCond, NULL );
+
+    // Power-on register values
+    Chip->Registers[REG_OPMODE] = 0x09;
+    Chip->Registers[REG_FIFO_TX_BASE_AD] = 0x80;
+    Chip->Registers[REG_MODEM_CONFIG] = 0x72;
+    Chip->Registers[REG_MODEM_CONFIG2] = 0x70;
+    Chip->Registers[REG_PAYLOAD_LENGTH] = 0x01;
+    Chip->Registers[REG_DETECT_OPT] = 0xC3;
+    Chip->Registers[REG_DETECTION_THRESHOLD] = 0x0A;
+    Chip->Registers[REG_VERSION] = 0x12;
+
+    Chip->TelemetryFile = fopen( "telem.txt", "r" );
+    Chip->SSDVFile = fopen( "ssdv.bin", "rb" );
+
+    Chip->InUse = 1;
+
+    pthread_create( &Chip->ISRThread, NULL, SimISRLoop, Chip );
+    pthread_create( &Chip->AirThread, NULL, SimAirLoop, Chip );
+
+    LogMessage( "Channel %d: simulated SX127x on spidev%d.%d at %d Hz\n",
+                Channel, Bus, ChipSelect, Speed );
+
+    return 0;
+}
+
+int
+HalSPIDataRW( int Channel, unsigned char *data, int len )
+{
+    struct TSimChip *Chip;
+    uint8_t Address;
+    int i, Write;
+
+    if ( ( Channel < 0 ) || ( Channel >= MAX_LORA_DEVICES )
+         || !Chips[Channel].InUse || ( len < 1 ) )
+    {
+        return -1;
+    }
+
+    Chip = &Chips[Channel];
+    Write = data[0] & 0x80;
+    Address = data[0] & 0x7F;
+
+    pthread_mutex_lock( &Chip->Lock );
+
+    data[0] = 0;
+    for ( i = 1; i < len; i++ )
+    {
+        if ( Write )
+        {
+            SimWriteRegister( Chip, Address, data[i] );
+        }
+        else
+        {
+            data[i] = SimReadRegister( Chip, Address );
+        }
+
+        // Burst access auto-increments, except on the FIFO
+        if ( Address != REG_FIFO )
+        {
+            Address = ( Address + 1 ) & 0x7F;
+        }
+    }
+
+    pthread_mutex_unlock( &Chip->Lock );
+
+    return len;
+}
+
+void
+HalPinMode( int Pin, int Mode )
+{
+}
+
+int
+HalDigitalRead( int Pin )
+{
+    struct TSimChip *Chip;
+    struct timespec Now;
+    int IsDIO0, Level;
+
+    if ( ( Chip = ChipForPin( Pin, &IsDIO0 ) ) == NULL )
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock( &Chip->Lock );
+    if ( IsDIO0 )
+    {
+        Level = Chip->DIO0;
+    }
+    else
+    {
+        clock_gettime( CLOCK_MONOTONIC, &Now );
+        Level = ( ( Chip->Registers[REG_OPMODE] & 0x07 ) != 0 )
+            && TimeReached( &Now, &Chip->ModeReadyAt );
+    }
+    pthread_mutex_unlock( &Chip->Lock );
+
+    return Level;
+}
+
+void
+HalDigitalWrite( int Pin, int Value )
+{
+}
+
+int
+HalISR( int Pin, void ( *Function ) ( void * ), void *Arg )
+{
+    struct TSimChip *Chip;
+    int IsDIO0;
+
+    if ( ( ( Chip = ChipForPin( Pin, &IsDIO0 ) ) == NULL ) || !IsDIO0 )
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock( &Chip->Lock );
+    Chip->ISR = Function;
+    Chip->ISRArg = Arg;
+    pthread_mutex_unlock( &Chip->Lock );
+
+    return 0;
+}
+
+void
+HalDelay( unsigned int ms )
+{
+    usleep( ms * 1000 );
+}
+
+int
+HalSimulated( void )
+{
+    return 1;
+}
@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <stdint.h>
+
+#include "json.h"
+
+static const double Pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9
+};
+
+static void
+Put( json_writer_t * Writer, const char *Data, size_t Length )
+{
+    if ( Writer->Overflow || ( Writer->Length + Length >= Writer->Size ) )
+    {
+        Writer->Overflow = 1;
+        return;
+    }
+
+    memcpy( Writer->Buffer + Writer->Length, Data, Length );
+    Writer->Length += Length;
+}
+
+static void
+PutChar( json_writer_t * Writer, char c )
+{
+    Put( Writer, &c, 1 );
+}
+
+#define ONES    0x0101010101010101ULL
+#define HIGHS   0x8080808080808080ULL
+
+static inline int
+NeedsEscape( const char *Data )
+{
+    uint64_t x, Quote, Backslash;
+
+    memcpy( &x, Data, 8 );
+    Quote = x ^ ( ONES * '"' );
+    Backslash = x ^ ( ONES * '\\' );
+
+    return ( ( ( ( x - ONES * 0x20 ) & ~x ) |
+               ( ( Quote - ONES ) & ~Quote ) |
+               ( ( Backslash - ONES ) & ~Backslash ) ) & HIGHS ) != 0;
+}
+
+// String contents, escaped.  Runs of characters that need nothing doing
+// are copied in one go.
+static void
+PutEscaped( json_writer_t * Writer, const char *Value, size_t Length )
+{
+    static const char Hex[] = "0123456789abcdef";
+    const char *End = Value + Length;
+
+    while ( Value < End )
+    {
+        const char *Run = Value;
+        char Escape[6];
+
+        // 8 bytes at a time while there's no control character, '"' or
+        // '\\' among them (the usual has-zero-byte trick)
+        while ( ( End - Value >= 8 ) && !NeedsEscape( Value ) )
+        {
+            Value += 8;
+        }
+
+        while ( ( Value < End ) && ( ( unsigned char ) *Value >= 0x20 )
+                && ( *Value != '"' ) && ( *Value != '\\' ) )
+        {
+            Value++;
+        }
+        Put( Writer, Run, Value - Run );
+
+        if ( Value >= End )
+            break;
+
+        Escape[0] = '\\';
+        switch ( *Value )
+        {
+            case '"':
+            case '\\':
+                Escape[1] = *Value;
+                Put( Writer, Escape, 2 );
+                break;
+            case '\n':
+                Put( Writer, "\\n", 2 );
+                break;
+            case '\r':
+                Put( Writer, "\\r", 2 );
+                break;
+            case '\t':
+                Put( Writer, "\\t", 2 );
+                break;
+            default:
+                memcpy( Escape + 1, "u00", 3 );
+                Escape[4] = Hex[( unsigned char ) *Value >> 4];
+                Escape[5] = Hex[*Value & 0x0F];
+                Put( Writer, Escape, 6 );
+                break;
+        }
+        Value++;
+    }
+}
+
+// Comma if needed, then "Key": if there is one
+static void
+PutKey( json_writer_t * Writer, const char *Key )
+{
+    unsigned int Bit = 1u << Writer->Depth;
+
+    if ( Writer->NotFirst & Bit )
+    {
+        PutChar( Writer, ',' );
+    }
+    Writer->NotFirst |= Bit;
+
+    if ( Key )
+    {
+        PutChar( Writer, '"' );
+        PutEscaped( Writer, Key, strlen( Key ) );
+        Put( Writer, "\":", 2 );
+    }
+}
+
+static void
+Open( json_writer_t * Writer, const char *Key, char Bracket )
+{
+    PutKey( Writer, Key );
+    PutChar( Writer, Bracket );
+
+    if ( Writer->Depth >= JSON_MAX_DEPTH - 1 )
+    {
+        Writer->Overflow = 1;
+        return;
+    }
+    Writer->Depth++;
+    Writer->NotFirst &= ~( 1u << Writer->Depth );
+}
+
+static void
+Close( json_writer_t * Writer, char Bracket )
+{
+    if ( Writer->Depth > 0 )
+    {
+        Writer->Depth--;
+    }
+    PutChar( Writer, Bracket );
+}
+
+void
+JSONBegin( json_writer_t * Writer, char *Buffer, size_t Size )
+{
+    Writer->Buffer = Buffer;
+    Writer->Size = Size;
+    Writer->Length = 0;
+    Writer->Overflow = ( Size == 0 );
+    Writer->Depth = 0;
+    Writer->NotFirst = 0;
+}
+
+// Terminates the buffer.  Returns the length, or -1 if it didn't all fit
+// (in which case the buffer holds an empty string).
+int
+JSONEnd( json_writer_t * Writer )
+{
+    if ( Writer->Overflow )
+    {
+        if ( Writer->Size )
+        {
+            Writer->Buffer[0] = '\0';
+        }
+        return -1;
+    }
+
+    Writer->Buffer[Writer->Length] = '\0';
+
+    return Writer->Length;
+}
+
+void
+JSONBeginObject( json_writer_t * Writer, const char *Key )
+{
+    Open( Writer, Key, '{' );
+}
+
+void
+JSONEndObject( json_writer_t * Writer )
+{
+    Close( Writer, '}' );
+}
+
+void
+JSONBeginArray( json_writer_t * Writer, const char *Key )
+{
+    Open( Writer, Key, '[' );
+}
+
+void
+JSONEndArray( json_writer_t * Writer )
+{
+    Close( Writer, ']' );
+}
+
+void
+JSONStringN( json_writer_t * Writer, const char *Key, const char *Value,
+             size_t Length )
+{
+    PutKey( Writer, Key );
+    PutChar( Writer, '"' );
+    PutEscaped( Writer, Value, Length );
+    PutChar( Writer, '"' );
+}
+
+void
+JSONString( json_writer_t * Writer, const char *Key, const char *Value )
+{
+    JSONStringN( Writer, Key, Value, strlen( Value ) );
+}
+
+// Digits of Value, at least MinDigits of them, written backwards from End.
+// Returns where they start.
+static char *
+FormatDigits( char *End, unsigned long long Value, int MinDigits )
+{
+    do
+    {
+        *--End = '0' + Value % 10;
+        Value /= 10;
+        MinDigits--;
+    }
+    while ( Value || ( MinDigits > 0 ) );
+
+    return End;
+}
+
+void
+JSONInteger( json_writer_t * Writer, const char *Key, long Value )
+{
+    char Text[24], *p;
+    unsigned long long Magnitude;
+
+    Magnitude = Value < 0 ? -( unsigned long long ) Value : Value;
+    p = FormatDigits( Text + sizeof( Text ), Magnitude, 1 );
+    if ( Value < 0 )
+    {
+        *--p = '-';
+    }
+
+    PutKey( Writer, Key );
+    Put( Writer, p, Text + sizeof( Text ) - p );
+}
+
+// Value to Places (at most 9) decimal places, exactly as printf's "%.*f"
+// would write it.  The value is scaled and rounded to an integer so the
+// digits come out in one pass.  The scaling can be out by half a unit in
+// the last place, so anything within that of a halfway point (where
+// printf rounds the exact binary value, ties to even) goes to printf, as
+// does anything too big.  JSON has no NaN or infinity, so those are
+// written as null.
+void
+JSONFixed( json_writer_t * Writer, const char *Key, double Value, int Places )
+{
+    char Text[400], *p;
+    unsigned long long Units;
+    double Scaled, Fraction;
+    int Length;
+
+    Places = Places < 0 ? 0 : Places > 9 ? 9 : Places;
+
+    PutKey( Writer, Key );
+
+    if ( !isfinite( Value ) )
+    {
+        Put( Writer, "null", 4 );
+        return;
+    }
+
+    Scaled = fabs( Value ) * Pow10[Places];
+    Fraction = Scaled - floor( Scaled );
+
+    if ( ( Scaled >= 1e15 )
+         || ( fabs( Fraction - 0.5 ) <= Scaled * DBL_EPSILON ) )
+    {
+        Length = snprintf( Text, sizeof( Text ), "%.*f", Places, Value );
+        Put( Writer, Text, Length < ( int ) sizeof( Text ) ? Length :
+             ( int ) sizeof( Text ) - 1 );
+        return;
+    }
+
+    Units = ( unsigned long long ) Scaled + ( Fraction > 0.5 );
+
+    p = Text + sizeof( Text );
+    if ( Places )
+    {
+        p = FormatDigits( p, Units % ( unsigned long long ) Pow10[Places],
+                          Places );
+        *--p = '.';
+    }
+    p = FormatDigits( p, Units / ( unsigned long long ) Pow10[Places], 1 );
+
+    // printf keeps the sign of anything that rounds to zero, -0.0 included
+    if ( signbit( Value ) )
+    {
+        *--p = '-';
+    }
+
+    Put( Writer, p, Text + sizeof( Text ) - p );
+}
+
+// Text as is, with no comma - e.g. a line ending after the top-level value
+void
+JSONRaw( json_writer_t * Writer, const char *Text )
+{
+    Put( Writer, Text, strlen( Text ) );
+}
@@ -0,0 +1,39 @@
+#ifndef _H_JSON
+#define _H_JSON
+
+#include <stddef.h>
+
+// Streaming JSON writer.  Appends to a caller-owned buffer of known size,
+// adding the commas and escaping strings, and never writes past the end:
+// once something doesn't fit the writer stops and JSONEnd() reports it.
+// Key is the member name inside an object, or NULL inside an array or at
+// the top level.
+
+#define JSON_MAX_DEPTH  32
+
+typedef struct {
+    char *Buffer;
+    size_t Size;
+    size_t Length;
+    int Overflow;
+    int Depth;
+    unsigned int NotFirst;      // Bit per level: already has a member
+} json_writer_t;
+
+void JSONBegin( json_writer_t * Writer, char *Buffer, size_t Size );
+int JSONEnd( json_writer_t * Writer );
+
+void JSONBeginObject( json_writer_t * Writer, const char *Key );
+void JSONEndObject( json_writer_t * Writer );
+void JSONBeginArray( json_writer_t * Writer, const char *Key );
+void JSONEndArray( json_writer_t * Writer );
+
+void JSONString( json_writer_t * Writer, const char *Key, const char *Value );
+void JSONStringN( json_writer_t * Writer, const char *Key, const char *Value,
+                  size_t Length );
+void JSONInteger( json_writer_t * Writer, const char *Key, long Value );
+void JSONFixed( json_writer_t * Writer, const char *Key, double Value,
+                int Places );
+void JSONRaw( json_writer_t * Writer, const char *Text );
+
+#endif
@@ -18,9 +18,9 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
-#include <wiringPi.h>           // Include WiringPi library!
 #include "network.h"
 #include "global.h"
+#include "hal.h"
 
 int
 HaveAnIPAddress( void )
@@ -95,23 +95,23 @@ NetworkLoop( void *some_void_ptr )
     {
         if ( HaveAnIPAddress(  ) )
         {
-            digitalWrite( Config.NetworkLED, 1 );
+            HalDigitalWrite( Config.NetworkLED, 1 );
 //          LogMessage("On network :-)\n");
 
             if ( CanSeeTheInternet(  ) )
             {
-                digitalWrite( Config.InternetLED, 1 );
+                HalDigitalWrite( Config.InternetLED, 1 );
 //              LogMessage("On the internet :-)\n");
             }
             else
             {
-                digitalWrite( Config.InternetLED, 0 );
+                HalDigitalWrite( Config.InternetLED, 0 );
 //              LogMessage("Not on internet :-(\n");
             }
         }
         else
         {
-            digitalWrite( Config.NetworkLED, 0 );
+            HalDigitalWrite( Config.NetworkLED, 0 );
 //          LogMessage("No network :-(\n");
         }
 
@@ -0,0 +1,114 @@
+#include <string.h>
+#include <errno.h>
+
+#include "radio.h"
+
+void
+RadioInit( radio_t * Radio )
+{
+    memset( Radio, 0, sizeof( *Radio ) );
+    Radio->State = RADIO_UNKNOWN;
+    sem_init( &Radio->Wakeup, 0, 0 );
+    pthread_mutex_init( &Radio->CommandLock, NULL );
+}
+
+// Called from the DIO0 interrupt; all the work is done by the radio thread
+void
+RadioInterrupt( radio_t * Radio )
+{
+    // Timestamp first, before anything else gets a chance to run
+    clock_gettime( CLOCK_MONOTONIC, &Radio->DIO0Mono );
+    clock_gettime( CLOCK_REALTIME, &Radio->DIO0Time );
+
+    __atomic_store_n( &Radio->DIO0Pending, 1, __ATOMIC_RELEASE );
+    sem_post( &Radio->Wakeup );
+}
+
+// Radio thread: sleep until woken by an interrupt or command, or until the
+// (absolute, CLOCK_REALTIME) deadline.  Returns non-zero if DIO0 has fired.
+int
+RadioWait( radio_t * Radio, const struct timespec *Deadline )
+{
+    while ( ( sem_timedwait( &Radio->Wakeup, Deadline ) == -1 )
+            && ( errno == EINTR ) )
+    {
+    }
+
+    return __atomic_exchange_n( &Radio->DIO0Pending, 0, __ATOMIC_ACQUIRE );
+}
+
+// Any thread: queue a command for the radio thread.  Returns 0 if the
+// mailbox is full.
+int
+RadioPost( radio_t * Radio, const radio_command_t * Command )
+{
+    int Posted;
+
+    pthread_mutex_lock( &Radio->CommandLock );
+
+    Posted = ( Radio->CommandHead - Radio->CommandTail ) < RADIO_COMMAND_QUEUE;
+    if ( Posted )
+    {
+        Radio->Commands[Radio->CommandHead++ & ( RADIO_COMMAND_QUEUE - 1 )] =
+            *Command;
+    }
+
+    pthread_mutex_unlock( &Radio->CommandLock );
+
+    if ( Posted )
+    {
+        sem_post( &Radio->Wakeup );
+    }
+
+    return Posted;
+}
+
+// Radio thread: take the next command, if any
+int
+RadioNextCommand( radio_t * Radio, radio_command_t * Command )
+{
+    int Found;
+
+    pthread_mutex_lock( &Radio->CommandLock );
+
+    Found = Radio->CommandHead != Radio->CommandTail;
+    if ( Found )
+    {
+        *Command =
+            Radio->Commands[Radio->CommandTail++ & ( RADIO_COMMAND_QUEUE - 1 )];
+    }
+
+    pthread_mutex_unlock( &Radio->CommandLock );
+
+    return Found;
+}
+
+// Radio thread: record how long the chip took to reach a mode
+void
+RadioModeReady( radio_t * Radio, radio_state_t State, long Latency )
+{
+    if ( ( State >= 0 ) && ( State < RADIO_STATES ) )
+    {
+        Radio->ModeReadyUS[State] = Latency;
+    }
+}
+
+const char *
+RadioStateName( radio_state_t State )
+{
+    switch ( State )
+    {
+        case RADIO_SLEEP:
+            return "Sleep";
+        case RADIO_STANDBY:
+            return "Standby";
+        case RADIO_RX:
+            return "RX";
+        case RADIO_TX:
+            return "TX";
+        case RADIO_CAD:
+            return "CAD";
+        default:
+            return "Unknown";
+    }
+}
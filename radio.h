@@ -0,0 +1,74 @@
+#ifndef _H_Radio
+#define _H_Radio
+
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+// Per-channel radio state.  Each LoRa module is owned by its own radio
+// thread (RadioLoop in gateway.c), which is the only thread that talks to
+// the chip.  The DIO0 interrupt just wakes that thread, and other threads
+// ask it to transmit, retune etc. by posting commands to its mailbox.
+
+typedef enum {
+    RADIO_UNKNOWN,              // Not yet set, so the next change always writes
+    RADIO_SLEEP,
+    RADIO_STANDBY,
+    RADIO_RX,
+    RADIO_TX,
+    RADIO_CAD
+} radio_state_t;
+
+#define RADIO_STATES    ( RADIO_CAD + 1 )
+
+typedef enum {
+    RADIO_CMD_SEND,             // Transmit Data[0..Length-1]
+    RADIO_CMD_RETUNE,           // Shift frequency by Frequency MHz
+    RADIO_CMD_SET_MODEM,        // Switch to Frequency and modem settings
+    RADIO_CMD_DEFAULT           // Back to the configured frequency and mode
+} radio_command_type_t;
+
+typedef struct {
+    radio_command_type_t Type;
+    double Frequency;
+    int ImplicitOrExplicit;
+    int ErrorCoding;
+    int Bandwidth;
+    int SpreadingFactor;
+    int LowDataRateOptimize;
+    int Length;
+    char Data[256];
+    struct timespec SendAt;     // RADIO_CMD_SEND: CLOCK_REALTIME slot, or 0 for now
+} radio_command_t;
+
+#define RADIO_COMMAND_QUEUE 8   // Must be a power of 2
+
+typedef struct {
+    radio_state_t State;        // Radio thread only
+    int ResetPending;           // Radio thread only
+    int DIO0Pending;
+    struct timespec DIO0Mono, DIO0Time;     // Set by the interrupt handler
+    int CurrentRSSI;
+
+    // Time from mode change to ModeReady, by state, for the last change
+    unsigned int ModeReadyUS[RADIO_STATES];
+    unsigned int ModeTimeouts, Resets;
+
+    // How far after its slot the last scheduled uplink started
+    long UplinkLateUS;
+
+    sem_t Wakeup;
+    pthread_mutex_t CommandLock;
+    radio_command_t Commands[RADIO_COMMAND_QUEUE];
+    unsigned int CommandHead, CommandTail;
+} radio_t;
+
+void RadioInit( radio_t * Radio );
+void RadioInterrupt( radio_t * Radio );
+int RadioWait( radio_t * Radio, const struct timespec *Deadline );
+int RadioPost( radio_t * Radio, const radio_command_t * Command );
+int RadioNextCommand( radio_t * Radio, radio_command_t * Command );
+void RadioModeReady( radio_t * Radio, radio_state_t State, long Latency );
+const char *RadioStateName( radio_state_t State );
+
+#endif
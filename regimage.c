@@ -0,0 +1,170 @@
+#include <string.h>
+
+#include "regimage.h"
+#include "sx127x.h"
+#include "hal.h"
+
+// Longest run of unchanged (but known) registers that is cheaper to rewrite
+// inside a burst than to start a new SPI transaction for
+#define MAX_BURST_GAP   2
+
+void
+RegImageClear( reg_image_t * Image )
+{
+    memset( Image, 0, sizeof( *Image ) );
+}
+
+void
+RegImageSet( reg_image_t * Image, uint8_t Reg, uint8_t Value, uint8_t Mask )
+{
+    Reg &= REG_IMAGE_SIZE - 1;
+
+    Image->Value[Reg] = ( Image->Value[Reg] & ~Mask ) | ( Value & Mask );
+    Image->Mask[Reg] |= Mask;
+}
+
+// Overlay one image onto another; From wins where both set a bit
+void
+RegImageMerge( reg_image_t * Image, const reg_image_t * From )
+{
+    int Reg;
+
+    for ( Reg = 0; Reg < REG_IMAGE_SIZE; Reg++ )
+    {
+        if ( From->Mask[Reg] )
+        {
+            RegImageSet( Image, Reg, From->Value[Reg], From->Mask[Reg] );
+        }
+    }
+}
+
+void
+RegShadowInit( reg_shadow_t * Shadow )
+{
+    memset( Shadow, 0, sizeof( *Shadow ) );
+}
+
+// Registers the chip changes by itself, or that have side effects when
+// written, are never treated as known
+static int
+IsVolatile( uint8_t Reg )
+{
+    switch ( Reg )
+    {
+        case REG_FIFO:
+        case REG_OPMODE:
+        case REG_FIFO_ADDR_PTR:
+        case REG_FIFO_RX_CURRENT_ADDR:
+        case REG_IRQ_FLAGS:
+        case REG_FIFO_RX_BYTE_ADDR:
+            return 1;
+    }
+
+    // Packet counts, SNR, RSSI, frequency error etc. are all read-only
+    return ( ( Reg >= REG_RX_NB_BYTES ) && ( Reg <= REG_HOP_CHANNEL ) )
+        || ( ( Reg >= REG_FREQ_ERROR ) && ( Reg <= REG_RSSI_WIDEBAND ) );
+}
+
+// Record a value written to the chip outside RegImageApply
+void
+RegShadowNote( reg_shadow_t * Shadow, uint8_t Reg, uint8_t Value )
+{
+    Reg &= REG_IMAGE_SIZE - 1;
+
+    Shadow->Value[Reg] = Value;
+    Shadow->Known[Reg] = !IsVolatile( Reg );
+}
+
+int
+RegShadowNeedsWrite( reg_shadow_t * Shadow, uint8_t Reg, uint8_t Value )
+{
+    Reg &= REG_IMAGE_SIZE - 1;
+
+    return !Shadow->Known[Reg] || ( Shadow->Value[Reg] != Value );
+}
+
+static void
+WriteRun( int Channel, reg_shadow_t * Shadow, const uint8_t * Values,
+          int First, int Last )
+{
+    unsigned char data[REG_IMAGE_SIZE + 1];
+    int Reg;
+
+    data[0] = First | 0x80;
+    for ( Reg = First; Reg <= Last; Reg++ )
+    {
+        data[Reg - First + 1] = Values[Reg];
+        RegShadowNote( Shadow, Reg, Values[Reg] );
+    }
+
+    HalSPIDataRW( Channel, data, Last - First + 2 );
+}
+
+// Bring the chip in line with Image, writing only what differs from the
+// shadow.  Partial-mask registers keep their other bits from the shadow, so
+// those must be known (e.g. read once at startup) to be applied.  Returns
+// the number of SPI transactions used.
+int
+RegImageApply( int Channel, reg_shadow_t * Shadow, const reg_image_t * Image )
+{
+    uint8_t Values[REG_IMAGE_SIZE];
+    int Reg, First, Last, Transactions;
+
+    First = -1;
+    Last = -1;
+    Transactions = 0;
+
+    for ( Reg = 1; Reg < REG_IMAGE_SIZE; Reg++ )
+    {
+        uint8_t Mask;
+
+        Mask = Image->Mask[Reg];
+        Values[Reg] = Shadow->Value[Reg];
+
+        if ( ( Mask == 0 ) || ( ( Mask != 0xFF ) && !Shadow->Known[Reg] ) )
+        {
+            continue;
+        }
+
+        Values[Reg] = ( Shadow->Value[Reg] & ~Mask ) | Image->Value[Reg];
+
+        if ( !RegShadowNeedsWrite( Shadow, Reg, Values[Reg] ) )
+        {
+            continue;
+        }
+
+        if ( First >= 0 )
+        {
+            int Gap, Bridge;
+
+            // Extend the current burst over a short gap of registers whose
+            // values we know, rather than starting a new transaction
+            Bridge = ( Reg - Last - 1 ) <= MAX_BURST_GAP;
+            for ( Gap = Last + 1; Bridge && ( Gap < Reg ); Gap++ )
+            {
+                Bridge = Shadow->Known[Gap];
+            }
+
+            if ( !Bridge )
+            {
+                WriteRun( Channel, Shadow, Values, First, Last );
+                Transactions++;
+                First = Reg;
+            }
+        }
+        else
+        {
+            First = Reg;
+        }
+
+        Last = Reg;
+    }
+
+    if ( First >= 0 )
+    {
+        WriteRun( Channel, Shadow, Values, First, Last );
+        Transactions++;
+    }
+
+    return Transactions;
+}
@@ -0,0 +1,42 @@
+#ifndef _H_RegImage
+#define _H_RegImage
+
+#include <stdint.h>
+
+// Register images and shadow registers for the SX127x.
+//
+// A register image is a sparse set of register values describing one
+// configuration (a LoRa mode, a channel's default settings); Mask says
+// which bits of each register the image sets, so 0 means "not part of
+// this image".  Images are built once and then applied to a channel.
+//
+// The shadow is our copy of what was last written to each chip.  Applying
+// an image writes only the registers whose value would change, with each
+// run of neighbouring registers sent as one burst.
+
+#define REG_IMAGE_SIZE  0x80
+
+typedef struct {
+    uint8_t Value[REG_IMAGE_SIZE];
+    uint8_t Mask[REG_IMAGE_SIZE];
+} reg_image_t;
+
+typedef struct {
+    uint8_t Value[REG_IMAGE_SIZE];
+    uint8_t Known[REG_IMAGE_SIZE];  // Value matches the chip
+} reg_shadow_t;
+
+void RegImageClear( reg_image_t * Image );
+void RegImageSet( reg_image_t * Image, uint8_t Reg, uint8_t Value,
+                  uint8_t Mask );
+void RegImageMerge( reg_image_t * Image, const reg_image_t * From );
+
+void RegShadowInit( reg_shadow_t * Shadow );
+void RegShadowNote( reg_shadow_t * Shadow, uint8_t Reg, uint8_t Value );
+int RegShadowNeedsWrite( reg_shadow_t * Shadow, uint8_t Reg,
+                         uint8_t Value );
+
+int RegImageApply( int Channel, reg_shadow_t * Shadow,
+                   const reg_image_t * Image );
+
+#endif
@@ -0,0 +1,86 @@
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <semaphore.h>
+
+#include "rxqueue.h"
+
+void
+RxQueueInit( rx_queue_t * Queue )
+{
+    memset( Queue, 0, sizeof( *Queue ) );
+    sem_init( &Queue->Available, 0, 0 );
+}
+
+// Producer: returns the next free slot to be filled in place, or NULL if
+// the ring is full (which is counted as an overflow)
+rx_packet_t *
+RxQueueReserve( rx_queue_t * Queue )
+{
+    unsigned int Head, Tail;
+
+    Head = Queue->Head;
+    Tail = __atomic_load_n( &Queue->Tail, __ATOMIC_ACQUIRE );
+
+    if ( ( Head - Tail ) >= RX_QUEUE_SIZE )
+    {
+        __atomic_add_fetch( &Queue->Overflows, 1, __ATOMIC_RELAXED );
+        return NULL;
+    }
+
+    return &Queue->Packets[Head & ( RX_QUEUE_SIZE - 1 )];
+}
+
+// Producer: publish the slot returned by RxQueueReserve
+void
+RxQueueCommit( rx_queue_t * Queue )
+{
+    __atomic_store_n( &Queue->Head, Queue->Head + 1, __ATOMIC_RELEASE );
+    sem_post( &Queue->Available );
+}
+
+// Consumer: returns the oldest packet, waiting up to TimeoutMS for one to
+// arrive, or NULL if there is none
+rx_packet_t *
+RxQueuePeek( rx_queue_t * Queue, int TimeoutMS )
+{
+    if ( RxQueueEmpty( Queue ) )
+    {
+        struct timespec Deadline;
+
+        clock_gettime( CLOCK_REALTIME, &Deadline );
+        Deadline.tv_nsec += ( long ) TimeoutMS * 1000000L;
+        Deadline.tv_sec += Deadline.tv_nsec / 1000000000L;
+        Deadline.tv_nsec %= 1000000000L;
+
+        while ( ( sem_timedwait( &Queue->Available, &Deadline ) == -1 )
+                && ( errno == EINTR ) )
+        {
+        }
+
+        if ( RxQueueEmpty( Queue ) )
+        {
+            return NULL;
+        }
+    }
+    else
+    {
+        // Keep the semaphore count in step with the ring
+        sem_trywait( &Queue->Available );
+    }
+
+    return &Queue->Packets[Queue->Tail & ( RX_QUEUE_SIZE - 1 )];
+}
+
+// Consumer: hand the slot returned by RxQueuePeek back to the producer
+void
+RxQueueRelease( rx_queue_t * Queue )
+{
+    __atomic_store_n( &Queue->Tail, Queue->Tail + 1, __ATOMIC_RELEASE );
+}
+
+int
+RxQueueEmpty( rx_queue_t * Queue )
+{
+    return __atomic_load_n( &Queue->Head, __ATOMIC_ACQUIRE ) == Queue->Tail;
+}
@@ -0,0 +1,50 @@
+#ifndef _H_RxQueue
+#define _H_RxQueue
+
+#include <stdint.h>
+#include <time.h>
+#include <semaphore.h>
+
+// Single-producer / single-consumer ring of received packets and radio
+// events.  A channel's radio thread is the only producer and that channel's
+// packet worker thread is the only consumer, so no locks are needed; the
+// semaphore only wakes the worker.  When the ring is full the packet is
+// dropped and counted rather than making the radio thread wait.
+
+#define RX_QUEUE_SIZE   64      // Must be a power of 2
+
+#define PACKET_OK           0
+#define PACKET_CRC_ERROR    1
+#define PACKET_TX_DONE      2
+#define PACKET_RETUNED      3       // Frequency changed, by Retune kHz if known
+#define PACKET_RADIO_RESET  4       // Chip stopped responding and was reset
+
+typedef struct {
+    int Status;
+    int Bytes;
+    uint8_t IRQFlags;
+    int8_t SNR;
+    int RSSI;
+    double FreqError;
+    double Retune;              // AFC frequency shift applied, kHz
+    struct timespec RxMono;     // When DIO0 fired, CLOCK_MONOTONIC
+    struct timespec RxTime;     // and CLOCK_REALTIME
+    char Message[257];          // Message[0] is reserved, data starts at Message[1]
+} rx_packet_t;
+
+typedef struct {
+    rx_packet_t Packets[RX_QUEUE_SIZE];
+    unsigned int Head;          // Next slot to fill; written by producer only
+    unsigned int Tail;          // Next slot to read; written by consumer only
+    unsigned int Overflows;
+    sem_t Available;
+} rx_queue_t;
+
+void RxQueueInit( rx_queue_t * Queue );
+rx_packet_t *RxQueueReserve( rx_queue_t * Queue );
+void RxQueueCommit( rx_queue_t * Queue );
+rx_packet_t *RxQueuePeek( rx_queue_t * Queue, int TimeoutMS );
+void RxQueueRelease( rx_queue_t * Queue );
+int RxQueueEmpty( rx_queue_t * Queue );
+
+#endif
@@ -19,6 +19,8 @@
 
 #include "server.h"
 #include "global.h"
+#include "flights.h"
+#include "json.h"
 
 extern bool run;
 extern bool server_closed;
@@ -67,51 +69,55 @@ void *ServerLoop( void *some_void_ptr )
 
         for ( port_closed = 0; !port_closed; )
         {
-            int Channel;
             // Build json
             // sprintf(sendBuff, "{\"class\":\"POSN\",\"time\":\"12:34:56\",\"lat\":54.12345,\"lon\":-2.12345,\"alt\":169}\r\n");
 
-			for (Channel=0; Channel<=1; Channel++)
+			flight_t Flight;
+			json_writer_t Writer;
+			int Index;
+
+			// One line per payload we've heard, each marked with the channel
+			// it was last heard on, all together once a second
+			for (Index=0; !port_closed && FlightNext(&Index, &Flight); )
 			{
+				JSONBegin(&Writer, sendBuff, sizeof(sendBuff));
+				JSONBeginObject(&Writer, NULL);
+				JSONString(&Writer, "class", "POSN");
+				JSONInteger(&Writer, "index", Flight.Channel);
+				JSONString(&Writer, "payload", Flight.Telemetry.Payload);
+				JSONString(&Writer, "time", Flight.Telemetry.Time);
+				JSONFixed(&Writer, "lat", Flight.Telemetry.Latitude, 5);
+				JSONFixed(&Writer, "lon", Flight.Telemetry.Longitude, 5);
+				JSONInteger(&Writer, "alt", Flight.Telemetry.Altitude);
+				JSONFixed(&Writer, "rate", Flight.AscentRate, 1);
+
 				if ( Config.EnableDev )
 				{
-					sprintf(sendBuff, "{\"class\":\"POSN\",\"index\":%d,\"payload\":\"%s\",\"time\":\"%s\",\"lat\":%.5lf,\"lon\":%.5lf,\"alt\":%d,\"rate\":%.1lf,\"predlat\":%.5lf,\"predlon\":%.5lf,\"speed\":%d,"
-									  "\"head\":%d,\"cda\":%.2lf,\"pls\":%.1lf,\"pt\":%d,\"ca\":%d,\"ct\":%d,\"as\":%.1lf,\"ad\":%d,\"sl\":%d,\"sr\":%d,\"st\":%d,\"gr\":%.2lf,\"fm\":%d}\r\n",
-								Channel,
-								Config.LoRaDevices[Channel].Payload,
-								Config.LoRaDevices[Channel].Time,
-								Config.LoRaDevices[Channel].Latitude,
-								Config.LoRaDevices[Channel].Longitude,
-								Config.LoRaDevices[Channel].Altitude,
-								Config.LoRaDevices[Channel].AscentRate,
-								Config.LoRaDevices[Channel].PredictedLatitude,
-								Config.LoRaDevices[Channel].PredictedLongitude,
-								Config.LoRaDevices[Channel].Speed,
-								
-								Config.LoRaDevices[Channel].Heading,
-								Config.LoRaDevices[Channel].cda,
-								Config.LoRaDevices[Channel].PredictedLandingSpeed,
-								Config.LoRaDevices[Channel].PredictedTime,
-								Config.LoRaDevices[Channel].CompassActual,
-								Config.LoRaDevices[Channel].CompassTarget,
-								Config.LoRaDevices[Channel].AirSpeed,
-								Config.LoRaDevices[Channel].AirDirection,
-								Config.LoRaDevices[Channel].ServoLeft,
-								Config.LoRaDevices[Channel].ServoRight,
-								Config.LoRaDevices[Channel].ServoTime,
-								Config.LoRaDevices[Channel].GlideRatio,
-								Config.LoRaDevices[Channel].FlightMode);
+					JSONFixed(&Writer, "predlat", Flight.Telemetry.PredictedLatitude, 5);
+					JSONFixed(&Writer, "predlon", Flight.Telemetry.PredictedLongitude, 5);
+					JSONInteger(&Writer, "speed", Flight.Telemetry.Speed);
+					JSONInteger(&Writer, "head", Flight.Telemetry.Heading);
+					JSONFixed(&Writer, "cda", Flight.Telemetry.cda, 2);
+					JSONFixed(&Writer, "pls", Flight.Telemetry.PredictedLandingSpeed, 1);
+					JSONInteger(&Writer, "pt", Flight.Telemetry.PredictedTime);
+					JSONInteger(&Writer, "ca", Flight.Telemetry.CompassActual);
+					JSONInteger(&Writer, "ct", Flight.Telemetry.CompassTarget);
+					JSONFixed(&Writer, "as", Flight.Telemetry.AirSpeed, 1);
+					JSONInteger(&Writer, "ad", Flight.Telemetry.AirDirection);
+					JSONInteger(&Writer, "sl", Flight.Telemetry.ServoLeft);
+					JSONInteger(&Writer, "sr", Flight.Telemetry.ServoRight);
+					JSONInteger(&Writer, "st", Flight.Telemetry.ServoTime);
+					JSONFixed(&Writer, "gr", Flight.Telemetry.GlideRatio, 2);
+					JSONInteger(&Writer, "fm", Flight.Telemetry.FlightMode);
 				}
-				else
+
+				JSONEndObject(&Writer);
+				JSONRaw(&Writer, "\r\n");
+				if ( JSONEnd(&Writer) < 0 )
 				{
-					sprintf(sendBuff, "{\"class\":\"POSN\",\"index\":%d,\"payload\":\"%s\",\"time\":\"%s\",\"lat\":%.5lf,\"lon\":%.5lf,\"alt\":%d,\"rate\":%.1lf}\r\n",
-								Channel,
-								Config.LoRaDevices[Channel].Payload,
-								Config.LoRaDevices[Channel].Time,
-								Config.LoRaDevices[Channel].Latitude,
-								Config.LoRaDevices[Channel].Longitude,
-								Config.LoRaDevices[Channel].Altitude,
-								Config.LoRaDevices[Channel].AscentRate);
+					// Buffer is empty now; sending that would look like a disconnect
+					LogMessage( "JSON for %s too long, not sent\n", Flight.Telemetry.Payload );
+					continue;
 				}
 
 				if ( !run )
@@ -123,10 +129,15 @@ void *ServerLoop( void *some_void_ptr )
 					LogMessage( "Disconnected from client\n" );
 					port_closed = 1;
 				}
-				else
-				{
-					sleep(1);
-				}
+			}
+
+			if ( !run )
+			{
+				port_closed = 1;
+			}
+			else if ( !port_closed )
+			{
+				sleep(1);
 			}
         }
 
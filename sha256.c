@@ -3,8 +3,24 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
+#include <pthread.h>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <immintrin.h>
+#define SHA256_X86
+#endif
+
+// Opt-in with "make ARMV8_SHA=1" until it's been built and run on a Pi
+#if defined( __aarch64__ ) && defined( SHA256_ARMV8 )
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#else
+#undef SHA256_ARMV8
+#endif
 
 #include "sha256.h"
+#include "gateway.h"
 
 
 // DBL_INT_ADD treats two unsigned ints a and b as one 64-bit integer and adds c to it
@@ -20,7 +36,7 @@
 #define SIG1(x) (ROTRIGHT(x,17) ^ ROTRIGHT(x,19) ^ ((x) >> 10))
 
 
-uint32_t k[64] = {
+static const uint32_t K[64] = {
     0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
     0x923f82a4, 0xab1c5ed5,
     0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe,
@@ -40,49 +56,297 @@ uint32_t k[64] = {
 };
 
 
-void
-sha256_transform( SHA256_CTX * ctx, uint8_t data[] )
+// One round, with the working variables passed in rotated order rather
+// than shuffled along; only d and h change
+#define ROUND(a,b,c,d,e,f,g,h,i) \
+    t1 = h + EP1(e) + CH(e,f,g) + K[i] + m[i]; \
+    d += t1; \
+    h = t1 + EP0(a) + MAJ(a,b,c);
+
+#define EIGHT_ROUNDS(i) \
+    ROUND(a, b, c, d, e, f, g, h, (i)); \
+    ROUND(h, a, b, c, d, e, f, g, (i) + 1); \
+    ROUND(g, h, a, b, c, d, e, f, (i) + 2); \
+    ROUND(f, g, h, a, b, c, d, e, (i) + 3); \
+    ROUND(e, f, g, h, a, b, c, d, (i) + 4); \
+    ROUND(d, e, f, g, h, a, b, c, (i) + 5); \
+    ROUND(c, d, e, f, g, h, a, b, (i) + 6); \
+    ROUND(b, c, d, e, f, g, h, a, (i) + 7);
+
+// Compression functions, each taking any number of 64-byte blocks
+typedef void ( *sha256_blocks_t ) ( uint32_t state[], const uint8_t data[],
+                                    size_t blocks );
+
+static void
+TransformPortable( uint32_t state[], const uint8_t data[], size_t blocks )
+{
+    uint32_t a, b, c, d, e, f, g, h, i, t1, m[64];
+
+    for ( ; blocks > 0; blocks--, data += 64 )
+    {
+        for ( i = 0; i < 16; ++i )
+            m[i] =
+                ( data[i * 4] << 24 ) | ( data[i * 4 + 1] << 16 ) |
+                ( data[i * 4 + 2] << 8 ) | ( data[i * 4 + 3] );
+        for ( ; i < 64; ++i )
+            m[i] = SIG1( m[i - 2] ) + m[i - 7] + SIG0( m[i - 15] ) + m[i - 16];
+
+        a = state[0];
+        b = state[1];
+        c = state[2];
+        d = state[3];
+        e = state[4];
+        f = state[5];
+        g = state[6];
+        h = state[7];
+
+        for ( i = 0; i < 64; i += 8 )
+        {
+            EIGHT_ROUNDS( i );
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+#ifdef SHA256_X86
+// SHA-NI.  The instructions want the state as ABEF/CDGH and do two rounds
+// each; the schedule is 4 words at a time, kept in a window of 4 vectors.
+__attribute__ ( ( target( "sha,sse4.1" ) ) )
+static void
+TransformSHANI( uint32_t state[], const uint8_t data[], size_t blocks )
+{
+    const __m128i Swap = _mm_set_epi64x( 0x0c0d0e0f08090a0bULL,
+                                         0x0405060700010203ULL );
+    __m128i State0, State1, Saved0, Saved1, Message, Tmp, m[4];
+    int j;
+
+    Tmp = _mm_shuffle_epi32( _mm_loadu_si128( ( const __m128i * ) &state[0] ),
+                             0xB1 );
+    State1 = _mm_shuffle_epi32( _mm_loadu_si128
+                                ( ( const __m128i * ) &state[4] ), 0x1B );
+    State0 = _mm_alignr_epi8( Tmp, State1, 8 );
+    State1 = _mm_blend_epi16( State1, Tmp, 0xF0 );
+
+    for ( ; blocks > 0; blocks--, data += 64 )
+    {
+        Saved0 = State0;
+        Saved1 = State1;
+
+        for ( j = 0; j < 16; j++ )
+        {
+            if ( j < 4 )
+            {
+                m[j] = _mm_shuffle_epi8( _mm_loadu_si128
+                                         ( ( const __m128i * ) ( data +
+                                                                 j * 16 ) ),
+                                         Swap );
+            }
+            else
+            {
+                m[j & 3] =
+                    _mm_sha256msg2_epu32( _mm_add_epi32
+                                          ( _mm_sha256msg1_epu32
+                                            ( m[j & 3], m[( j + 1 ) & 3] ),
+                                            _mm_alignr_epi8( m[( j + 3 ) & 3],
+                                                             m[( j + 2 ) & 3],
+                                                             4 ) ),
+                                          m[( j + 3 ) & 3] );
+            }
+
+            Message = _mm_add_epi32( m[j & 3],
+                                     _mm_loadu_si128( ( const __m128i * )
+                                                      &K[j * 4] ) );
+            State1 = _mm_sha256rnds2_epu32( State1, State0, Message );
+            State0 = _mm_sha256rnds2_epu32( State0, State1,
+                                            _mm_shuffle_epi32( Message,
+                                                               0x0E ) );
+        }
+
+        State0 = _mm_add_epi32( State0, Saved0 );
+        State1 = _mm_add_epi32( State1, Saved1 );
+    }
+
+    Tmp = _mm_shuffle_epi32( State0, 0x1B );
+    State1 = _mm_shuffle_epi32( State1, 0xB1 );
+    _mm_storeu_si128( ( __m128i * ) &state[0],
+                      _mm_blend_epi16( Tmp, State1, 0xF0 ) );
+    _mm_storeu_si128( ( __m128i * ) &state[4],
+                      _mm_alignr_epi8( State1, Tmp, 8 ) );
+}
+#endif
+
+#ifdef SHA256_ARMV8
+// ARMv8 crypto extensions, 4 rounds per step with the same 4-vector
+// schedule window
+__attribute__ ( ( target( "+crypto" ) ) )
+static void
+TransformARMv8( uint32_t state[], const uint8_t data[], size_t blocks )
+{
+    uint32x4_t State0, State1, Saved0, Saved1, Message, Tmp, m[4];
+    int j;
+
+    State0 = vld1q_u32( &state[0] );
+    State1 = vld1q_u32( &state[4] );
+
+    for ( ; blocks > 0; blocks--, data += 64 )
+    {
+        Saved0 = State0;
+        Saved1 = State1;
+
+        for ( j = 0; j < 16; j++ )
+        {
+            if ( j < 4 )
+            {
+                m[j] = vreinterpretq_u32_u8( vrev32q_u8( vld1q_u8( data +
+                                                                   j * 16 ) ) );
+            }
+            else
+            {
+                m[j & 3] = vsha256su1q_u32( vsha256su0q_u32( m[j & 3],
+                                                             m[( j + 1 ) & 3] ),
+                                            m[( j + 2 ) & 3],
+                                            m[( j + 3 ) & 3] );
+            }
+
+            Message = vaddq_u32( m[j & 3], vld1q_u32( &K[j * 4] ) );
+            Tmp = State0;
+            State0 = vsha256hq_u32( State0, State1, Message );
+            State1 = vsha256h2q_u32( State1, Tmp, Message );
+        }
+
+        State0 = vaddq_u32( State0, Saved0 );
+        State1 = vaddq_u32( State1, Saved1 );
+    }
+
+    vst1q_u32( &state[0], State0 );
+    vst1q_u32( &state[4], State1 );
+}
+#endif
+
+static const struct {
+    const char *Name;
+    sha256_blocks_t Transform;
+} Transforms[] = {
+    {"portable", TransformPortable},
+#ifdef SHA256_X86
+    {"shani", TransformSHANI},
+#endif
+#ifdef SHA256_ARMV8
+    {"armv8", TransformARMv8},
+#endif
+};
+
+static sha256_blocks_t TransformBlocks = TransformPortable;
+static pthread_once_t TransformOnce = PTHREAD_ONCE_INIT;
+
+static int
+TransformSupported( sha256_blocks_t Transform )
+{
+#ifdef SHA256_X86
+    if ( Transform == TransformSHANI )
+        return __builtin_cpu_supports( "sha" )
+            && __builtin_cpu_supports( "sse4.1" );
+#endif
+#ifdef SHA256_ARMV8
+    if ( Transform == TransformARMv8 )
+        return ( getauxval( AT_HWCAP ) & HWCAP_SHA2 ) != 0;
+#endif
+
+    return 1;
+}
+
+// Use the CPU's SHA instructions if it has them, once they've given the
+// same answer as the portable code
+static void
+ChooseTransform( void )
 {
-    uint32_t a, b, c, d, e, f, g, h, i, j, t1, t2, m[64];
-
-    for ( i = 0, j = 0; i < 16; ++i, j += 4 )
-        m[i] =
-            ( data[j] << 24 ) | ( data[j + 1] << 16 ) | ( data[j + 2] << 8 ) |
-            ( data[j + 3] );
-    for ( ; i < 64; ++i )
-        m[i] = SIG1( m[i - 2] ) + m[i - 7] + SIG0( m[i - 15] ) + m[i - 16];
-
-    a = ctx->state[0];
-    b = ctx->state[1];
-    c = ctx->state[2];
-    d = ctx->state[3];
-    e = ctx->state[4];
-    f = ctx->state[5];
-    g = ctx->state[6];
-    h = ctx->state[7];
-
-    for ( i = 0; i < 64; ++i )
+    uint32_t Expected[8], Actual[8];
+    uint8_t Test[128];
+    sha256_blocks_t Transform;
+    const char *Name;
+    int i;
+
+    Transform = TransformPortable;
+    Name = NULL;
+
+#ifdef SHA256_X86
+    __builtin_cpu_init(  );
+    if ( TransformSupported( TransformSHANI ) )
+    {
+        Transform = TransformSHANI;
+        Name = "SHA-NI";
+    }
+#endif
+#ifdef SHA256_ARMV8
+    if ( TransformSupported( TransformARMv8 ) )
     {
-        t1 = h + EP1( e ) + CH( e, f, g ) + k[i] + m[i];
-        t2 = EP0( a ) + MAJ( a, b, c );
-        h = g;
-        g = f;
-        f = e;
-        e = d + t1;
-        d = c;
-        c = b;
-        b = a;
-        a = t1 + t2;
+        Transform = TransformARMv8;
+        Name = "ARMv8";
     }
+#endif
 
-    ctx->state[0] += a;
-    ctx->state[1] += b;
-    ctx->state[2] += c;
-    ctx->state[3] += d;
-    ctx->state[4] += e;
-    ctx->state[5] += f;
-    ctx->state[6] += g;
-    ctx->state[7] += h;
+    if ( Name )
+    {
+        for ( i = 0; i < sizeof( Test ); i++ )
+        {
+            Test[i] = i * 37 + ( i >> 3 );
+        }
+        for ( i = 0; i < 8; i++ )
+        {
+            Expected[i] = Actual[i] = K[i * 8];
+        }
+
+        TransformPortable( Expected, Test, 2 );
+        Transform( Actual, Test, 2 );
+
+        if ( memcmp( Expected, Actual, sizeof( Expected ) ) )
+        {
+            LogMessage( "SHA-256 %s code failed its self-check, not used\n",
+                        Name );
+            Transform = TransformPortable;
+        }
+    }
+
+    TransformBlocks = Transform;
+}
+
+// Use the named transform from now on instead of the one chosen for this
+// CPU, for the tests and benchmarks.  Returns 0, or -1 if there's no such
+// transform or the CPU can't run it.
+int
+sha256_select_transform( const char *Name )
+{
+    int i;
+
+    pthread_once( &TransformOnce, ChooseTransform );
+
+    for ( i = 0; i < sizeof( Transforms ) / sizeof( Transforms[0] ); i++ )
+    {
+        if ( !strcmp( Transforms[i].Name, Name )
+             && TransformSupported( Transforms[i].Transform ) )
+        {
+            TransformBlocks = Transforms[i].Transform;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+void
+sha256_transform( SHA256_CTX * ctx, uint8_t data[] )
+{
+    pthread_once( &TransformOnce, ChooseTransform );
+
+    TransformBlocks( ctx->state, data, 1 );
 }
 
 void
@@ -104,19 +368,44 @@ sha256_init( SHA256_CTX * ctx )
 void
 sha256_update( SHA256_CTX * ctx, char data[], uint32_t len )
 {
-    uint32_t i;
+    uint32_t i, blocks;
+
+    pthread_once( &TransformOnce, ChooseTransform );
 
-    for ( i = 0; i < len; ++i )
+    // Top up a part-filled block first
+    if ( ctx->datalen > 0 )
     {
-        ctx->data[ctx->datalen] = data[i];
-        ctx->datalen++;
-        if ( ctx->datalen == 64 )
+        i = 64 - ctx->datalen;
+        if ( i > len )
+            i = len;
+        memcpy( ctx->data + ctx->datalen, data, i );
+        ctx->datalen += i;
+        data += i;
+        len -= i;
+
+        if ( ctx->datalen < 64 )
+            return;
+
+        TransformBlocks( ctx->state, ctx->data, 1 );
+        DBL_INT_ADD( ctx->bitlen[0], ctx->bitlen[1], 512 );
+        ctx->datalen = 0;
+    }
+
+    // Then whole blocks straight from the caller's buffer
+    blocks = len / 64;
+    if ( blocks > 0 )
+    {
+        TransformBlocks( ctx->state, ( const uint8_t * ) data, blocks );
+        for ( i = 0; i < blocks; i++ )
         {
-            sha256_transform( ctx, ctx->data );
             DBL_INT_ADD( ctx->bitlen[0], ctx->bitlen[1], 512 );
-            ctx->datalen = 0;
         }
+        data += blocks * 64;
+        len -= blocks * 64;
     }
+
+    memcpy( ctx->data, data, len );
+    ctx->datalen = len;
 }
 
 void
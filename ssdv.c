@@ -14,13 +14,13 @@
 #include <math.h>
 #include <pthread.h>
 #include <curl/curl.h>
-#include <wiringPi.h>
 
 #include "urlencode.h"
 #include "base64.h"
 #include "ssdv.h"
 #include "gateway.h"
 #include "global.h"
+#include "json.h"
 
 extern int ssdv_pipe_fd[2];
 extern pthread_mutex_t var;
@@ -54,12 +54,11 @@ UploadImagePacket( ssdv_t * s, unsigned int packets )
     CURL *curl;
     CURLcode res;
     char curl_error[CURL_ERROR_SIZE];
-    char base64_data[512], json[32768], packet_json[1000];
+    char base64_data[512], json[32768];
+    json_writer_t Writer;
     struct curl_slist *headers = NULL;
     size_t base64_length;
-    char now[32];
-    time_t rawtime;
-    struct tm *tm;
+    char received[32];
     char url[250];
 
     /* get a curl handle */
@@ -80,29 +79,41 @@ UploadImagePacket( ssdv_t * s, unsigned int packets )
         // Avoid curl library bug that happens if above timeout occurs (sigh)
         curl_easy_setopt( curl, CURLOPT_NOSIGNAL, 1 );
 
-        // Get formatted timestamp
-        time( &rawtime );
-        tm = gmtime( &rawtime );
-        strftime( now, sizeof( now ), "%Y-%0m-%0dT%H:%M:%SZ", tm );
-
         int PacketIndex;
 
-        // Create json with the base64 data in hex, the tracker callsign and the current timestamp
-        strcpy( json, "{\"type\": \"packets\",\"packets\":[" );
+        // Create json with the base64 data, the tracker callsign and when
+        // each packet was received
+        JSONBegin( &Writer, json, sizeof( json ) );
+        JSONBeginObject( &Writer, NULL );
+        JSONString( &Writer, "type", "packets" );
+        JSONBeginArray( &Writer, "packets" );
 
         for ( PacketIndex = 0; PacketIndex < packets; PacketIndex++ )
         {
             base64_encode( s[PacketIndex].SSDV_Packet, 256, &base64_length,
                            base64_data );
-            base64_data[base64_length] = '\0';
 
-            sprintf( packet_json,
-                     "{\"type\": \"packet\", \"packet\": \"%s\", \"encoding\": \"base64\", \"received\": \"%s\", \"receiver\": \"%s\"}%s",
-                     base64_data, now, Config.Tracker,
-                     PacketIndex == ( packets - 1 ) ? "" : "," );
-            strcat( json, packet_json );
+            FormatTimestamp( received, &s[PacketIndex].RxTime );
+
+            JSONBeginObject( &Writer, NULL );
+            JSONString( &Writer, "type", "packet" );
+            JSONStringN( &Writer, "packet", base64_data, base64_length );
+            JSONString( &Writer, "encoding", "base64" );
+            JSONString( &Writer, "received", received );
+            JSONString( &Writer, "receiver", Config.Tracker );
+            JSONEndObject( &Writer );
+        }
+
+        JSONEndArray( &Writer );
+        JSONEndObject( &Writer );
+
+        if ( JSONEnd( &Writer ) < 0 )
+        {
+            LogMessage( "SSDV upload of %u packets too big, not sent\n",
+                        packets );
+            curl_easy_cleanup( curl );
+            return;
         }
-        strcat( json, "]}" );
 
         // LogTelemetryPacket(json);
 
@@ -0,0 +1,712 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "ssdvdec.h"
+
+#define SSDV_PACKET_SIZE    256
+#define SSDV_HEADER_SIZE    15
+#define LOOKUP_BITS         9
+
+#define FEED_ME             0
+#define DECODED             1
+
+// JPEG Annex K tables, which SSDV uses for both the packets and the JPEG.
+// Quantisation tables are in zigzag order.
+static const uint8_t StdDQT[2][64] = {
+    {16, 11, 12, 14, 12, 10, 16, 14, 13, 14, 18, 17, 16, 19, 24, 40,
+     26, 24, 22, 22, 24, 49, 35, 37, 29, 40, 58, 51, 61, 60, 57, 51,
+     56, 55, 64, 72, 92, 78, 64, 68, 87, 69, 55, 56, 80, 109, 81, 87,
+     95, 98, 103, 104, 103, 62, 77, 113, 121, 112, 100, 120, 92, 101, 103, 99},
+    {17, 18, 18, 24, 21, 24, 47, 26, 26, 47, 99, 66, 56, 66, 99, 99,
+     99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+     99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+     99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99}
+};
+
+// IJG quality for each SSDV quality level; 4 is the plain Annex K tables
+static const int Qualities[8] = { 13, 18, 29, 43, 50, 71, 86, 100 };
+
+static const uint8_t DCBits[2][16] = {
+    {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0},
+    {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0}
+};
+
+static const uint8_t DCValues[12] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11
+};
+
+static const uint8_t ACBits[2][16] = {
+    {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D},
+    {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77}
+};
+
+static const uint8_t ACValues[2][162] = {
+    {0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06,
+     0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08,
+     0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0, 0x24, 0x33, 0x62, 0x72,
+     0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+     0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45,
+     0x46, 0x47, 0x48, 0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+     0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6A, 0x73, 0x74, 0x75,
+     0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+     0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3,
+     0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6,
+     0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9,
+     0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+     0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4,
+     0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA},
+    {0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41,
+     0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91,
+     0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0, 0x15, 0x62, 0x72, 0xD1,
+     0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+     0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44,
+     0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+     0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6A, 0x73, 0x74,
+     0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+     0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A,
+     0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4,
+     0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7,
+     0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+     0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4,
+     0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA}
+};
+
+typedef struct {
+    const uint8_t *Bits, *Values;
+
+    // Decoding: codes of up to LOOKUP_BITS bits by table lookup, longer
+    // ones by code length
+    uint16_t Lookup[1 << LOOKUP_BITS];  // Length << 8 | symbol, 0 if long
+    int MaxCode[17], ValueIndex[17];
+
+    // Encoding, by symbol
+    uint16_t Code[256];
+    uint8_t Size[256];
+} huffman_table_t;
+
+// [0] luminance, [1] chrominance
+static huffman_table_t DCTables[2], ACTables[2];
+static pthread_once_t TablesOnce = PTHREAD_ONCE_INIT;
+
+static void
+BuildTable( huffman_table_t * Table, const uint8_t * Bits,
+            const uint8_t * Values )
+{
+    int Length, i, k, Code;
+
+    Table->Bits = Bits;
+    Table->Values = Values;
+
+    Code = 0;
+    k = 0;
+    for ( Length = 1; Length <= 16; Length++ )
+    {
+        Table->ValueIndex[Length] = k - Code;
+        for ( i = 0; i < Bits[Length - 1]; i++, k++, Code++ )
+        {
+            Table->Code[Values[k]] = Code;
+            Table->Size[Values[k]] = Length;
+
+            if ( Length <= LOOKUP_BITS )
+            {
+                int Shift = LOOKUP_BITS - Length, j;
+
+                for ( j = 0; j < ( 1 << Shift ); j++ )
+                {
+                    Table->Lookup[( Code << Shift ) | j] =
+                        ( Length << 8 ) | Values[k];
+                }
+            }
+        }
+        Table->MaxCode[Length] = Bits[Length - 1] ? Code - 1 : -1;
+        Code <<= 1;
+    }
+}
+
+static void
+BuildTables( void )
+{
+    int i;
+
+    for ( i = 0; i < 2; i++ )
+    {
+        BuildTable( &DCTables[i], DCBits[i], DCValues );
+        BuildTable( &ACTables[i], ACBits[i], ACValues[i] );
+    }
+}
+
+// JPEG output
+
+static void
+PutByte( ssdv_decoder_t * Decoder, uint8_t Byte )
+{
+    if ( Decoder->State.Length >= Decoder->JPEGSize )
+    {
+        size_t Size = Decoder->JPEGSize ? Decoder->JPEGSize * 2 : 16384;
+        unsigned char *JPEG = realloc( Decoder->JPEG, Size );
+
+        if ( JPEG == NULL )
+            return;
+
+        Decoder->JPEG = JPEG;
+        Decoder->JPEGSize = Size;
+    }
+
+    Decoder->JPEG[Decoder->State.Length++] = Byte;
+}
+
+static void
+PutBits( ssdv_decoder_t * Decoder, uint32_t Bits, int Count )
+{
+    ssdv_decoder_state_t *State = &Decoder->State;
+
+    State->OutBits = ( State->OutBits << Count ) | Bits;
+    State->OutCount += Count;
+
+    while ( State->OutCount >= 8 )
+    {
+        uint8_t Byte = State->OutBits >> ( State->OutCount - 8 );
+
+        PutByte( Decoder, Byte );
+        if ( Byte == 0xFF )
+        {
+            // Byte stuffing
+            PutByte( Decoder, 0x00 );
+        }
+        State->OutCount -= 8;
+    }
+
+    State->OutBits &= ( 1 << State->OutCount ) - 1;
+}
+
+// Huffman code for Symbol, then Size bits of Value
+static void
+PutSymbol( ssdv_decoder_t * Decoder, const huffman_table_t * Table,
+           int Symbol, int Value, int Size )
+{
+    PutBits( Decoder, Table->Code[Symbol], Table->Size[Symbol] );
+    if ( Size )
+    {
+        PutBits( Decoder, ( Value < 0 ? Value + ( 1 << Size ) - 1 : Value ) &
+                 ( ( 1 << Size ) - 1 ), Size );
+    }
+}
+
+static void
+PutDC( ssdv_decoder_t * Decoder, int Component, int Value )
+{
+    int Size, Magnitude;
+
+    Magnitude = Value < 0 ? -Value : Value;
+    for ( Size = 0; Magnitude; Size++ )
+    {
+        Magnitude >>= 1;
+    }
+
+    PutSymbol( Decoder, &DCTables[Component ? 1 : 0], Size, Value, Size );
+}
+
+static void
+PutEOB( ssdv_decoder_t * Decoder, int Component )
+{
+    PutSymbol( Decoder, &ACTables[Component ? 1 : 0], 0x00, 0, 0 );
+}
+
+static void
+PutMarker( ssdv_decoder_t * Decoder, uint8_t Marker, int Length )
+{
+    PutByte( Decoder, 0xFF );
+    PutByte( Decoder, Marker );
+    if ( Length )
+    {
+        PutByte( Decoder, ( Length + 2 ) >> 8 );
+        PutByte( Decoder, ( Length + 2 ) & 0xFF );
+    }
+}
+
+static void
+PutHuffmanTable( ssdv_decoder_t * Decoder, int Class, int ID,
+                 const huffman_table_t * Table )
+{
+    int i, Count;
+
+    for ( Count = 0, i = 0; i < 16; i++ )
+    {
+        Count += Table->Bits[i];
+    }
+
+    PutMarker( Decoder, 0xC4, 17 + Count );
+    PutByte( Decoder, ( Class << 4 ) | ID );
+    for ( i = 0; i < 16; i++ )
+    {
+        PutByte( Decoder, Table->Bits[i] );
+    }
+    for ( i = 0; i < Count; i++ )
+    {
+        PutByte( Decoder, Table->Values[i] );
+    }
+}
+
+static void
+PutHeaders( ssdv_decoder_t * Decoder, int Quality, int Horizontal,
+            int Vertical )
+{
+    static const uint8_t JFIF[14] = {
+        'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0
+    };
+    int i, Table, Scale, Value;
+
+    PutMarker( Decoder, 0xD8, 0 );
+
+    PutMarker( Decoder, 0xE0, sizeof( JFIF ) );
+    for ( i = 0; i < sizeof( JFIF ); i++ )
+    {
+        PutByte( Decoder, JFIF[i] );
+    }
+
+    Quality = Qualities[Quality];
+    Scale = Quality < 50 ? 5000 / Quality : 200 - Quality * 2;
+    for ( Table = 0; Table < 2; Table++ )
+    {
+        PutMarker( Decoder, 0xDB, 65 );
+        PutByte( Decoder, Table );
+        for ( i = 0; i < 64; i++ )
+        {
+            Value = ( StdDQT[Table][i] * Scale + 50 ) / 100;
+            PutByte( Decoder, Value < 1 ? 1 : Value > 255 ? 255 : Value );
+        }
+    }
+
+    PutMarker( Decoder, 0xC0, 15 );
+    PutByte( Decoder, 8 );
+    PutByte( Decoder, Decoder->Height >> 8 );
+    PutByte( Decoder, Decoder->Height & 0xFF );
+    PutByte( Decoder, Decoder->Width >> 8 );
+    PutByte( Decoder, Decoder->Width & 0xFF );
+    PutByte( Decoder, 3 );
+    PutByte( Decoder, 1 );
+    PutByte( Decoder, ( Horizontal << 4 ) | Vertical );
+    PutByte( Decoder, 0 );
+    PutByte( Decoder, 2 );
+    PutByte( Decoder, 0x11 );
+    PutByte( Decoder, 1 );
+    PutByte( Decoder, 3 );
+    PutByte( Decoder, 0x11 );
+    PutByte( Decoder, 1 );
+
+    PutHuffmanTable( Decoder, 0, 0, &DCTables[0] );
+    PutHuffmanTable( Decoder, 1, 0, &ACTables[0] );
+    PutHuffmanTable( Decoder, 0, 1, &DCTables[1] );
+    PutHuffmanTable( Decoder, 1, 1, &ACTables[1] );
+
+    PutMarker( Decoder, 0xDA, 10 );
+    PutByte( Decoder, 3 );
+    PutByte( Decoder, 1 );
+    PutByte( Decoder, 0x00 );
+    PutByte( Decoder, 2 );
+    PutByte( Decoder, 0x11 );
+    PutByte( Decoder, 3 );
+    PutByte( Decoder, 0x11 );
+    PutByte( Decoder, 0 );
+    PutByte( Decoder, 63 );
+    PutByte( Decoder, 0 );
+}
+
+// Scan decoding
+
+static int
+BlockComponent( const ssdv_decoder_t * Decoder, int Block )
+{
+    return Block < Decoder->YBlocks ? 0 : Block - Decoder->YBlocks + 1;
+}
+
+static void
+NextBlock( ssdv_decoder_t * Decoder )
+{
+    ssdv_decoder_state_t *State = &Decoder->State;
+
+    State->Coefficient = 0;
+    if ( ++State->Block >= Decoder->YBlocks + 2 )
+    {
+        State->Block = 0;
+        if ( ++State->MCU >= Decoder->MCUCount )
+        {
+            State->Done = 1;
+        }
+    }
+}
+
+// Returns symbol, and sets *Length, or -1 if more bits are needed
+static int
+PeekSymbol( const ssdv_decoder_state_t * State, const huffman_table_t * Table,
+            int *Length )
+{
+    uint32_t Bits;
+    int Entry, Code, i;
+
+    // Next 16 bits, padded with zeroes if we don't have that many yet
+    Bits = State->InCount >= 16 ?
+        ( State->InBits >> ( State->InCount - 16 ) ) & 0xFFFF :
+        ( State->InBits << ( 16 - State->InCount ) ) & 0xFFFF;
+
+    Entry = Table->Lookup[Bits >> ( 16 - LOOKUP_BITS )];
+    if ( Entry )
+    {
+        *Length = Entry >> 8;
+        return *Length <= State->InCount ? ( Entry & 0xFF ) : -1;
+    }
+
+    for ( i = LOOKUP_BITS + 1; i <= 16; i++ )
+    {
+        Code = Bits >> ( 16 - i );
+        if ( Code <= Table->MaxCode[i] )
+        {
+            *Length = i;
+            return i <= State->InCount ?
+                Table->Values[Table->ValueIndex[i] + Code] : -1;
+        }
+    }
+
+    // Not a valid code; skip a bit and hope to resynchronise
+    *Length = 1;
+    return State->InCount >= 16 ? 0x100 : -1;
+}
+
+// Decode one symbol, with its value, and write it to the JPEG
+static int
+DecodeSymbol( ssdv_decoder_t * Decoder )
+{
+    ssdv_decoder_state_t *State = &Decoder->State;
+    int Component, Symbol, Length, Size, Value;
+
+    Component = BlockComponent( Decoder, State->Block );
+
+    // A packet's first MCU starts on a byte boundary, at the offset given
+    // in the header; skip the padding before it
+    if ( ( State->MCU == State->ResetMCU ) && ( State->Block == 0 )
+         && ( State->Coefficient == 0 ) )
+    {
+        State->InCount -= State->InCount % 8;
+    }
+
+    Symbol = PeekSymbol( State, State->Coefficient ?
+                         &ACTables[Component ? 1 : 0] :
+                         &DCTables[Component ? 1 : 0], &Length );
+    if ( Symbol < 0 )
+        return FEED_ME;
+
+    if ( Symbol > 0xFF )
+    {
+        State->InCount -= Length;
+        return DECODED;
+    }
+
+    Size = Symbol & 0x0F;
+    if ( State->InCount < Length + Size )
+        return FEED_ME;
+
+    State->InCount -= Length + Size;
+    Value = ( State->InBits >> State->InCount ) & ( ( 1 << Size ) - 1 );
+    if ( Size && ( Value < ( 1 << ( Size - 1 ) ) ) )
+    {
+        Value -= ( 1 << Size ) - 1;
+    }
+
+    if ( State->Coefficient == 0 )
+    {
+        // The first block of each component in a packet's first MCU has
+        // an absolute DC value
+        if ( ( State->MCU == State->ResetMCU )
+             && ( ( State->Block == 0 ) || ( Component > 0 ) ) )
+        {
+            PutDC( Decoder, Component, Value - State->DC[Component] );
+            State->DC[Component] = Value;
+        }
+        else
+        {
+            PutDC( Decoder, Component, Value );
+            State->DC[Component] += Value;
+        }
+        State->Coefficient = 1;
+    }
+    else
+    {
+        PutSymbol( Decoder, &ACTables[Component ? 1 : 0], Symbol, Value,
+                   Size );
+
+        if ( Symbol == 0x00 )
+        {
+            // EOB
+            State->Coefficient = 64;
+        }
+        else
+        {
+            State->Coefficient += ( Symbol >> 4 ) + 1;
+        }
+    }
+
+    if ( State->Coefficient >= 64 )
+    {
+        NextBlock( Decoder );
+    }
+
+    return DECODED;
+}
+
+// Pad out the MCUs we don't have, up to MCU, in grey
+static void
+FillTo( ssdv_decoder_t * Decoder, int MCU )
+{
+    ssdv_decoder_state_t *State = &Decoder->State;
+    int Component;
+
+    if ( State->Done )
+        return;
+
+    // Finish the current MCU
+    if ( State->Block || State->Coefficient )
+    {
+        if ( State->Coefficient )
+        {
+            PutEOB( Decoder, BlockComponent( Decoder, State->Block ) );
+            NextBlock( Decoder );
+        }
+
+        while ( State->Block )
+        {
+            Component = BlockComponent( Decoder, State->Block );
+            PutDC( Decoder, Component, 0 );
+            PutEOB( Decoder, Component );
+            NextBlock( Decoder );
+        }
+    }
+
+    while ( !State->Done && ( State->MCU < MCU ) )
+    {
+        Component = BlockComponent( Decoder, State->Block );
+        if ( ( State->Block == 0 ) || ( Component > 0 ) )
+        {
+            PutDC( Decoder, Component, -State->DC[Component] );
+            State->DC[Component] = 0;
+        }
+        else
+        {
+            PutDC( Decoder, Component, 0 );
+        }
+        PutEOB( Decoder, Component );
+        NextBlock( Decoder );
+    }
+}
+
+static int
+StartImage( ssdv_decoder_t * Decoder, const unsigned char *Packet )
+{
+    static const int Horizontal[4] = { 2, 1, 2, 1 };
+    static const int Vertical[4] = { 2, 2, 1, 1 };
+    int Mode;
+
+    pthread_once( &TablesOnce, BuildTables );
+
+    switch ( Packet[1] )
+    {
+        case 0x66:
+            // Normal mode, with FEC
+            Decoder->PayloadSize = 205;
+            break;
+
+        case 0x67:
+            // No FEC
+            Decoder->PayloadSize = 237;
+            break;
+
+        default:
+            return -1;
+    }
+
+    Decoder->Width = Packet[9] * 16;
+    Decoder->Height = Packet[10] * 16;
+    if ( ( Decoder->Width == 0 ) || ( Decoder->Height == 0 ) )
+        return -1;
+
+    Mode = Packet[11] & 0x03;
+    Decoder->YBlocks = Horizontal[Mode] * Vertical[Mode];
+    Decoder->MCUCount = Packet[9] * Packet[10] * 4 / Decoder->YBlocks;
+
+    memset( &Decoder->State, 0, sizeof( Decoder->State ) );
+    PutHeaders( Decoder, ( ( Packet[11] >> 3 ) & 7 ) ^ 4, Horizontal[Mode],
+                Vertical[Mode] );
+    Decoder->Ready = 1;
+
+    return 0;
+}
+
+// Feed the next packet (256 bytes, sync byte included).  Packet IDs must
+// increase; any skipped are filled in.  Returns -1 if the packet can't be
+// decoded.
+int
+SSDVDecoderFeed( ssdv_decoder_t * Decoder, const unsigned char *Packet )
+{
+    ssdv_decoder_state_t *State = &Decoder->State;
+    int PacketID, Offset, MCU, ID, i;
+
+    if ( !Decoder->Ready && ( StartImage( Decoder, Packet ) < 0 ) )
+        return -1;
+
+    PacketID = ( Packet[7] << 8 ) | Packet[8];
+    Offset = Packet[12];
+    MCU = ( Packet[13] << 8 ) | Packet[14];
+
+    if ( State->Done || ( PacketID < State->NextPacket ) )
+        return 0;
+
+    // Remember where we were, for this packet and any we're skipping
+    if ( PacketID >= Decoder->CheckpointSize )
+    {
+        int Size = Decoder->CheckpointSize ? Decoder->CheckpointSize : 64;
+        ssdv_decoder_state_t *Checkpoints;
+
+        while ( Size <= PacketID )
+        {
+            Size *= 2;
+        }
+        if ( ( Checkpoints = realloc( Decoder->Checkpoints,
+                                      Size * sizeof( *Checkpoints ) ) ) == NULL )
+            return -1;
+
+        Decoder->Checkpoints = Checkpoints;
+        Decoder->CheckpointSize = Size;
+    }
+    for ( ID = State->NextPacket; ID <= PacketID; ID++ )
+    {
+        Decoder->Checkpoints[ID] = *State;
+    }
+
+    i = 0;
+    if ( PacketID != State->NextPacket )
+    {
+        // Packets missing.  Start again at the first MCU in this one, if
+        // there is one.
+        if ( ( Offset == 0xFF ) || ( Offset >= Decoder->PayloadSize )
+             || ( MCU < State->MCU ) || ( MCU >= Decoder->MCUCount ) )
+            return 0;
+
+        FillTo( Decoder, MCU );
+        State->InBits = 0;
+        State->InCount = 0;
+        i = Offset;
+    }
+
+    if ( Offset != 0xFF )
+    {
+        State->ResetMCU = MCU;
+    }
+    State->NextPacket = PacketID + 1;
+
+    while ( !State->Done )
+    {
+        // Keep the bit buffer topped up with whole bytes; a symbol and its
+        // value are never more than 27 bits, so this only runs dry at the
+        // end of the packet
+        while ( ( i < Decoder->PayloadSize ) && ( State->InCount <= 56 ) )
+        {
+            State->InBits = ( State->InBits << 8 ) |
+                Packet[SSDV_HEADER_SIZE + i++];
+            State->InCount += 8;
+        }
+
+        if ( DecodeSymbol( Decoder ) == FEED_ME )
+            break;
+    }
+
+    return 0;
+}
+
+// Go back to just before PacketID, so it and the ones after it can be fed
+// again
+void
+SSDVDecoderRewind( ssdv_decoder_t * Decoder, int PacketID )
+{
+    if ( Decoder->Ready && ( PacketID < Decoder->State.NextPacket ) )
+    {
+        Decoder->State = Decoder->Checkpoints[PacketID];
+    }
+}
+
+// The image so far, as a complete JPEG with anything not yet received in
+// grey.  Valid until the decoder is next used.
+const unsigned char *
+SSDVDecoderJPEG( ssdv_decoder_t * Decoder, size_t * Length )
+{
+    ssdv_decoder_state_t Saved;
+
+    if ( !Decoder->Ready )
+        return NULL;
+
+    // Finish a copy, leaving the decoder where it was
+    Saved = Decoder->State;
+
+    FillTo( Decoder, Decoder->MCUCount );
+    if ( Decoder->State.OutCount )
+    {
+        PutBits( Decoder, 0xFF >> Decoder->State.OutCount,
+                 8 - Decoder->State.OutCount );
+    }
+    PutMarker( Decoder, 0xD9, 0 );
+
+    *Length = Decoder->State.Length;
+    Decoder->State = Saved;
+
+    return Decoder->JPEG;
+}
+
+void
+SSDVDecoderFree( ssdv_decoder_t * Decoder )
+{
+    free( Decoder->Checkpoints );
+    free( Decoder->JPEG );
+    memset( Decoder, 0, sizeof( *Decoder ) );
+}
+
+// Decode a file of 256-byte packets, as saved by the gateway, in one go
+int
+SSDVDecodeFile( const char *SSDVFile, const char *JPEGFile )
+{
+    ssdv_decoder_t Decoder;
+    unsigned char Packet[SSDV_PACKET_SIZE];
+    const unsigned char *JPEG;
+    size_t Length;
+    FILE *fp;
+    int Result;
+
+    if ( ( fp = fopen( SSDVFile, "rb" ) ) == NULL )
+        return -1;
+
+    memset( &Decoder, 0, sizeof( Decoder ) );
+    while ( fread( Packet, SSDV_PACKET_SIZE, 1, fp ) == 1 )
+    {
+        // Missing packets are zeroes
+        if ( ( Packet[0] == 0x55 )
+             && ( SSDVDecoderFeed( &Decoder, Packet ) < 0 ) )
+        {
+            break;
+        }
+    }
+    fclose( fp );
+
+    Result = -1;
+    if ( ( JPEG = SSDVDecoderJPEG( &Decoder, &Length ) )
+         && ( fp = fopen( JPEGFile, "wb" ) ) )
+    {
+        if ( fwrite( JPEG, 1, Length, fp ) == Length )
+        {
+            Result = 0;
+        }
+        fclose( fp );
+    }
+
+    SSDVDecoderFree( &Decoder );
+
+    return Result;
+}
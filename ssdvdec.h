@@ -0,0 +1,57 @@
+#ifndef _H_SSDVDec
+#define _H_SSDVDec
+
+#include <stddef.h>
+#include <stdint.h>
+
+// SSDV to JPEG decoder.
+//
+// SSDV packets carry the JPEG scan more or less as is, using the standard
+// Huffman tables, except that the first MCU starting in each packet has
+// absolute rather than relative DC values so that a packet can be decoded
+// without the ones before it.  Decoding is therefore just re-emitting the
+// scan with the DC values fixed up, behind headers rebuilt from the packet
+// header.
+//
+// Packets are fed one at a time in packet ID order and the JPEG grows as
+// they arrive.  A gap in the packet IDs is filled with grey MCUs up to the
+// next packet's first MCU.  The decoder state before each packet is kept,
+// so if a missing packet turns up later the decoder can be rewound to it
+// and the rest fed again.  A complete, valid JPEG of what's been decoded
+// so far is available at any time.
+
+typedef struct {
+    uint64_t InBits;            // Scan bits not yet decoded
+    int InCount;
+    int MCU, Block, Coefficient;        // Position in the scan
+    int ResetMCU;               // MCU with absolute DC values
+    int DC[3];                  // Y, Cb, Cr
+    uint32_t OutBits;           // Bits not yet written to the JPEG
+    int OutCount;
+    size_t Length;              // JPEG so far
+    int NextPacket;
+    int Done;
+} ssdv_decoder_state_t;
+
+typedef struct {
+    int Ready;                  // Headers written
+    int Width, Height;
+    int PayloadSize;
+    int MCUCount, YBlocks;
+    ssdv_decoder_state_t State;
+    ssdv_decoder_state_t *Checkpoints;  // State before each packet ID
+    int CheckpointSize;
+    unsigned char *JPEG;
+    size_t JPEGSize;
+} ssdv_decoder_t;
+
+// A zeroed ssdv_decoder_t is ready to use
+int SSDVDecoderFeed( ssdv_decoder_t * Decoder, const unsigned char *Packet );
+void SSDVDecoderRewind( ssdv_decoder_t * Decoder, int PacketID );
+const unsigned char *SSDVDecoderJPEG( ssdv_decoder_t * Decoder,
+                                      size_t * Length );
+void SSDVDecoderFree( ssdv_decoder_t * Decoder );
+
+int SSDVDecodeFile( const char *SSDVFile, const char *JPEGFile );
+
+#endif
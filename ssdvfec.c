@@ -0,0 +1,274 @@
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "ssdvfec.h"
+#include "crc.h"
+
+#define RS_NN       255         // Codeword, Packet[1..255]
+#define RS_NROOTS   32
+#define RS_FCR      112
+#define RS_PRIM     11
+#define RS_IPRIM    116         // RS_PRIM * RS_IPRIM = 1 mod 255
+#define RS_GFPOLY   0x187
+#define A0          RS_NN       // log of zero
+
+static uint8_t AlphaTo[256], IndexOf[256];
+static pthread_once_t TablesOnce = PTHREAD_ONCE_INIT;
+
+static void
+BuildTables( void )
+{
+    int i, sr;
+
+    sr = 1;
+    for ( i = 0; i < RS_NN; i++ )
+    {
+        IndexOf[sr] = i;
+        AlphaTo[i] = sr;
+        sr <<= 1;
+        if ( sr & 0x100 )
+        {
+            sr ^= RS_GFPOLY;
+        }
+    }
+    IndexOf[0] = A0;
+    AlphaTo[A0] = 0;
+}
+
+static inline int
+ModNN( int x )
+{
+    while ( x >= RS_NN )
+    {
+        x -= RS_NN;
+        x = ( x >> 8 ) + ( x & RS_NN );
+    }
+    return x;
+}
+
+// Correct Data[0..254] in place (Karn's Berlekamp-Massey / Chien / Forney
+// decoder, no erasures).  Returns the number of bytes corrected, or
+// SSDV_FEC_FAILED if there are too many errors to locate.
+static int
+DecodeRS( uint8_t * Data )
+{
+    uint8_t Lambda[RS_NROOTS + 1], S[RS_NROOTS], B[RS_NROOTS + 1],
+        T[RS_NROOTS + 1], Omega[RS_NROOTS + 1], Reg[RS_NROOTS + 1];
+    int Root[RS_NROOTS], Loc[RS_NROOTS];
+    int i, j, k, r, el, Count, DegLambda, DegOmega, Discr, Error;
+    int Num1, Num2, Den, q;
+
+    // Syndromes, by Horner's rule at each root
+    for ( i = 0; i < RS_NROOTS; i++ )
+    {
+        S[i] = Data[0];
+    }
+    for ( j = 1; j < RS_NN; j++ )
+    {
+        for ( i = 0; i < RS_NROOTS; i++ )
+        {
+            if ( S[i] == 0 )
+                S[i] = Data[j];
+            else
+                S[i] = Data[j] ^
+                    AlphaTo[ModNN( IndexOf[S[i]] + ( RS_FCR + i ) * RS_PRIM )];
+        }
+    }
+
+    Error = 0;
+    for ( i = 0; i < RS_NROOTS; i++ )
+    {
+        Error |= S[i];
+        S[i] = IndexOf[S[i]];
+    }
+    if ( !Error )
+    {
+        return 0;
+    }
+
+    // Error locator polynomial
+    memset( &Lambda[1], 0, RS_NROOTS );
+    Lambda[0] = 1;
+    for ( i = 0; i <= RS_NROOTS; i++ )
+    {
+        B[i] = IndexOf[Lambda[i]];
+    }
+
+    el = 0;
+    for ( r = 1; r <= RS_NROOTS; r++ )
+    {
+        Discr = 0;
+        for ( i = 0; i < r; i++ )
+        {
+            if ( ( Lambda[i] != 0 ) && ( S[r - i - 1] != A0 ) )
+                Discr ^= AlphaTo[ModNN( IndexOf[Lambda[i]] + S[r - i - 1] )];
+        }
+        Discr = IndexOf[Discr];
+
+        if ( Discr == A0 )
+        {
+            memmove( &B[1], B, RS_NROOTS );
+            B[0] = A0;
+            continue;
+        }
+
+        T[0] = Lambda[0];
+        for ( i = 0; i < RS_NROOTS; i++ )
+        {
+            if ( B[i] != A0 )
+                T[i + 1] = Lambda[i + 1] ^ AlphaTo[ModNN( Discr + B[i] )];
+            else
+                T[i + 1] = Lambda[i + 1];
+        }
+
+        if ( 2 * el <= r - 1 )
+        {
+            el = r - el;
+            for ( i = 0; i <= RS_NROOTS; i++ )
+            {
+                B[i] = ( Lambda[i] == 0 ) ? A0 :
+                    ModNN( IndexOf[Lambda[i]] - Discr + RS_NN );
+            }
+        }
+        else
+        {
+            memmove( &B[1], B, RS_NROOTS );
+            B[0] = A0;
+        }
+        memcpy( Lambda, T, RS_NROOTS + 1 );
+    }
+
+    DegLambda = 0;
+    for ( i = 0; i <= RS_NROOTS; i++ )
+    {
+        Lambda[i] = IndexOf[Lambda[i]];
+        if ( Lambda[i] != A0 )
+            DegLambda = i;
+    }
+
+    // Chien search for its roots, which give the error positions
+    memcpy( &Reg[1], &Lambda[1], RS_NROOTS );
+    Count = 0;
+    for ( i = 1, k = RS_IPRIM - 1; i <= RS_NN; i++, k = ModNN( k + RS_IPRIM ) )
+    {
+        q = 1;
+        for ( j = DegLambda; j > 0; j-- )
+        {
+            if ( Reg[j] != A0 )
+            {
+                Reg[j] = ModNN( Reg[j] + j );
+                q ^= AlphaTo[Reg[j]];
+            }
+        }
+        if ( q != 0 )
+            continue;
+
+        Root[Count] = i;
+        Loc[Count] = k;
+        if ( ++Count == DegLambda )
+            break;
+    }
+
+    if ( ( DegLambda == 0 ) || ( Count != DegLambda ) )
+    {
+        return SSDV_FEC_FAILED;
+    }
+
+    // Error evaluator polynomial
+    DegOmega = DegLambda - 1;
+    for ( i = 0; i <= DegOmega; i++ )
+    {
+        int Tmp = 0;
+
+        for ( j = i; j >= 0; j-- )
+        {
+            if ( ( S[i - j] != A0 ) && ( Lambda[j] != A0 ) )
+                Tmp ^= AlphaTo[ModNN( S[i - j] + Lambda[j] )];
+        }
+        Omega[i] = IndexOf[Tmp];
+    }
+
+    // Forney's algorithm for the error values
+    for ( j = Count - 1; j >= 0; j-- )
+    {
+        Num1 = 0;
+        for ( i = DegOmega; i >= 0; i-- )
+        {
+            if ( Omega[i] != A0 )
+                Num1 ^= AlphaTo[ModNN( Omega[i] + i * Root[j] )];
+        }
+        Num2 = AlphaTo[ModNN( Root[j] * ( RS_FCR - 1 ) + RS_NN )];
+
+        Den = 0;
+        for ( i = ( DegLambda < RS_NROOTS - 1 ? DegLambda : RS_NROOTS - 1 ) & ~1;
+              i >= 0; i -= 2 )
+        {
+            if ( Lambda[i + 1] != A0 )
+                Den ^= AlphaTo[ModNN( Lambda[i + 1] + i * Root[j] )];
+        }
+        if ( Den == 0 )
+        {
+            return SSDV_FEC_FAILED;
+        }
+
+        if ( Num1 != 0 )
+        {
+            Data[Loc[j]] ^= AlphaTo[ModNN( IndexOf[Num1] + IndexOf[Num2] +
+                                           RS_NN - IndexOf[Den] )];
+        }
+    }
+
+    return Count;
+}
+
+// CRC32 over Data[0 .. Length-1], stored big-endian straight after it
+static int
+CRCOK( const unsigned char *Data, int Length )
+{
+    const unsigned char *p = Data + Length;
+    uint32_t Stored;
+
+    Stored = ( ( uint32_t ) p[0] << 24 ) | ( p[1] << 16 ) | ( p[2] << 8 ) | p[3];
+
+    return CRC32Update( 0, Data, Length ) == Stored;
+}
+
+// Check a received packet, repairing it if possible.  Returns the number
+// of bytes corrected (0 if it was fine), or SSDV_FEC_FAILED.  Packet types
+// without a CRC are passed through unchecked.
+int
+SSDVPacketRepair( unsigned char *Packet, int Bytes )
+{
+    unsigned char Copy[RS_NN];
+    int Fixed;
+
+    switch ( Packet[1] )
+    {
+        case 0x66:
+            if ( Bytes < RS_NN )
+                return SSDV_FEC_FAILED;
+
+            if ( CRCOK( Packet + 1, 219 ) )
+                return 0;
+
+            pthread_once( &TablesOnce, BuildTables );
+
+            // Only keep the correction if the CRC agrees with it
+            memcpy( Copy, Packet + 1, RS_NN );
+            Fixed = DecodeRS( Copy );
+            if ( ( Fixed <= 0 ) || !CRCOK( Copy, 219 ) )
+                return SSDV_FEC_FAILED;
+
+            memcpy( Packet + 1, Copy, RS_NN );
+            return Fixed;
+
+        case 0x67:
+            if ( Bytes < RS_NN )
+                return SSDV_FEC_FAILED;
+
+            return CRCOK( Packet + 1, 251 ) ? 0 : SSDV_FEC_FAILED;
+    }
+
+    return 0;
+}
@@ -0,0 +1,17 @@
+#ifndef _H_SSDVFec
+#define _H_SSDVFec
+
+// SSDV packet check and repair.  Every packet ends in a CRC32; normal (0x66)
+// packets also carry 32 bytes of Reed-Solomon parity, RS(255,223) with the
+// CCSDS code parameters, which can correct up to 16 bad bytes.  Packets
+// whose CRC is good are passed straight through; the RS decoder is only run
+// on ones that fail.
+//
+// Packet is the full 256 bytes as stored, with Packet[0] the sync byte
+// (which isn't covered by either check) and Bytes counted from Packet[1].
+
+#define SSDV_FEC_FAILED     -1
+
+int SSDVPacketRepair( unsigned char *Packet, int Bytes );
+
+#endif
@@ -0,0 +1,728 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "ssdvimage.h"
+#include "ssdvdec.h"
+#include "ftp.h"
+#include "gateway.h"
+
+#define SSDV_PACKET_SIZE    256
+#define SSDV_MAX_PACKETS    65536   // Packet IDs are 16 bits
+
+typedef struct ssdv_image {
+    struct ssdv_image *Next;
+    char Callsign[7];
+    int ImageNumber;
+    unsigned char *Packets;     // SSDV_PACKET_SIZE each, by packet ID
+    uint64_t *Received;         // Bit per packet ID
+    int Capacity;               // Packets allocated
+    int HighestPacket;
+    int EOIPacket;              // -1 until the last packet is seen
+    int PacketCount;            // Distinct packets received
+    time_t LastPacketAt;
+    int Dirty;                  // Has packets not yet written
+    int Superseded;             // Payload has started a later image
+    ssdv_decoder_t Decoder;     // JPEG so far
+    pthread_mutex_t DecoderLock;
+} ssdv_image_t;
+
+// ImageLock covers the list and the packets; each image's decoder has its
+// own lock so that decoding, and copying the JPEG out, don't hold up the
+// rest.  Take ImageLock first.  Every channel's packet thread adds packets,
+// so storing one (which may reallocate Packets and Received) needs both
+// locks, and reading them needs either: the decoder runs holding only
+// DecoderLock.
+static ssdv_image_t *Images = NULL;
+static pthread_mutex_t ImageLock = PTHREAD_MUTEX_INITIALIZER;
+
+static int
+GrowImage( ssdv_image_t * Image, int PacketNumber )
+{
+    unsigned char *Packets;
+    uint64_t *Received;
+    int Capacity;
+
+    for ( Capacity = Image->Capacity ? Image->Capacity : 64;
+          Capacity <= PacketNumber; Capacity *= 2 )
+    {
+    }
+
+    if ( ( Packets = realloc( Image->Packets,
+                              ( size_t ) Capacity * SSDV_PACKET_SIZE ) ) == NULL )
+    {
+        return -1;
+    }
+    Image->Packets = Packets;
+
+    if ( ( Received = realloc( Image->Received,
+                               Capacity / 64 * sizeof( uint64_t ) ) ) == NULL )
+    {
+        return -1;
+    }
+    Image->Received = Received;
+
+    // Missing packets are written as zeroes, as they were with the old
+    // sparse files
+    memset( Image->Packets + ( size_t ) Image->Capacity * SSDV_PACKET_SIZE, 0,
+            ( size_t ) ( Capacity - Image->Capacity ) * SSDV_PACKET_SIZE );
+    memset( Image->Received + Image->Capacity / 64, 0,
+            ( Capacity - Image->Capacity ) / 64 * sizeof( uint64_t ) );
+    Image->Capacity = Capacity;
+
+    return 0;
+}
+
+static int
+ImageComplete( const ssdv_image_t * Image )
+{
+    return ( Image->EOIPacket >= 0 )
+        && ( Image->PacketCount >= Image->EOIPacket + 1 );
+}
+
+// Write the whole image, under a temporary name so nothing ever sees it
+// half written
+static void
+WriteImage( ssdv_image_t * Image )
+{
+    char FileName[64], TempName[64];
+    FILE *fp;
+    size_t Count;
+
+    sprintf( FileName, "/tmp/%s_%d.bin", Image->Callsign,
+             Image->ImageNumber );
+    sprintf( TempName, "/tmp/%s_%d.tmp", Image->Callsign,
+             Image->ImageNumber );
+
+    Count = Image->HighestPacket + 1;
+    if ( ( fp = fopen( TempName, "wb" ) ) == NULL )
+    {
+        LogMessage( "** FAILED TO CREATE SSDV FILE %s\n", TempName );
+        return;
+    }
+
+    if ( fwrite( Image->Packets, SSDV_PACKET_SIZE, Count, fp ) != Count )
+    {
+        LogMessage( "** FAILED TO WRITE TO SSDV FILE\n" );
+        fclose( fp );
+        remove( TempName );
+        return;
+    }
+
+    fclose( fp );
+    rename( TempName, FileName );
+
+    Image->Dirty = 0;
+}
+
+static int
+HavePacket( const ssdv_image_t * Image, int PacketNumber )
+{
+    return ( Image->Received[PacketNumber / 64] >> ( PacketNumber % 64 ) ) & 1;
+}
+
+// Bring the image's JPEG up to date with a new packet.  One that fills an
+// earlier gap means going back to it and feeding the rest again.
+static void
+DecodePacket( ssdv_image_t * Image, int PacketNumber )
+{
+    int i;
+
+    if ( PacketNumber < Image->Decoder.State.NextPacket )
+    {
+        SSDVDecoderRewind( &Image->Decoder, PacketNumber );
+    }
+
+    for ( i = Image->Decoder.State.NextPacket; i <= Image->HighestPacket; i++ )
+    {
+        if ( HavePacket( Image, i ) )
+        {
+            SSDVDecoderFeed( &Image->Decoder,
+                             Image->Packets + ( size_t ) i * SSDV_PACKET_SIZE );
+        }
+    }
+}
+
+// Called with ImageLock held.  Waits for the image to finish decoding.
+static void
+FreeImage( ssdv_image_t * Image )
+{
+    pthread_mutex_lock( &Image->DecoderLock );
+    pthread_mutex_unlock( &Image->DecoderLock );
+    pthread_mutex_destroy( &Image->DecoderLock );
+
+    SSDVDecoderFree( &Image->Decoder );
+    free( Image->Packets );
+    free( Image->Received );
+    free( Image );
+}
+
+// Packet is a full 256-byte SSDV packet, sync byte included, from the
+// payload with the given (decoded) callsign
+ssdv_packet_status_t
+SSDVImageAddPacket( const char *Callsign, const unsigned char *Packet,
+                    time_t Now )
+{
+    ssdv_image_t *Image, *Other;
+    ssdv_packet_status_t Status;
+    int ImageNumber, PacketNumber, Decode;
+
+    ImageNumber = Packet[6];
+    PacketNumber = Packet[7] * 256 + Packet[8];
+
+    pthread_mutex_lock( &ImageLock );
+
+    for ( Image = Images; Image; Image = Image->Next )
+    {
+        if ( ( Image->ImageNumber == ImageNumber )
+             && !strcmp( Image->Callsign, Callsign ) )
+        {
+            break;
+        }
+    }
+
+    Status = SSDV_PACKET_NEW;
+    if ( Image == NULL )
+    {
+        if ( ( Image = calloc( 1, sizeof( *Image ) ) ) == NULL )
+        {
+            pthread_mutex_unlock( &ImageLock );
+            return SSDV_PACKET_REPEAT;
+        }
+
+        strncpy( Image->Callsign, Callsign, sizeof( Image->Callsign ) - 1 );
+        pthread_mutex_init( &Image->DecoderLock, NULL );
+        Image->ImageNumber = ImageNumber;
+        Image->HighestPacket = -1;
+        Image->EOIPacket = -1;
+        Image->Next = Images;
+        Images = Image;
+
+        // Earlier images from this payload won't be getting any more
+        for ( Other = Image->Next; Other; Other = Other->Next )
+        {
+            if ( !strcmp( Other->Callsign, Callsign ) )
+            {
+                Other->Superseded = 1;
+            }
+        }
+
+        Status = SSDV_PACKET_NEW_IMAGE;
+    }
+
+    Image->LastPacketAt = Now;
+    Image->Superseded = 0;
+
+    // Another channel may be decoding this image from its packets
+    pthread_mutex_lock( &Image->DecoderLock );
+
+    if ( ( PacketNumber >= Image->Capacity )
+         && ( GrowImage( Image, PacketNumber ) < 0 ) )
+    {
+        LogMessage( "** NO MEMORY FOR SSDV PACKET\n" );
+        pthread_mutex_unlock( &Image->DecoderLock );
+        pthread_mutex_unlock( &ImageLock );
+        return SSDV_PACKET_REPEAT;
+    }
+
+    Decode = 0;
+    if ( HavePacket( Image, PacketNumber ) )
+    {
+        if ( Status == SSDV_PACKET_NEW )
+        {
+            Status = SSDV_PACKET_REPEAT;
+        }
+    }
+    else
+    {
+        Image->Received[PacketNumber / 64] |= 1ULL << ( PacketNumber % 64 );
+        memcpy( Image->Packets + ( size_t ) PacketNumber * SSDV_PACKET_SIZE,
+                Packet, SSDV_PACKET_SIZE );
+        Image->PacketCount++;
+        Image->Dirty = 1;
+
+        if ( PacketNumber > Image->HighestPacket )
+        {
+            Image->HighestPacket = PacketNumber;
+        }
+
+        // Flags byte, bit 2 marks the last packet of the image
+        if ( Packet[11] & 0x04 )
+        {
+            Image->EOIPacket = PacketNumber;
+        }
+
+        if ( ImageComplete( Image ) )
+        {
+            LogMessage( "Image %s_%d complete, %d packets\n", Image->Callsign,
+                        Image->ImageNumber, Image->PacketCount );
+            WriteImage( Image );
+        }
+
+        // Conversion will wait for the decoder, so this can be queued now
+        QueueImageConversion( Image->Callsign, Image->ImageNumber,
+                              ( Packet[11] & 0x04 ) || ImageComplete( Image ) );
+
+        Decode = 1;
+    }
+
+    pthread_mutex_unlock( &ImageLock );
+
+    if ( Decode )
+    {
+        DecodePacket( Image, PacketNumber );
+    }
+    pthread_mutex_unlock( &Image->DecoderLock );
+
+    return Status;
+}
+
+// Called every second or so.  Writes incomplete images that have gone
+// quiet (or all of them, at shutdown), and frees ones not heard for a while
+// along with their files.
+void
+SSDVImageFlush( time_t Now, int All )
+{
+    ssdv_image_t **Link, *Image;
+
+    pthread_mutex_lock( &ImageLock );
+
+    for ( Link = &Images; ( Image = *Link ) != NULL; )
+    {
+        if ( Image->Dirty
+             && ( All || Image->Superseded
+                  || ( Now - Image->LastPacketAt >= SSDV_FLUSH_SECONDS ) ) )
+        {
+            WriteImage( Image );
+        }
+
+        if ( All || ( Now - Image->LastPacketAt >= SSDV_EXPIRE_SECONDS ) )
+        {
+            if ( !All )
+            {
+                char FileName[64];
+
+                sprintf( FileName, "/tmp/%s_%d.bin", Image->Callsign,
+                         Image->ImageNumber );
+                remove( FileName );
+            }
+
+            *Link = Image->Next;
+            FreeImage( Image );
+        }
+        else
+        {
+            Link = &Image->Next;
+        }
+    }
+
+    pthread_mutex_unlock( &ImageLock );
+}
+
+// Write the JPEG decoded so far for an image still in memory.  Returns -1
+// if we don't have it.  The JPEG is copied out under the locks and written
+// after, so the packet thread never waits for the disk.
+int
+SSDVImageWriteJPEG( const char *Callsign, int ImageNumber,
+                    const char *FileName )
+{
+    ssdv_image_t *Image;
+    const unsigned char *JPEG;
+    unsigned char *Copy;
+    char TempName[256];
+    size_t Length;
+    FILE *fp;
+    int Result;
+
+    pthread_mutex_lock( &ImageLock );
+
+    for ( Image = Images; Image; Image = Image->Next )
+    {
+        if ( ( Image->ImageNumber == ImageNumber )
+             && !strcmp( Image->Callsign, Callsign ) )
+        {
+            break;
+        }
+    }
+
+    if ( Image == NULL )
+    {
+        pthread_mutex_unlock( &ImageLock );
+        return -1;
+    }
+
+    pthread_mutex_lock( &Image->DecoderLock );
+    pthread_mutex_unlock( &ImageLock );
+
+    Copy = NULL;
+    if ( ( JPEG = SSDVDecoderJPEG( &Image->Decoder, &Length ) )
+         && ( Copy = malloc( Length ) ) )
+    {
+        memcpy( Copy, JPEG, Length );
+    }
+
+    pthread_mutex_unlock( &Image->DecoderLock );
+
+    if ( Copy == NULL )
+        return -1;
+
+    snprintf( TempName, sizeof( TempName ), "%s.tmp", FileName );
+
+    Result = -1;
+    if ( ( fp = fopen( TempName, "wb" ) ) != NULL )
+    {
+        if ( fwrite( Copy, 1, Length, fp ) == Length )
+        {
+            Result = 0;
+        }
+        fclose( fp );
+
+        if ( Result == 0 )
+        {
+            rename( TempName, FileName );
+        }
+        else
+        {
+            remove( TempName );
+        }
+    }
+
+    free( Copy );
+
+    return Result;
+}
+
+// First bit at or after From, and below Limit, that is set (Value 1) or
+// clear (Value 0); Limit if there isn't one
+static int
+FindBit( const uint64_t * Bits, int From, int Limit, int Value )
+{
+    uint64_t Word;
+    int Index;
+
+    if ( From >= Limit )
+        return Limit;
+
+    Index = From / 64;
+    Word = ( Value ? Bits[Index] : ~Bits[Index] ) & ( ~0ULL << ( From % 64 ) );
+    while ( Word == 0 )
+    {
+        if ( ++Index * 64 >= Limit )
+            return Limit;
+        Word = Value ? Bits[Index] : ~Bits[Index];
+    }
+
+    From = Index * 64 + __builtin_ctzll( Word );
+
+    return From < Limit ? From : Limit;
+}
+
+// Next run of missing packets, First to Last, starting at or after From
+// and before the highest packet we have.  Returns 0 if there are no more.
+static int
+NextMissingRun( const ssdv_image_t * Image, int From, int *First, int *Last )
+{
+    *First = FindBit( Image->Received, From, Image->HighestPacket, 0 );
+    if ( *First >= Image->HighestPacket )
+        return 0;
+
+    *Last = FindBit( Image->Received, *First, Image->HighestPacket, 1 ) - 1;
+
+    return 1;
+}
+
+// The payload's latest two images, oldest first.  Returns how many.
+static int
+LatestImages( const char *Callsign, ssdv_image_t ** Latest )
+{
+    ssdv_image_t *Image;
+    int Count;
+
+    // Newest images are at the front
+    Count = 0;
+    for ( Image = Images; Image && ( Count < 2 ); Image = Image->Next )
+    {
+        if ( !strcmp( Image->Callsign, Callsign ) )
+        {
+            Latest[Count++] = Image;
+        }
+    }
+
+    if ( Count == 2 )
+    {
+        Image = Latest[0];
+        Latest[0] = Latest[1];
+        Latest[1] = Image;
+    }
+
+    return Count;
+}
+
+static int
+HasMissingPackets( const ssdv_image_t * Image )
+{
+    return Image->PacketCount < Image->HighestPacket + 1;
+}
+
+// Append Text to Message if there's room for it and the "\n"
+static int
+Append( char *Message, int *Length, int Size, const char *Text )
+{
+    int TextLength = strlen( Text );
+
+    if ( *Length + TextLength + 2 > Size )
+        return 0;
+
+    memcpy( Message + *Length, Text, TextLength + 1 );
+    *Length += TextLength;
+
+    return 1;
+}
+
+static int
+AddRange( char *Message, int *Length, int Size, int First, int Last,
+          int *Ranges )
+{
+    char Text[32];
+
+    if ( First == Last )
+        sprintf( Text, "%s%d", *Ranges ? "," : "", First );
+    else
+        sprintf( Text, "%s%d-%d", *Ranges ? "," : "", First, Last );
+
+    if ( !Append( Message, Length, Size, Text ) )
+        return 0;
+
+    ( *Ranges )++;
+
+    return 1;
+}
+
+// Add "image:last=ranges" for the packets missing from Image, as many
+// ranges as fit.  Returns 0 if none did.
+static int
+AddMissingPackets( const ssdv_image_t * Image, char *Message, int *Length,
+                   int Size )
+{
+    char Text[32];
+    int Start, Ranges, First, Last;
+
+    Start = *Length;
+    sprintf( Text, "%s%d:%d=", Start > 1 ? "," : "", Image->ImageNumber,
+             Image->HighestPacket );
+    if ( !Append( Message, Length, Size, Text ) )
+        return 0;
+
+    Ranges = 0;
+    Last = -1;
+    while ( NextMissingRun( Image, Last + 1, &First, &Last )
+            && AddRange( Message, Length, Size, First, Last, &Ranges ) )
+    {
+    }
+
+    if ( Ranges == 0 )
+    {
+        *Length = Start;
+        Message[Start] = '\0';
+    }
+
+    return Ranges;
+}
+
+// Build the uplink message asking Callsign to resend what we're missing
+// from its latest two images, in the form the trackers expect:
+// "!image:last=ranges,image:last=ranges\n", with ranges such as "3,7-9".
+// Returns its length, or 0 if nothing is missing.
+int
+SSDVImageResendRequest( const char *Callsign, char *Message, int Size )
+{
+    ssdv_image_t *Latest[2];
+    int Count, Length, i;
+
+    pthread_mutex_lock( &ImageLock );
+
+    Count = LatestImages( Callsign, Latest );
+
+    Length = 0;
+    Append( Message, &Length, Size, "!" );
+    for ( i = 0; i < Count; i++ )
+    {
+        if ( HasMissingPackets( Latest[i] ) )
+        {
+            AddMissingPackets( Latest[i], Message, &Length, Size );
+        }
+    }
+
+    pthread_mutex_unlock( &ImageLock );
+
+    if ( Length <= 1 )
+        return 0;
+
+    // Append() always leaves room for this
+    Message[Length++] = '\n';
+    Message[Length] = '\0';
+
+    return Length;
+}
+
+// 7 bits per byte, low first, top bit set on all but the last.  Returns
+// the number of bytes, or 0 if there isn't room.
+static int
+PutVarint( unsigned char *Data, int Size, unsigned int Value )
+{
+    int Length = 0;
+
+    do
+    {
+        if ( Length >= Size )
+            return 0;
+        Data[Length++] = ( Value & 0x7F ) | ( Value > 0x7F ? 0x80 : 0 );
+        Value >>= 7;
+    }
+    while ( Value );
+
+    return Length;
+}
+
+// Runs body: for each run, varint packets skipped since the end of the
+// previous one (from packet 0 for the first), then varint run length - 1.
+// Returns its length; *Packets is set to how many missing packets fitted.
+static int
+EncodeRuns( const ssdv_image_t * Image, unsigned char *Body, int Size,
+            int *Packets )
+{
+    unsigned char Run[10];
+    int Length, Bytes, Next, First, Last;
+
+    Length = 0;
+    *Packets = 0;
+    Next = 0;
+    Last = -1;
+    while ( NextMissingRun( Image, Last + 1, &First, &Last ) )
+    {
+        Bytes = PutVarint( Run, 5, First - Next );
+        Bytes += PutVarint( Run + Bytes, 5, Last - First );
+        if ( Length + Bytes > Size )
+            break;
+
+        memcpy( Body + Length, Run, Bytes );
+        Length += Bytes;
+        *Packets += Last - First + 1;
+        Next = Last + 1;
+    }
+
+    return Length;
+}
+
+// Bitmap body: varint first missing packet, then a bit per packet from
+// there (LSB first, 1 = missing) up to the last missing packet that fits
+static int
+EncodeBitmap( const ssdv_image_t * Image, unsigned char *Body, int Size,
+              int *Packets )
+{
+    int Length, Start, First, Last, End, i;
+
+    *Packets = 0;
+    if ( !NextMissingRun( Image, 0, &Start, &Last )
+         || ( ( Length = PutVarint( Body, Size, Start ) ) == 0 ) )
+        return 0;
+
+    memset( Body + Length, 0, Size - Length );
+
+    End = Start;
+    Last = -1;
+    while ( NextMissingRun( Image, Last + 1, &First, &Last ) )
+    {
+        if ( Length + ( Last - Start ) / 8 >= Size )
+        {
+            // Only part of this run fits
+            Last = Start + ( Size - Length ) * 8 - 1;
+            if ( Last < First )
+                break;
+        }
+
+        for ( i = First; i <= Last; i++ )
+        {
+            Body[Length + ( i - Start ) / 8] |= 1 << ( ( i - Start ) % 8 );
+        }
+        *Packets += Last - First + 1;
+        End = Last;
+    }
+
+    return Length + ( End - Start ) / 8 + 1;
+}
+
+// Compact binary version of SSDVImageResendRequest(), for trackers that
+// understand it.  The frame is:
+//
+//   0xE5, length of the rest (bytes), then per image:
+//   image number, highest packet (2 bytes, big-endian),
+//   encoding (0 = runs, 1 = bitmap), body length, body
+//
+// Each image uses whichever encoding requests more packets, or the
+// shorter one if they're equal.  Returns the frame length, or 0 if
+// nothing is missing.
+int
+SSDVImageBinaryResendRequest( const char *Callsign, unsigned char *Message,
+                              int Size )
+{
+    unsigned char Runs[256], Bitmap[256];
+    ssdv_image_t *Latest[2];
+    int Count, Length, Room, RunsLength, BitmapLength, RunsPackets,
+        BitmapPackets, i;
+
+    pthread_mutex_lock( &ImageLock );
+
+    Count = LatestImages( Callsign, Latest );
+
+    Length = 2;
+    for ( i = 0; i < Count; i++ )
+    {
+        if ( !HasMissingPackets( Latest[i] ) )
+            continue;
+
+        Room = Size - Length - 5;
+        if ( Room > 255 )
+            Room = 255;
+        if ( Room <= 0 )
+            break;
+
+        RunsLength = EncodeRuns( Latest[i], Runs, Room, &RunsPackets );
+        BitmapLength = EncodeBitmap( Latest[i], Bitmap, Room, &BitmapPackets );
+        if ( ( RunsPackets == 0 ) && ( BitmapPackets == 0 ) )
+            break;
+
+        Message[Length++] = Latest[i]->ImageNumber;
+        Message[Length++] = Latest[i]->HighestPacket >> 8;
+        Message[Length++] = Latest[i]->HighestPacket & 0xFF;
+
+        if ( ( BitmapPackets > RunsPackets )
+             || ( ( BitmapPackets == RunsPackets )
+                  && ( BitmapLength < RunsLength ) ) )
+        {
+            Message[Length++] = 1;
+            Message[Length++] = BitmapLength;
+            memcpy( Message + Length, Bitmap, BitmapLength );
+            Length += BitmapLength;
+        }
+        else
+        {
+            Message[Length++] = 0;
+            Message[Length++] = RunsLength;
+            memcpy( Message + Length, Runs, RunsLength );
+            Length += RunsLength;
+        }
+    }
+
+    pthread_mutex_unlock( &ImageLock );
+
+    if ( Length <= 2 )
+        return 0;
+
+    Message[0] = SSDV_BINARY_RESEND;
+    Message[1] = Length - 2;
+
+    return Length;
+}
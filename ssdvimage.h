@@ -0,0 +1,37 @@
+#ifndef _H_SSDVImage
+#define _H_SSDVImage
+
+#include <time.h>
+
+// SSDV image assembler.  Packets are collected in memory per callsign and
+// image number, with a bitset of which have arrived, and each image is
+// written to /tmp/<callsign>_<image>.bin in one go: as soon as it's
+// complete (every packet up to the one flagged EOI), or once no more
+// packets have arrived for it for a while.  Images stay in memory for a
+// few minutes after that in case missing packets are resent; the gateway
+// asks for those itself, from the same bitsets.  Each image
+// is also decoded to JPEG as its packets arrive (see ssdvdec.h), and
+// queued for conversion (ftp.h).
+
+#define SSDV_FLUSH_SECONDS      10      // Write an incomplete image after this long idle
+#define SSDV_EXPIRE_SECONDS     300     // Then forget it and delete its file
+
+#define SSDV_BINARY_RESEND      0xE5    // First byte of a binary resend request
+
+typedef enum {
+    SSDV_PACKET_NEW_IMAGE,      // First packet of an image
+    SSDV_PACKET_NEW,
+    SSDV_PACKET_REPEAT          // Already had it
+} ssdv_packet_status_t;
+
+ssdv_packet_status_t SSDVImageAddPacket( const char *Callsign,
+                                         const unsigned char *Packet,
+                                         time_t Now );
+void SSDVImageFlush( time_t Now, int All );
+int SSDVImageWriteJPEG( const char *Callsign, int ImageNumber,
+                        const char *FileName );
+int SSDVImageResendRequest( const char *Callsign, char *Message, int Size );
+int SSDVImageBinaryResendRequest( const char *Callsign,
+                                  unsigned char *Message, int Size );
+
+#endif
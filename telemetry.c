@@ -0,0 +1,319 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "telemetry.h"
+
+typedef enum {
+    FIELD_STRING,
+    FIELD_TIME,
+    FIELD_UNSIGNED,
+    FIELD_INT,
+    FIELD_FLOAT,
+    FIELD_DOUBLE
+} field_type_t;
+
+typedef struct {
+    field_type_t Type;
+    size_t Offset;
+    size_t Size;                // FIELD_STRING/FIELD_TIME: buffer size
+} telemetry_column_t;
+
+#define COLUMN( Type, Field ) \
+    { Type, offsetof( telemetry_values_t, Field ), \
+      sizeof( ( ( telemetry_values_t * ) 0 )->Field ) }
+
+// In sentence order, starting with the payload ID after the "$$"
+static const telemetry_column_t ColumnTable[TELEMETRY_DEV_FIELDS] = {
+    COLUMN( FIELD_STRING, Payload ),
+    COLUMN( FIELD_UNSIGNED, Counter ),
+    COLUMN( FIELD_TIME, Time ),
+    COLUMN( FIELD_DOUBLE, Latitude ),
+    COLUMN( FIELD_DOUBLE, Longitude ),
+    COLUMN( FIELD_UNSIGNED, Altitude ),
+    COLUMN( FIELD_INT, Speed ),
+    COLUMN( FIELD_INT, Heading ),
+    COLUMN( FIELD_INT, Satellites ),
+    COLUMN( FIELD_FLOAT, TempInt ),
+    COLUMN( FIELD_FLOAT, TempExt ),
+    COLUMN( FIELD_DOUBLE, cda ),
+    COLUMN( FIELD_DOUBLE, PredictedLatitude ),
+    COLUMN( FIELD_DOUBLE, PredictedLongitude ),
+    COLUMN( FIELD_DOUBLE, PredictedLandingSpeed ),
+    COLUMN( FIELD_INT, PredictedTime ),
+    COLUMN( FIELD_INT, CompassActual ),
+    COLUMN( FIELD_INT, CompassTarget ),
+    COLUMN( FIELD_DOUBLE, AirSpeed ),
+    COLUMN( FIELD_INT, AirDirection ),
+    COLUMN( FIELD_INT, ServoLeft ),
+    COLUMN( FIELD_INT, ServoRight ),
+    COLUMN( FIELD_INT, ServoTime ),
+    COLUMN( FIELD_DOUBLE, GlideRatio ),
+    COLUMN( FIELD_INT, FlightMode )
+};
+
+static const double Pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+    1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18
+};
+
+// Split a sentence into fields at the commas, stopping at the '*' before
+// the checksum or the end of the line.  A leading "$$" is skipped.
+// Returns the number of fields.
+int
+TelemetrySplit( const char *Sentence, telemetry_field_t * Fields,
+                int MaxFields )
+{
+    const char *p;
+    int Count;
+
+    p = Sentence;
+    while ( *p == '$' )
+    {
+        p++;
+    }
+
+    Count = 0;
+    Fields[0].Start = p;
+    for ( ;; p++ )
+    {
+        if ( ( *p == ',' ) || ( *p == '*' ) || ( *p == '\0' )
+             || ( *p == '\n' ) || ( *p == '\r' ) )
+        {
+            Fields[Count].Length = p - Fields[Count].Start;
+            Count++;
+
+            if ( ( *p != ',' ) || ( Count >= MaxFields ) )
+            {
+                return Count;
+            }
+
+            Fields[Count].Start = p + 1;
+        }
+    }
+}
+
+// Find a field by counting back from the '*' (or the end of the line), 1
+// being the last field.  Unlike TelemetrySplit there is no limit on the
+// number of fields.  Returns 0 if the sentence doesn't have that many.
+int
+TelemetryFieldFromEnd( const char *Sentence, int Index,
+                       telemetry_field_t * Field )
+{
+    const char *Start, *End, *p;
+
+    Start = Sentence;
+    while ( *Start == '$' )
+    {
+        Start++;
+    }
+    End = Start + strcspn( Start, "*\r\n" );
+
+    for ( ;; )
+    {
+        p = End;
+        while ( ( p > Start ) && ( p[-1] != ',' ) )
+        {
+            p--;
+        }
+
+        if ( --Index <= 0 )
+        {
+            Field->Start = p;
+            Field->Length = End - p;
+            return 1;
+        }
+
+        if ( p == Start )
+        {
+            return 0;
+        }
+
+        End = p - 1;
+    }
+}
+
+// Integer part of a field, with optional sign.  Parsing stops at the first
+// character that isn't a digit, so "12.5" gives 12.
+static long
+ParseInteger( const telemetry_field_t * Field )
+{
+    const char *p, *End;
+    unsigned long Value;
+    int Negative;
+
+    p = Field->Start;
+    End = p + Field->Length;
+    Negative = 0;
+    Value = 0;
+
+    if ( ( p < End ) && ( ( *p == '-' ) || ( *p == '+' ) ) )
+    {
+        Negative = *p++ == '-';
+    }
+
+    while ( ( p < End ) && ( *p >= '0' ) && ( *p <= '9' ) )
+    {
+        Value = Value * 10 + ( *p++ - '0' );
+    }
+
+    return Negative ? -( long ) Value : ( long ) Value;
+}
+
+// Fixed-point decimal such as -1.23456.  The digits are collected into an
+// integer and scaled once, which is exact for anything a tracker sends.
+static double
+ParseDecimal( const telemetry_field_t * Field )
+{
+    const char *p, *End;
+    unsigned long long Mantissa;
+    int Negative, Digits, Places, Point;
+
+    p = Field->Start;
+    End = p + Field->Length;
+    Negative = 0;
+    Mantissa = 0;
+    Digits = 0;
+    Places = 0;
+    Point = 0;
+
+    if ( ( p < End ) && ( ( *p == '-' ) || ( *p == '+' ) ) )
+    {
+        Negative = *p++ == '-';
+    }
+
+    for ( ; p < End; p++ )
+    {
+        if ( ( *p >= '0' ) && ( *p <= '9' ) )
+        {
+            // Beyond 18 digits just drop the rest of the fraction
+            if ( Digits < 18 )
+            {
+                Mantissa = Mantissa * 10 + ( *p - '0' );
+                Digits++;
+                Places += Point;
+            }
+            else if ( !Point )
+            {
+                Mantissa *= 10;
+            }
+        }
+        else if ( ( *p == '.' ) && !Point )
+        {
+            Point = 1;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return ( Negative ? -( double ) Mantissa : ( double ) Mantissa ) /
+        Pow10[Places];
+}
+
+// HH:MM:SS or HHMMSS to seconds since midnight
+static long
+ParseTime( const telemetry_field_t * Field )
+{
+    const char *p, *End;
+    long Seconds;
+    int Parts, Digits, Value;
+
+    p = Field->Start;
+    End = p + Field->Length;
+    Seconds = 0;
+    Parts = 0;
+    Digits = 0;
+    Value = 0;
+
+    for ( ; ( p < End ) && ( Parts < 3 ); p++ )
+    {
+        if ( ( *p >= '0' ) && ( *p <= '9' ) )
+        {
+            Value = Value * 10 + ( *p - '0' );
+            if ( ++Digits == 2 )
+            {
+                Seconds = Seconds * 60 + Value;
+                Parts++;
+                Digits = 0;
+                Value = 0;
+            }
+        }
+        else if ( ( *p != ':' ) || Digits )
+        {
+            break;
+        }
+    }
+
+    return ( Parts == 3 ) ? Seconds : -1;
+}
+
+static void
+CopyField( char *Target, size_t Size, const telemetry_field_t * Field )
+{
+    size_t Length;
+
+    Length = Field->Length < Size ? Field->Length : Size - 1;
+    memcpy( Target, Field->Start, Length );
+    Target[Length] = '\0';
+}
+
+// Split Sentence and convert up to MaxColumns of the standard fields into
+// Record.  Fields missing from the sentence are left as 0 (FlightMode -1).
+// Returns the number of fields converted.
+int
+TelemetryParse( const char *Sentence, telemetry_record_t * Record,
+                int MaxColumns )
+{
+    int Column, Columns;
+
+    memset( Record, 0, sizeof( *Record ) );
+    Record->Values.Seconds = -1;
+    Record->Values.FlightMode = -1;
+
+    Record->FieldCount =
+        TelemetrySplit( Sentence, Record->Fields, TELEMETRY_MAX_FIELDS );
+
+    Columns = Record->FieldCount < MaxColumns ? Record->FieldCount : MaxColumns;
+    if ( Columns > TELEMETRY_DEV_FIELDS )
+    {
+        Columns = TELEMETRY_DEV_FIELDS;
+    }
+
+    for ( Column = 0; Column < Columns; Column++ )
+    {
+        const telemetry_field_t *Field = &Record->Fields[Column];
+        char *Target = ( char * ) &Record->Values + ColumnTable[Column].Offset;
+
+        switch ( ColumnTable[Column].Type )
+        {
+            case FIELD_STRING:
+                CopyField( Target, ColumnTable[Column].Size, Field );
+                break;
+
+            case FIELD_TIME:
+                // HH:MM:SS at most, as before
+                CopyField( Target, 9, Field );
+                Record->Values.Seconds = ParseTime( Field );
+                break;
+
+            case FIELD_UNSIGNED:
+                *( unsigned int * ) Target = ( unsigned int ) ParseInteger( Field );
+                break;
+
+            case FIELD_INT:
+                *( int * ) Target = ( int ) ParseInteger( Field );
+                break;
+
+            case FIELD_FLOAT:
+                *( float * ) Target = ( float ) ParseDecimal( Field );
+                break;
+
+            case FIELD_DOUBLE:
+                *( double * ) Target = ParseDecimal( Field );
+                break;
+        }
+    }
+
+    return Columns;
+}
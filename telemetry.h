@@ -0,0 +1,56 @@
+#ifndef _H_Telemetry
+#define _H_Telemetry
+
+// Telemetry sentence parser.
+//
+// A sentence ($$PAYLOAD,counter,time,lat,lon,alt,...*CRC) is split once,
+// in a single pass, into views of its fields - no copying, and the
+// sentence itself is left untouched.  The standard fields are then
+// converted into a telemetry_record_t by walking a table of field types
+// and offsets, so every consumer works from the same record.
+
+#define TELEMETRY_MAX_FIELDS    32
+
+// Number of fields converted in normal and EnableDev modes
+#define TELEMETRY_BASIC_FIELDS  6
+#define TELEMETRY_DEV_FIELDS    25
+
+typedef struct {
+    const char *Start;
+    int Length;
+} telemetry_field_t;
+
+// The standard fields, converted
+typedef struct {
+    char Payload[16];
+    unsigned int Counter;
+    char Time[12];
+    long Seconds;               // Time as seconds since midnight, or -1
+    double Latitude, Longitude;
+    unsigned int Altitude;
+
+    // Extra fields sent by the development trackers
+    int Speed, Heading, Satellites;
+    float TempInt, TempExt;
+    double cda, PredictedLatitude, PredictedLongitude, PredictedLandingSpeed;
+    int PredictedTime, CompassActual, CompassTarget;
+    double AirSpeed;
+    int AirDirection, ServoLeft, ServoRight, ServoTime;
+    double GlideRatio;
+    int FlightMode;
+} telemetry_values_t;
+
+typedef struct {
+    int FieldCount;
+    telemetry_field_t Fields[TELEMETRY_MAX_FIELDS];
+    telemetry_values_t Values;
+} telemetry_record_t;
+
+int TelemetrySplit( const char *Sentence, telemetry_field_t * Fields,
+                    int MaxFields );
+int TelemetryFieldFromEnd( const char *Sentence, int Index,
+                           telemetry_field_t * Field );
+int TelemetryParse( const char *Sentence, telemetry_record_t * Record,
+                    int MaxColumns );
+
+#endif
@@ -0,0 +1,107 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../base64.h"
+#include "test.h"
+
+// Each base64 encoder this CPU can run, on an SSDV packet and on a
+// telemetry-sized string, against the original table loop
+
+static const char encoding_table[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// The loop base64_encode() had before the block encoders
+static char *
+OriginalEncode( const char *data, size_t input_length,
+                size_t * output_length, char *encoded_data )
+{
+    static const int mod_table[] = { 0, 2, 1 };
+    size_t i, j;
+
+    *output_length = 4 * ( ( input_length + 2 ) / 3 );
+
+    for ( i = 0, j = 0; i < input_length; )
+    {
+        uint32_t octet_a = i < input_length ? ( unsigned char ) data[i++] : 0;
+        uint32_t octet_b = i < input_length ? ( unsigned char ) data[i++] : 0;
+        uint32_t octet_c = i < input_length ? ( unsigned char ) data[i++] : 0;
+
+        uint32_t triple = ( octet_a << 0x10 ) + ( octet_b << 0x08 ) + octet_c;
+
+        encoded_data[j++] = encoding_table[( triple >> 3 * 6 ) & 0x3F];
+        encoded_data[j++] = encoding_table[( triple >> 2 * 6 ) & 0x3F];
+        encoded_data[j++] = encoding_table[( triple >> 1 * 6 ) & 0x3F];
+        encoded_data[j++] = encoding_table[( triple >> 0 * 6 ) & 0x3F];
+    }
+
+    for ( i = 0; i < mod_table[input_length % 3]; i++ )
+        encoded_data[*output_length - 1 - i] = '=';
+
+    return encoded_data;
+}
+
+static double
+Time( char *( *Encode ) ( const char *, size_t, size_t *, char * ),
+      const char *Data, size_t Length )
+{
+    static char Encoded[1024];
+    size_t EncodedLength;
+    double Start, Seconds;
+    int i, Runs;
+
+    Runs = 0;
+    Start = TestSeconds(  );
+    do
+    {
+        for ( i = 0; i < 1000; i++ )
+        {
+            Encode( Data, Length, &EncodedLength, Encoded );
+            __asm__ volatile ( "":::"memory" );
+        }
+        Runs += 1000;
+        Seconds = TestSeconds(  ) - Start;
+    }
+    while ( Seconds < 0.2 );
+
+    return Seconds * 1e9 / Runs;
+}
+
+int
+main( void )
+{
+    static const char *Encoders[] = { "plain", "scalar", "vector", "ssse3",
+        "avx2"
+    };
+    static const size_t Lengths[] = { 256, 100 };
+    char Data[256];
+    int i, n;
+
+    for ( i = 0; i < sizeof( Data ); i++ )
+    {
+        Data[i] = rand(  );
+    }
+
+    printf( "base64, ns per call\n%-10s %10s %10s\n", "encoder", "256 bytes",
+            "100 bytes" );
+    printf( "%-10s", "original" );
+    for ( n = 0; n < 2; n++ )
+    {
+        printf( " %10.1f", Time( OriginalEncode, Data, Lengths[n] ) );
+    }
+    printf( "\n" );
+
+    for ( i = 0; i < sizeof( Encoders ) / sizeof( Encoders[0] ); i++ )
+    {
+        if ( base64_select_encoder( Encoders[i] ) < 0 )
+            continue;
+
+        printf( "%-10s", Encoders[i] );
+        for ( n = 0; n < 2; n++ )
+        {
+            printf( " %10.1f", Time( base64_encode, Data, Lengths[n] ) );
+        }
+        printf( "\n" );
+    }
+
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../crc.h"
+#include "test.h"
+
+// Table-driven CRC16Update against the bit-at-a-time loop it replaced
+
+static uint16_t
+BitCRC16( const unsigned char *Data, size_t Length )
+{
+    uint16_t CRC;
+    int j;
+
+    CRC = 0xFFFF;
+    for ( ; Length > 0; Length--, Data++ )
+    {
+        CRC ^= ( ( unsigned int ) *Data ) << 8;
+        for ( j = 0; j < 8; j++ )
+        {
+            if ( CRC & 0x8000 )
+                CRC = ( CRC << 1 ) ^ 0x1021;
+            else
+                CRC <<= 1;
+        }
+    }
+
+    return CRC;
+}
+
+int
+main( void )
+{
+    static const size_t Lengths[] = { 80, 250, 4096 };
+    unsigned char Data[4096];
+    volatile uint16_t Sink;
+    double Start, Bit, Table;
+    int i, n, Count;
+
+    for ( i = 0; i < sizeof( Data ); i++ )
+    {
+        Data[i] = rand(  );
+    }
+
+    for ( n = 0; n < 3; n++ )
+    {
+        Count = 200000000 / ( Lengths[n] * 10 );
+
+        Start = TestSeconds(  );
+        for ( i = 0; i < Count; i++ )
+        {
+            Sink = BitCRC16( Data, Lengths[n] );
+        }
+        Bit = TestSeconds(  ) - Start;
+
+        Start = TestSeconds(  );
+        for ( i = 0; i < Count; i++ )
+        {
+            Sink = CRC16Update( 0xFFFF, Data, Lengths[n] );
+        }
+        Table = TestSeconds(  ) - Start;
+
+        printf( "CRC16 %4zu bytes: bit loop %7.0f ns, table %6.0f ns (%.1fx), "
+                "%.0f MB/s\n", Lengths[n], Bit / Count * 1e9,
+                Table / Count * 1e9, Bit / Table,
+                Lengths[n] * Count / Table / 1e6 );
+    }
+
+    ( void ) Sink;
+
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../base64.h"
+#include "../json.h"
+#include "test.h"
+
+// SSDV upload body, built as UploadImagePacket does now (the JSON writer)
+// and as it used to (sprintf each packet, strcat it onto the body).  Both
+// include base64-encoding each 256-byte packet.  The writer's cost per
+// packet should stay flat as the batch grows.
+
+#define MAX_PACKETS 400
+
+static unsigned char Packets[MAX_PACKETS][256];
+static char Body[MAX_PACKETS * 600];
+
+static const char *Received = "2026-10-17T12:34:56Z";
+static const char *Receiver = "M0RPI";
+
+static size_t
+BuildWithStrcat( int Count )
+{
+    char base64_data[512], packet_json[1000];
+    size_t base64_length;
+    int PacketIndex;
+
+    strcpy( Body, "{\"type\": \"packets\",\"packets\":[" );
+
+    for ( PacketIndex = 0; PacketIndex < Count; PacketIndex++ )
+    {
+        base64_encode( ( char * ) Packets[PacketIndex], 256, &base64_length,
+                       base64_data );
+        base64_data[base64_length] = '\0';
+
+        sprintf( packet_json,
+                 "{\"type\": \"packet\", \"packet\": \"%s\", \"encoding\": \"base64\", \"received\": \"%s\", \"receiver\": \"%s\"}%s",
+                 base64_data, Received, Receiver,
+                 PacketIndex == ( Count - 1 ) ? "" : "," );
+        strcat( Body, packet_json );
+    }
+
+    strcat( Body, "]}" );
+
+    return strlen( Body );
+}
+
+static size_t
+BuildWithWriter( int Count )
+{
+    char base64_data[512];
+    size_t base64_length;
+    json_writer_t Writer;
+    int PacketIndex;
+
+    JSONBegin( &Writer, Body, sizeof( Body ) );
+    JSONBeginObject( &Writer, NULL );
+    JSONString( &Writer, "type", "packets" );
+    JSONBeginArray( &Writer, "packets" );
+
+    for ( PacketIndex = 0; PacketIndex < Count; PacketIndex++ )
+    {
+        base64_encode( ( char * ) Packets[PacketIndex], 256, &base64_length,
+                       base64_data );
+
+        JSONBeginObject( &Writer, NULL );
+        JSONString( &Writer, "type", "packet" );
+        JSONStringN( &Writer, "packet", base64_data, base64_length );
+        JSONString( &Writer, "encoding", "base64" );
+        JSONString( &Writer, "received", Received );
+        JSONString( &Writer, "receiver", Receiver );
+        JSONEndObject( &Writer );
+    }
+
+    JSONEndArray( &Writer );
+    JSONEndObject( &Writer );
+
+    return JSONEnd( &Writer );
+}
+
+static double
+Time( size_t ( *Build ) ( int ), int Count )
+{
+    volatile size_t Sink;
+    double Start, Seconds;
+    int Runs;
+
+    Runs = 0;
+    Start = TestSeconds(  );
+    do
+    {
+        Sink = Build( Count );
+        Seconds = TestSeconds(  ) - Start;
+    }
+    while ( ( ++Runs < 10 ) || ( Seconds < 0.2 ) );
+    ( void ) Sink;
+
+    return Seconds / Runs;
+}
+
+int
+main( void )
+{
+    static const int Counts[] = { 10, 50, 100, 200, 400 };
+    double Old, New;
+    int i, j;
+
+    for ( i = 0; i < MAX_PACKETS; i++ )
+    {
+        for ( j = 0; j < 256; j++ )
+        {
+            Packets[i][j] = rand(  );
+        }
+    }
+
+    printf( "SSDV upload body\n%8s  %-22s %-22s\n", "packets",
+            "strcat+sprintf", "JSON writer" );
+    for ( i = 0; i < sizeof( Counts ) / sizeof( Counts[0] ); i++ )
+    {
+        Old = Time( BuildWithStrcat, Counts[i] );
+        New = Time( BuildWithWriter, Counts[i] );
+        printf( "%8d  %7.1f us (%.2f/pkt)   %7.1f us (%.2f/pkt)\n",
+                Counts[i], Old * 1e6, Old * 1e6 / Counts[i], New * 1e6,
+                New * 1e6 / Counts[i] );
+    }
+
+    return 0;
+}
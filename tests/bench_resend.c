@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "../ssdvimage.h"
+#include "resendparse.h"
+#include "test.h"
+
+// Uplink airtime of the ASCII and binary SSDV resend requests, over a few
+// modelled loss patterns on two images from the same payload.  Airtime is
+// for an explicit-mode uplink at SF8 / 62.5 kHz / 4:8 (as LoRa mode 2),
+// sent at the request's own length; before uplinks were cut to length,
+// every one was 255 bytes.
+
+#define PACKET_SIZE 256
+
+static unsigned char *Packets;
+static int PacketCount;
+static resend_image_t Asked[RESEND_MAX_IMAGES];
+static char Have[2][65536];
+
+void
+QueueImageConversion( const char *Callsign, int ImageNumber, int Final )
+{
+}
+
+// From the SX1276 datasheet, section 4.1.1.7
+static double
+Airtime( int SpreadingFactor, double Bandwidth, int CodingRate,
+         int Implicit, int LowDataRateOptimize, int Length )
+{
+    double Symbol, Payload;
+
+    Symbol = pow( 2, SpreadingFactor ) / Bandwidth;
+    Payload = ceil( ( 8.0 * Length - 4 * SpreadingFactor + 28 + 16
+                      - 20 * Implicit )
+                    / ( 4.0 * ( SpreadingFactor - 2 * LowDataRateOptimize ) ) )
+        * ( CodingRate + 4 );
+    if ( Payload < 0 )
+        Payload = 0;
+
+    return ( ( 8 + 4.25 ) + 8 + Payload ) * Symbol * 1000;
+}
+
+static double
+UplinkMilliseconds( int Length )
+{
+    return Airtime( 8, 62500, 4, 0, 0, Length );
+}
+
+typedef struct {
+    const char *Name;
+    int Packets;
+    double Loss;                // Chance of a loss starting at each packet
+    int Burst;                  // Losses are 1 packet, or 5 to 30 if set
+    int Dropouts;               // 80-packet dropouts per image
+} pattern_t;
+
+static int
+MakeLosses( const pattern_t * Pattern, char *Image )
+{
+    int i, j, Start, Missing;
+
+    memset( Image, 0, 65536 );
+    for ( i = 0; i < Pattern->Packets; )
+    {
+        if ( ( i > 0 ) && ( rand(  ) < Pattern->Loss * RAND_MAX ) )
+        {
+            i += Pattern->Burst ? 5 + rand(  ) % 26 : 1;
+        }
+        else
+        {
+            Image[i++] = 1;
+        }
+    }
+
+    for ( j = 0; j < Pattern->Dropouts; j++ )
+    {
+        Start = 100 + rand(  ) % ( Pattern->Packets - 300 );
+        memset( Image + Start, 0, 80 );
+    }
+
+    // The last packet arrives, so the whole image counts
+    Image[Pattern->Packets - 1] = 1;
+
+    Missing = 0;
+    for ( i = 0; i < Pattern->Packets; i++ )
+    {
+        Missing += !Image[i];
+    }
+
+    return Missing;
+}
+
+static void
+Send( const char *Callsign, int ImageNumber, const char *Image, int Count )
+{
+    unsigned char Packet[PACKET_SIZE];
+    int i;
+
+    for ( i = 0; i < Count; i++ )
+    {
+        if ( Image[i] )
+        {
+            memcpy( Packet, Packets + i * PACKET_SIZE, PACKET_SIZE );
+            Packet[6] = ImageNumber;
+            SSDVImageAddPacket( Callsign, Packet, time( NULL ) );
+        }
+    }
+}
+
+// Packets asked for, from what Parse...Resend() returned
+static int
+Covered( int Images )
+{
+    int i, Count;
+
+    Count = 0;
+    for ( i = 0; i < Images; i++ )
+    {
+        Count += Asked[i].Count;
+    }
+
+    return Count;
+}
+
+int
+main( void )
+{
+    static const pattern_t Patterns[] = {
+        {"3% random, 600 pkts", 600, 0.03, 0, 0},
+        {"10% random, 600 pkts", 600, 0.10, 0, 0},
+        {"fades (5-30 pkt bursts)", 600, 0.15 / 17.5, 1, 0},
+        {"2 dropouts + 2%, 1000 pkts", 1000, 0.02, 0, 2},
+        {"30% random, 1000 pkts", 1000, 0.30, 0, 0},
+    };
+    unsigned char Binary[256];
+    char Text[256], Callsign[16];
+    int TextLength, BinaryLength, Missing, Runs, t, i;
+    double Start, Seconds;
+    size_t Length;
+
+    Packets = TestReadFile( TEST_DATA "ssdv_1280x1024.bin", &Length );
+    if ( Packets == NULL )
+        return 1;
+    PacketCount = Length / PACKET_SIZE;
+
+    srand( 7 );
+
+    printf( "Uplink SF8 / 62.5 kHz / 4:8, fixed 255 bytes = %.0f ms\n\n",
+            UplinkMilliseconds( 255 ) );
+    printf( "%-28s %7s  %-20s %-20s %8s\n", "pattern", "missing",
+            "ASCII bytes/pkts/ms", "binary bytes/pkts/ms", "build" );
+
+    for ( t = 0; t < sizeof( Patterns ) / sizeof( Patterns[0] ); t++ )
+    {
+        const pattern_t *Pattern = &Patterns[t];
+
+        if ( Pattern->Packets > PacketCount )
+            continue;
+
+        // A payload of its own for each pattern
+        sprintf( Callsign, "BENCH%d", t );
+        Missing = 0;
+        for ( i = 0; i < 2; i++ )
+        {
+            Missing += MakeLosses( Pattern, Have[i] );
+            Send( Callsign, i + 1, Have[i], Pattern->Packets );
+        }
+
+        TextLength = SSDVImageResendRequest( Callsign, Text, 255 );
+        i = ParseTextResend( Text, Asked );
+        printf( "%-28s %7d  %5d / %4d / %5.0f", Pattern->Name, Missing,
+                TextLength + 1, Covered( i ),
+                UplinkMilliseconds( TextLength + 1 ) );
+
+        Runs = 0;
+        Start = TestSeconds(  );
+        do
+        {
+            BinaryLength =
+                SSDVImageBinaryResendRequest( Callsign, Binary, 255 );
+            Seconds = TestSeconds(  ) - Start;
+        }
+        while ( ( ++Runs < 1000 ) || ( Seconds < 0.1 ) );
+
+        i = ParseBinaryResend( Binary, BinaryLength, Asked );
+        printf( "   %5d / %4d / %5.0f %6.1f us\n", BinaryLength,
+                Covered( i ), UplinkMilliseconds( BinaryLength ),
+                Seconds * 1e6 / Runs );
+    }
+
+    free( Packets );
+
+    return 0;
+}
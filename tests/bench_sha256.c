@@ -0,0 +1,192 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../sha256.h"
+#include "test.h"
+
+// SHA-256 of a habitat-sized upload and of a large buffer, with each
+// transform this CPU can run and with the code the gateway had before
+// (one block at a time, fed a byte at a time)
+
+#define ROTRIGHT(a,b) (((a) >> (b)) | ((a) << (32-(b))))
+#define CH(x,y,z) (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x,y,z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define EP0(x) (ROTRIGHT(x,2) ^ ROTRIGHT(x,13) ^ ROTRIGHT(x,22))
+#define EP1(x) (ROTRIGHT(x,6) ^ ROTRIGHT(x,11) ^ ROTRIGHT(x,25))
+#define SIG0(x) (ROTRIGHT(x,7) ^ ROTRIGHT(x,18) ^ ((x) >> 3))
+#define SIG1(x) (ROTRIGHT(x,17) ^ ROTRIGHT(x,19) ^ ((x) >> 10))
+
+static uint32_t k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static void
+OriginalTransform( uint32_t state[], const uint8_t data[] )
+{
+    uint32_t a, b, c, d, e, f, g, h, i, j, t1, t2, m[64];
+
+    for ( i = 0, j = 0; i < 16; ++i, j += 4 )
+        m[i] =
+            ( data[j] << 24 ) | ( data[j + 1] << 16 ) | ( data[j + 2] << 8 ) |
+            ( data[j + 3] );
+    for ( ; i < 64; ++i )
+        m[i] = SIG1( m[i - 2] ) + m[i - 7] + SIG0( m[i - 15] ) + m[i - 16];
+
+    a = state[0];
+    b = state[1];
+    c = state[2];
+    d = state[3];
+    e = state[4];
+    f = state[5];
+    g = state[6];
+    h = state[7];
+
+    for ( i = 0; i < 64; ++i )
+    {
+        t1 = h + EP1( e ) + CH( e, f, g ) + k[i] + m[i];
+        t2 = EP0( a ) + MAJ( a, b, c );
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+// The old sha256_update(), then the padding as sha256_final() does it
+static void
+OriginalHash( const char *Data, size_t Length, uint8_t Hash[] )
+{
+    uint32_t State[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    uint8_t Block[64];
+    size_t i, n;
+
+    for ( i = 0, n = 0; i < Length; ++i )
+    {
+        Block[n++] = Data[i];
+        if ( n == 64 )
+        {
+            OriginalTransform( State, Block );
+            n = 0;
+        }
+    }
+
+    Block[n++] = 0x80;
+    if ( n > 56 )
+    {
+        memset( Block + n, 0, 64 - n );
+        OriginalTransform( State, Block );
+        n = 0;
+    }
+    memset( Block + n, 0, 56 - n );
+    for ( i = 0; i < 8; i++ )
+    {
+        Block[63 - i] = ( uint64_t ) Length * 8 >> ( i * 8 );
+    }
+    OriginalTransform( State, Block );
+
+    for ( i = 0; i < 32; i++ )
+    {
+        Hash[i] = State[i / 4] >> ( 24 - ( i % 4 ) * 8 );
+    }
+}
+
+static void
+CurrentHash( const char *Data, size_t Length, uint8_t Hash[] )
+{
+    SHA256_CTX ctx;
+
+    sha256_init( &ctx );
+    sha256_update( &ctx, ( char * ) Data, Length );
+    sha256_final( &ctx, Hash );
+}
+
+static double
+Time( void ( *Hash ) ( const char *, size_t, uint8_t[] ), const char *Data,
+      size_t Length )
+{
+    uint8_t Digest[32];
+    double Start, Seconds;
+    int Runs;
+
+    Runs = 0;
+    Start = TestSeconds(  );
+    do
+    {
+        Hash( Data, Length, Digest );
+        __asm__ volatile ( "":::"memory" );
+        Seconds = TestSeconds(  ) - Start;
+    }
+    while ( ( ++Runs < 10 ) || ( Seconds < 0.2 ) );
+
+    return Seconds / Runs;
+}
+
+int
+main( void )
+{
+    static const char *Transforms[] = { "portable", "shani", "armv8" };
+    static char Data[65536];
+    uint8_t Expected[32], Actual[32];
+    double Small, Large;
+    int i;
+
+    for ( i = 0; i < sizeof( Data ); i++ )
+    {
+        Data[i] = rand(  );
+    }
+
+    // 344 bytes is a base64'd telemetry sentence, as habitat.c hashes
+    printf( "SHA-256\n%-10s %14s %14s\n", "", "344 bytes", "64 KB" );
+
+    Small = Time( OriginalHash, Data, 344 );
+    Large = Time( OriginalHash, Data, sizeof( Data ) );
+    printf( "%-10s %11.0f ns %9.0f MB/s\n", "original", Small * 1e9,
+            sizeof( Data ) / Large / 1e6 );
+
+    for ( i = 0; i < sizeof( Transforms ) / sizeof( Transforms[0] ); i++ )
+    {
+        if ( sha256_select_transform( Transforms[i] ) < 0 )
+            continue;
+
+        OriginalHash( Data, sizeof( Data ), Expected );
+        CurrentHash( Data, sizeof( Data ), Actual );
+        if ( memcmp( Expected, Actual, sizeof( Expected ) ) )
+        {
+            printf( "%s: wrong hash\n", Transforms[i] );
+            return 1;
+        }
+
+        Small = Time( CurrentHash, Data, 344 );
+        Large = Time( CurrentHash, Data, sizeof( Data ) );
+        printf( "%-10s %11.0f ns %9.0f MB/s\n", Transforms[i], Small * 1e9,
+                sizeof( Data ) / Large / 1e6 );
+    }
+
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../ssdvdec.h"
+#include "test.h"
+
+// The built-in decoder against running the external ssdv program, as
+// ConvertFile did, on images of about 200 and 1000 packets.  ssdv is
+// used if it's in the PATH; "sh -c true" shows the cost of the fork and
+// exec alone.
+
+#define PACKET_SIZE 256
+
+static const char *Images[] = {
+    TEST_DATA "ssdv_640x480.bin",
+    TEST_DATA "ssdv_1280x1024.bin"
+};
+
+static double
+TimeCommand( const char *Command, int Runs )
+{
+    double Start;
+    int i;
+
+    Start = TestSeconds(  );
+    for ( i = 0; i < Runs; i++ )
+    {
+        if ( system( Command ) != 0 )
+            return -1;
+    }
+
+    return ( TestSeconds(  ) - Start ) / Runs;
+}
+
+int
+main( void )
+{
+    const char *JPEGFile = "tests/bench_ssdvdec.jpg";
+    char Command[300];
+    unsigned char *Packets;
+    ssdv_decoder_t Decoder;
+    const unsigned char *JPEG;
+    size_t Length, Count;
+    double Start, Seconds;
+    int Image, Runs, i, j, HaveSSDV;
+
+    HaveSSDV = system( "command -v ssdv > /dev/null 2>&1" ) == 0;
+
+    printf( "fork+exec alone (sh -c true): %.2f ms\n",
+            TimeCommand( "true", 50 ) * 1e3 );
+
+    for ( Image = 0; Image < 2; Image++ )
+    {
+        if ( ( Packets = TestReadFile( Images[Image], &Length ) ) == NULL )
+            return 1;
+        Count = Length / PACKET_SIZE;
+        Runs = 20000 / Count;
+
+        printf( "%s, %zu packets:\n", Images[Image], Count );
+
+        // Whole file to JPEG file, the same job as "ssdv -d"
+        Start = TestSeconds(  );
+        for ( i = 0; i < Runs; i++ )
+        {
+            SSDVDecodeFile( Images[Image], JPEGFile );
+        }
+        printf( "  built-in, whole file:     %8.2f ms\n",
+                ( TestSeconds(  ) - Start ) / Runs * 1e3 );
+
+        if ( HaveSSDV )
+        {
+            snprintf( Command, sizeof( Command ),
+                      "ssdv -d %s %s > /dev/null 2>&1", Images[Image],
+                      JPEGFile );
+            Seconds = TimeCommand( Command, 10 );
+            printf( "  ssdv -d, whole file:      %8.2f ms\n", Seconds * 1e3 );
+        }
+        else
+        {
+            printf( "  ssdv -d:                  not in PATH, skipped\n" );
+        }
+
+        // What the gateway does now: each packet decoded as it arrives,
+        // with a complete JPEG available after every one
+        Start = TestSeconds(  );
+        for ( i = 0; i < Runs; i++ )
+        {
+            memset( &Decoder, 0, sizeof( Decoder ) );
+            for ( j = 0; j < Count; j++ )
+            {
+                SSDVDecoderFeed( &Decoder, Packets + j * PACKET_SIZE );
+                JPEG = SSDVDecoderJPEG( &Decoder, &Length );
+            }
+            SSDVDecoderFree( &Decoder );
+        }
+        Seconds = ( TestSeconds(  ) - Start ) / Runs;
+        printf( "  built-in, incremental:    %8.2f ms per image, "
+                "%.1f us per packet incl. JPEG\n", Seconds * 1e3,
+                Seconds / Count * 1e6 );
+
+        ( void ) JPEG;
+        free( Packets );
+    }
+
+    remove( JPEGFile );
+
+    return 0;
+}
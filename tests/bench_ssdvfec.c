@@ -0,0 +1,91 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../ssdvfec.h"
+#include "test.h"
+
+// SSDVPacketRepair on real 0x66 packets, clean and with 1 to 16 bad bytes
+
+#define PACKET_SIZE 256
+#define CODEWORD    255         // Packet[1] to Packet[255]
+
+// Damage Errors distinct bytes of the codeword, other than the packet
+// type.  Returns 1 if any of them are covered by the CRC.
+static int
+Damage( unsigned char *Packet, int Errors )
+{
+    char Hit[PACKET_SIZE];
+    int i, Position, InData;
+
+    memset( Hit, 0, sizeof( Hit ) );
+    InData = 0;
+    for ( i = 0; i < Errors; i++ )
+    {
+        do
+        {
+            Position = 2 + rand(  ) % ( CODEWORD - 1 );
+        }
+        while ( Hit[Position] );
+
+        Hit[Position] = 1;
+        Packet[Position] ^= 1 + rand(  ) % 255;
+        InData |= Position <= 223;
+    }
+
+    return InData;
+}
+
+int
+main( void )
+{
+    static const int ErrorCounts[] = { 0, 1, 4, 8, 16 };
+    unsigned char *Packets, *Damaged, Packet[PACKET_SIZE];
+    size_t Length;
+    double Start;
+    int n, i, Runs, Count, PacketCount;
+
+    if ( ( Packets = TestReadFile( TEST_DATA "ssdv_640x480.bin",
+                                   &Length ) ) == NULL )
+        return 1;
+    PacketCount = Length / PACKET_SIZE;
+
+    // Damage first, so only the repair is timed
+    srand( 1 );
+    Count = PacketCount * 8;
+    Damaged = malloc( Count * PACKET_SIZE );
+
+    for ( n = 0; n < 5; n++ )
+    {
+        for ( i = 0; i < Count; i++ )
+        {
+            unsigned char *Copy = Damaged + i * PACKET_SIZE;
+            const unsigned char *Good =
+                Packets + ( i % PacketCount ) * PACKET_SIZE;
+
+            // Damage only to the parity needs no repair, so try again
+            // from the good packet
+            memcpy( Copy, Good, PACKET_SIZE );
+            while ( ( ErrorCounts[n] > 0 ) && !Damage( Copy, ErrorCounts[n] ) )
+            {
+                memcpy( Copy, Good, PACKET_SIZE );
+            }
+        }
+
+        Runs = ErrorCounts[n] ? 5 : 100;
+        Start = TestSeconds(  );
+        for ( i = 0; i < Count * Runs; i++ )
+        {
+            memcpy( Packet, Damaged + ( i % Count ) * PACKET_SIZE,
+                    PACKET_SIZE );
+            SSDVPacketRepair( Packet, CODEWORD );
+        }
+        printf( "SSDVPacketRepair %2d errors: %7.2f us per packet\n",
+                ErrorCounts[n],
+                ( TestSeconds(  ) - Start ) / ( Count * Runs ) * 1e6 );
+    }
+
+    free( Damaged );
+    free( Packets );
+
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../telemetry.h"
+#include "test.h"
+
+// TelemetryParse against the sscanf calls ProcessLine used before
+
+static const char *Sentence =
+    "$$PAYLOAD,123,12:34:56,51.95023,-2.54445,12345,10,270,9,"
+    "21.5,-40.25,1.5,51.1,-2.2,5.5,300,90,91,12.5,45,1,2,3,4.5,7*5A3C\n";
+
+static telemetry_values_t Values;
+
+static void
+ScanDev( const char *Line )
+{
+    int Satellites;
+    float TempInt, TempExt;
+
+    sscanf( Line + 2,
+            "%15[^,],%u,%8[^,],%lf,%lf,%u,%d,%d,%d,%f,%f,%lf,%lf,%lf,%lf,%d,%d,%d,%lf,%d,%d,%d,%d,%lf,%d",
+            Values.Payload, &Values.Counter, Values.Time, &Values.Latitude,
+            &Values.Longitude, &Values.Altitude, &Values.Speed,
+            &Values.Heading, &Satellites, &TempInt, &TempExt, &Values.cda,
+            &Values.PredictedLatitude, &Values.PredictedLongitude,
+            &Values.PredictedLandingSpeed, &Values.PredictedTime,
+            &Values.CompassActual, &Values.CompassTarget, &Values.AirSpeed,
+            &Values.AirDirection, &Values.ServoLeft, &Values.ServoRight,
+            &Values.ServoTime, &Values.GlideRatio, &Values.FlightMode );
+}
+
+static void
+ScanBasic( const char *Line )
+{
+    sscanf( Line + 2, "%15[^,],%u,%8[^,],%lf,%lf,%u", Values.Payload,
+            &Values.Counter, Values.Time, &Values.Latitude,
+            &Values.Longitude, &Values.Altitude );
+}
+
+int
+main( void )
+{
+    telemetry_record_t Record;
+    double Start, Scan, Parse;
+    int Pass, i, Count;
+
+    Count = 1000000;
+
+    for ( Pass = 0; Pass < 2; Pass++ )
+    {
+        int Columns = Pass ? TELEMETRY_DEV_FIELDS : TELEMETRY_BASIC_FIELDS;
+
+        Start = TestSeconds(  );
+        for ( i = 0; i < Count; i++ )
+        {
+            if ( Pass )
+                ScanDev( Sentence );
+            else
+                ScanBasic( Sentence );
+        }
+        Scan = TestSeconds(  ) - Start;
+
+        Start = TestSeconds(  );
+        for ( i = 0; i < Count; i++ )
+        {
+            TelemetryParse( Sentence, &Record, Columns );
+        }
+        Parse = TestSeconds(  ) - Start;
+
+        printf( "%-6s %2d fields: sscanf %6.0f ns, TelemetryParse %6.0f ns "
+                "(%.1fx)\n", Pass ? "dev" : "basic", Columns,
+                Scan / Count * 1e9, Parse / Count * 1e9, Scan / Parse );
+    }
+
+    return 0;
+}
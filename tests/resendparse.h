@@ -0,0 +1,174 @@
+#ifndef _H_ResendParse
+#define _H_ResendParse
+
+// Tracker-side decoders for the SSDV resend requests, written from the
+// description in README.md rather than from ssdvimage.c, so the tests
+// check the wire format and not just the encoder against itself.
+
+#include <stdlib.h>
+#include <string.h>
+
+#define RESEND_MAX_IMAGES   2
+
+typedef struct {
+    int ImageNumber;
+    int Highest;
+    int Count;                  // Packets asked for
+    char Wanted[65536];
+} resend_image_t;
+
+static int
+ResendGetVarint( const unsigned char **p, const unsigned char *End )
+{
+    int Value, Shift;
+
+    Value = 0;
+    for ( Shift = 0; ( *p < End ) && ( Shift < 28 ); Shift += 7 )
+    {
+        Value |= ( **p & 0x7F ) << Shift;
+        if ( !( *( *p )++ & 0x80 ) )
+            return Value;
+    }
+
+    return -1;
+}
+
+static int
+ResendWant( resend_image_t * Image, int First, int Last )
+{
+    if ( ( First < 0 ) || ( Last < First ) || ( Last > 65535 ) )
+        return 0;
+
+    for ( ; First <= Last; First++ )
+    {
+        Image->Count += !Image->Wanted[First];
+        Image->Wanted[First] = 1;
+    }
+
+    return 1;
+}
+
+// Binary request.  Returns the number of images, or -1 if it's malformed.
+static int
+ParseBinaryResend( const unsigned char *Message, int Length,
+                   resend_image_t * Images )
+{
+    const unsigned char *p, *End, *BodyEnd;
+    int Count, Encoding, First, Run, Next, i;
+
+    if ( ( Length < 2 ) || ( Message[0] != 0xE5 )
+         || ( Message[1] != Length - 2 ) )
+        return -1;
+
+    p = Message + 2;
+    End = Message + Length;
+    for ( Count = 0; p < End; Count++ )
+    {
+        resend_image_t *Image = &Images[Count];
+
+        if ( ( Count >= RESEND_MAX_IMAGES ) || ( End - p < 5 ) )
+            return -1;
+
+        memset( Image, 0, sizeof( *Image ) );
+        Image->ImageNumber = p[0];
+        Image->Highest = ( p[1] << 8 ) | p[2];
+        Encoding = p[3];
+        BodyEnd = p + 5 + p[4];
+        p += 5;
+        if ( BodyEnd > End )
+            return -1;
+
+        if ( Encoding == 0 )
+        {
+            for ( Next = 0; p < BodyEnd; Next = First + Run + 1 )
+            {
+                if ( ( ( First = ResendGetVarint( &p, BodyEnd ) ) < 0 )
+                     || ( ( Run = ResendGetVarint( &p, BodyEnd ) ) < 0 ) )
+                    return -1;
+
+                First += Next;
+                if ( !ResendWant( Image, First, First + Run ) )
+                    return -1;
+            }
+        }
+        else if ( Encoding == 1 )
+        {
+            if ( ( First = ResendGetVarint( &p, BodyEnd ) ) < 0 )
+                return -1;
+
+            for ( i = 0; p + i / 8 < BodyEnd; i++ )
+            {
+                if ( ( p[i / 8] >> ( i % 8 ) ) & 1 )
+                {
+                    if ( !ResendWant( Image, First + i, First + i ) )
+                        return -1;
+                }
+            }
+            p = BodyEnd;
+        }
+        else
+        {
+            return -1;
+        }
+    }
+
+    return Count;
+}
+
+// "!image:last=ranges,image:last=ranges\n".  Returns the number of images,
+// or -1 if it's malformed.
+static int
+ParseTextResend( const char *Message, resend_image_t * Images )
+{
+    const char *p;
+    char *End;
+    long First, Last;
+    int Count;
+
+    if ( Message[0] != '!' )
+        return -1;
+
+    Count = 0;
+    for ( p = Message + 1; *p && ( *p != '\n' ); )
+    {
+        First = strtol( p, &End, 10 );
+        if ( End == p )
+            return -1;
+        p = End;
+
+        if ( *p == ':' )
+        {
+            resend_image_t *Image = &Images[Count];
+
+            if ( Count >= RESEND_MAX_IMAGES )
+                return -1;
+            memset( Image, 0, sizeof( *Image ) );
+            Image->ImageNumber = First;
+            Image->Highest = strtol( p + 1, &End, 10 );
+            if ( *End != '=' )
+                return -1;
+            p = End + 1;
+            Count++;
+            continue;
+        }
+
+        if ( Count == 0 )
+            return -1;
+
+        Last = First;
+        if ( *p == '-' )
+        {
+            Last = strtol( p + 1, &End, 10 );
+            p = End;
+        }
+        if ( !ResendWant( &Images[Count - 1], First, Last ) )
+            return -1;
+
+        if ( *p == ',' )
+            p++;
+    }
+
+    return ( ( p[0] == '\n' ) && ( p[1] == '\0' ) ) ? Count : -1;
+}
+
+#endif
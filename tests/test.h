@@ -0,0 +1,80 @@
+#ifndef _H_Test
+#define _H_Test
+
+// Minimal checks for the unit tests.  Each test program counts failures
+// and exits non-zero if there were any, so "make test" stops on the first
+// failing program.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Test programs are run from the top of the tree
+#define TEST_DATA   "tests/data/"
+
+static int TestFailures = 0;
+
+#define CHECK( Condition, ... ) \
+    do { \
+        if ( !( Condition ) ) \
+        { \
+            printf( "%s:%d: FAIL: ", __FILE__, __LINE__ ); \
+            printf( __VA_ARGS__ ); \
+            printf( "\n" ); \
+            TestFailures++; \
+        } \
+    } while ( 0 )
+
+static inline int
+TestResult( const char *Name )
+{
+    printf( "%s: %s\n", Name, TestFailures ? "FAILED" : "ok" );
+
+    return TestFailures ? 1 : 0;
+}
+
+// Monotonic seconds, for the timings
+static inline double
+TestSeconds( void )
+{
+    struct timespec Now;
+
+    clock_gettime( CLOCK_MONOTONIC, &Now );
+
+    return Now.tv_sec + Now.tv_nsec * 1e-9;
+}
+
+// Read a whole file into a malloc'd buffer; NULL if it can't be read
+static inline unsigned char *
+TestReadFile( const char *FileName, size_t * Length )
+{
+    unsigned char *Data;
+    FILE *fp;
+    long Size;
+
+    if ( ( fp = fopen( FileName, "rb" ) ) == NULL )
+    {
+        printf( "Can't open %s\n", FileName );
+        return NULL;
+    }
+
+    fseek( fp, 0, SEEK_END );
+    Size = ftell( fp );
+    fseek( fp, 0, SEEK_SET );
+
+    if ( ( Data = malloc( Size > 0 ? Size : 1 ) ) != NULL )
+    {
+        if ( fread( Data, 1, Size, fp ) != ( size_t ) Size )
+        {
+            free( Data );
+            Data = NULL;
+        }
+    }
+    fclose( fp );
+
+    *Length = Size;
+
+    return Data;
+}
+
+#endif
@@ -0,0 +1,120 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../base64.h"
+#include "test.h"
+
+// Every base64 encoder this CPU can run, against the plain loop, over
+// every length and alignment the block encoders see
+
+static const char *Encoders[] = { "scalar", "vector", "ssse3", "avx2" };
+
+static void
+TestVectors( const char *Encoder )
+{
+    static const char *Tests[][2] = {
+        {"", ""}, {"f", "Zg=="}, {"fo", "Zm8="}, {"foo", "Zm9v"},
+        {"foob", "Zm9vYg=="}, {"fooba", "Zm9vYmE="}, {"foobar", "Zm9vYmFy"}
+    };
+    char Encoded[16];
+    size_t Length;
+    int i;
+
+    // RFC 4648 section 10
+    for ( i = 0; i < sizeof( Tests ) / sizeof( Tests[0] ); i++ )
+    {
+        base64_encode( Tests[i][0], strlen( Tests[i][0] ), &Length, Encoded );
+        CHECK( ( Length == strlen( Tests[i][1] ) )
+               && !memcmp( Encoded, Tests[i][1], Length ), "%s: \"%s\"",
+               Encoder, Tests[i][0] );
+    }
+}
+
+static void
+TestEncoder( const char *Encoder, const unsigned char *Data,
+             const char *Expected[], int MaxLength )
+{
+    char Encoded[600];
+    size_t Length;
+    int Offset, n;
+
+    for ( Offset = 0; Offset < 16; Offset++ )
+    {
+        for ( n = 0; n <= MaxLength; n++ )
+        {
+            // Guard bytes after the output
+            memset( Encoded, '#', sizeof( Encoded ) );
+            base64_encode( ( const char * ) Data + Offset, n, &Length,
+                           Encoded );
+            CHECK( ( Length == 4 * ( ( n + 2 ) / 3 ) )
+                   && !memcmp( Encoded, Expected[Offset * ( MaxLength + 1 ) + n],
+                               Length ) && ( Encoded[Length] == '#' ),
+                   "%s: offset %d length %d", Encoder, Offset, n );
+        }
+    }
+}
+
+int
+main( void )
+{
+    enum { MAX_LENGTH = 300 };
+    static unsigned char Data[MAX_LENGTH + 16];
+    static const char *Expected[16 * ( MAX_LENGTH + 1 )];
+    char *Decoded;
+    size_t Length, DecodedLength;
+    int i, n, Tested;
+
+    srand( 1 );
+    for ( i = 0; i < sizeof( Data ); i++ )
+    {
+        Data[i] = rand(  );
+    }
+
+    // Reference output from the plain loop
+    CHECK( base64_select_encoder( "plain" ) == 0, "plain" );
+    TestVectors( "plain" );
+    for ( i = 0; i < 16 * ( MAX_LENGTH + 1 ); i++ )
+    {
+        char *Encoded = malloc( 4 * ( MAX_LENGTH + 2 ) / 3 + 1 );
+
+        n = i % ( MAX_LENGTH + 1 );
+        base64_encode( ( const char * ) Data + i / ( MAX_LENGTH + 1 ), n,
+                       &Length, Encoded );
+        Expected[i] = Encoded;
+
+        // and it decodes back again
+        if ( n > 0 )
+        {
+            Decoded = base64_decode( Encoded, Length, &DecodedLength );
+            CHECK( Decoded && ( DecodedLength == n )
+                   && !memcmp( Decoded, Data + i / ( MAX_LENGTH + 1 ), n ),
+                   "decode length %d", n );
+            free( Decoded );
+        }
+    }
+
+    Tested = 0;
+    for ( i = 0; i < sizeof( Encoders ) / sizeof( Encoders[0] ); i++ )
+    {
+        if ( base64_select_encoder( Encoders[i] ) < 0 )
+        {
+            printf( "base64: no %s encoder here\n", Encoders[i] );
+            continue;
+        }
+
+        TestVectors( Encoders[i] );
+        TestEncoder( Encoders[i], Data, Expected, MAX_LENGTH );
+        Tested++;
+    }
+    CHECK( Tested >= 2, "only %d encoders", Tested );
+
+    CHECK( base64_select_encoder( "none" ) < 0, "unknown encoder" );
+
+    for ( i = 0; i < 16 * ( MAX_LENGTH + 1 ); i++ )
+    {
+        free( ( char * ) Expected[i] );
+    }
+    base64_cleanup(  );
+
+    return TestResult( "base64" );
+}
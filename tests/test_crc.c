@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../crc.h"
+#include "test.h"
+
+// The bit-at-a-time CRC16 the gateway had before the table-driven one
+static uint16_t
+BitCRC16( const unsigned char *Data, size_t Length )
+{
+    uint16_t CRC;
+    int j;
+
+    CRC = 0xFFFF;
+    for ( ; Length > 0; Length--, Data++ )
+    {
+        CRC ^= ( ( unsigned int ) *Data ) << 8;
+        for ( j = 0; j < 8; j++ )
+        {
+            if ( CRC & 0x8000 )
+                CRC = ( CRC << 1 ) ^ 0x1021;
+            else
+                CRC <<= 1;
+        }
+    }
+
+    return CRC;
+}
+
+static void
+TestCRC16( void )
+{
+    unsigned char Data[600];
+    int i, Trial;
+
+    CHECK( CRC16( ( unsigned char * ) "123456789" ) == 0x29B1, "check value" );
+
+    // Every length and alignment the slice-by-4 loop can see, plus
+    // updates split at random points
+    srand( 1 );
+    for ( i = 0; i < sizeof( Data ); i++ )
+    {
+        Data[i] = rand(  );
+    }
+
+    for ( Trial = 0; Trial < 2000; Trial++ )
+    {
+        size_t Offset = Trial % 4, Length = rand(  ) % 500, Split;
+        uint16_t Expected = BitCRC16( Data + Offset, Length );
+
+        CHECK( CRC16Update( 0xFFFF, Data + Offset, Length ) == Expected,
+               "offset %zu length %zu", Offset, Length );
+
+        Split = Length ? rand(  ) % Length : 0;
+        CHECK( CRC16Update( CRC16Update( 0xFFFF, Data + Offset, Split ),
+                            Data + Offset + Split, Length - Split ) ==
+               Expected, "split %zu/%zu", Split, Length );
+    }
+}
+
+static void
+TestCRC32( void )
+{
+    CHECK( CRC32Update( 0, ( const unsigned char * ) "123456789", 9 ) ==
+           0xCBF43926, "CRC32 check value" );
+    CHECK( CRC32Update( CRC32Update( 0, ( const unsigned char * ) "1234", 4 ),
+                        ( const unsigned char * ) "56789", 5 ) == 0xCBF43926,
+           "CRC32 in two parts" );
+}
+
+static void
+TestChecksum( void )
+{
+    char Sentence[100];
+
+    strcpy( Sentence, "$$PAYLOAD,1,12:00:00,51.0,-2.0,100" );
+    sprintf( Sentence + strlen( Sentence ), "*%04X\n",
+             BitCRC16( ( unsigned char * ) Sentence + 2,
+                       strlen( Sentence ) - 2 ) );
+
+    CHECK( TelemetryChecksumOK( Sentence ), "good CRC" );
+    Sentence[10] ^= 1;
+    CHECK( !TelemetryChecksumOK( Sentence ), "corrupt sentence" );
+    Sentence[10] ^= 1;
+    Sentence[strlen( Sentence ) - 2] ^= 1;
+    CHECK( !TelemetryChecksumOK( Sentence ), "corrupt CRC" );
+
+    CHECK( TelemetryChecksumOK( "$$AB*03" ), "XOR checksum" );
+    CHECK( !TelemetryChecksumOK( "$$AB*04" ), "bad XOR checksum" );
+    CHECK( !TelemetryChecksumOK( "$$AB" ), "no checksum" );
+    CHECK( !TelemetryChecksumOK( "$$AB*123" ), "3 digits" );
+}
+
+int
+main( void )
+{
+    TestCRC16(  );
+    TestCRC32(  );
+    TestChecksum(  );
+
+    return TestResult( "crc" );
+}
@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../flights.h"
+#include "test.h"
+
+// Flight table: payloads are kept apart, and once it's full the one heard
+// least recently is dropped for a new one, with the rest still findable
+
+static void
+Update( const char *Payload, unsigned int Altitude, long Seconds, time_t At )
+{
+    telemetry_values_t Telemetry;
+    flight_t Flight;
+
+    memset( &Telemetry, 0, sizeof( Telemetry ) );
+    strcpy( Telemetry.Payload, Payload );
+    Telemetry.Altitude = Altitude;
+    Telemetry.Seconds = Seconds;
+
+    CHECK( FlightUpdate( 1, &Telemetry, At, &Flight ), "%s: update", Payload );
+}
+
+static int
+Count( void )
+{
+    flight_t Flight;
+    int Index, n;
+
+    for ( Index = 0, n = 0; FlightNext( &Index, &Flight ); n++ )
+    {
+    }
+
+    return n;
+}
+
+int
+main( void )
+{
+    char Payload[16];
+    flight_t Flight;
+    int i, Round;
+
+    // Ascent rate per payload
+    Update( "ALPHA", 1000, 100, 1 );
+    Update( "BETA", 5000, 100, 1 );
+    Update( "ALPHA", 1100, 110, 2 );
+    CHECK( FlightGet( "ALPHA", &Flight ) && ( Flight.AscentRate == 10.0f )
+           && ( Flight.PacketCount == 2 ), "ALPHA rate %f", Flight.AscentRate );
+    CHECK( FlightGet( "BETA", &Flight ) && ( Flight.AscentRate == 0 ),
+           "BETA rate" );
+    CHECK( !FlightGet( "GAMMA", &Flight ), "GAMMA" );
+
+    // Fill it up, then keep adding payloads: each new one drops the
+    // oldest, and everything else must still be there
+    for ( i = 0; i < MAX_FLIGHTS - 2; i++ )
+    {
+        sprintf( Payload, "P%d", i );
+        Update( Payload, i, 100, 10 + i );
+    }
+    CHECK( Count(  ) == MAX_FLIGHTS, "%d flights", Count(  ) );
+
+    for ( Round = 0; Round < 300; Round++ )
+    {
+        sprintf( Payload, "NEW%d", Round );
+        Update( Payload, Round, 100, 1000 + Round );
+        CHECK( FlightGet( Payload, &Flight ), "%s added", Payload );
+        CHECK( Count(  ) == MAX_FLIGHTS, "round %d: %d flights", Round,
+               Count(  ) );
+
+        if ( Round == 0 )
+        {
+            CHECK( !FlightGet( "BETA", &Flight ), "BETA kept" );
+            CHECK( FlightGet( "ALPHA", &Flight ), "ALPHA dropped" );
+        }
+        if ( Round == 1 )
+        {
+            CHECK( !FlightGet( "ALPHA", &Flight ), "ALPHA kept" );
+        }
+    }
+
+    // The last MAX_FLIGHTS are the ones left
+    for ( Round = 300 - MAX_FLIGHTS; Round < 300; Round++ )
+    {
+        sprintf( Payload, "NEW%d", Round );
+        CHECK( FlightGet( Payload, &Flight ) && ( Flight.Telemetry.Altitude ==
+                                                   Round ), "%s", Payload );
+    }
+    CHECK( !FlightGet( "P0", &Flight ), "P0 kept" );
+
+    return TestResult( "flights" );
+}
@@ -0,0 +1,175 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+
+#include "../json.h"
+#include "test.h"
+
+// JSON writer: fixed-place numbers must match printf exactly, strings
+// must be escaped, and nothing may be written past the buffer.
+
+static const char *
+Fixed( double Value, int Places )
+{
+    static char Buffer[512];
+    json_writer_t Writer;
+
+    JSONBegin( &Writer, Buffer, sizeof( Buffer ) );
+    JSONFixed( &Writer, NULL, Value, Places );
+    JSONEnd( &Writer );
+
+    return Buffer;
+}
+
+static void
+CheckFixed( double Value, int Places )
+{
+    char Expected[512];
+
+    snprintf( Expected, sizeof( Expected ), "%.*f", Places, Value );
+    CHECK( !strcmp( Fixed( Value, Places ), Expected ),
+           "%.17g to %d places: %s, not %s", Value, Places,
+           Fixed( Value, Places ), Expected );
+}
+
+static void
+TestFixed( void )
+{
+    static const double Values[] = {
+        0, 1, -1, 0.5, 1.5, 2.5, -2.5, 0.125, 0.375, -0.125, 1.005, 2.675,
+        0.045, 1.45, -1.45, 51.123455, 51.123465, -0.4, -0.5, -0.004,
+        -0.00001, 1e-10, -1e-10, 999.9999999, 9.5, 99.95, 123456.789,
+        4503599627370495.5, 1e15, 1e20, -1e20, 1.7976931348623157e308,
+        4.9e-324, -4.9e-324
+    };
+    long long k;
+    int i, Places, Trial;
+
+    for ( i = 0; i < sizeof( Values ) / sizeof( Values[0] ); i++ )
+    {
+        for ( Places = 0; Places <= 9; Places++ )
+        {
+            CheckFixed( Values[i], Places );
+        }
+    }
+
+    CheckFixed( -0.0, 0 );
+    CheckFixed( -0.0, 5 );
+
+    // Halfway points and their neighbours, which rounding by adding 0.5
+    // gets wrong
+    srand( 1 );
+    for ( Trial = 0; Trial < 200000; Trial++ )
+    {
+        double Value;
+
+        Places = rand(  ) % 10;
+        k = rand(  ) % 100000000;
+        Value = ( k + 0.5 ) / pow( 10, Places );
+        switch ( Trial % 4 )
+        {
+            case 1:
+                Value = nextafter( Value, 0 );
+                break;
+            case 2:
+                Value = nextafter( Value, INFINITY );
+                break;
+            case 3:
+                Value = -Value;
+                break;
+        }
+        CheckFixed( Value, Places );
+    }
+
+    // Latitudes, longitudes and rates as the gateway sees them
+    for ( Trial = 0; Trial < 200000; Trial++ )
+    {
+        double Value = ( rand(  ) / ( double ) RAND_MAX - 0.5 ) * 360;
+
+        CheckFixed( Value, Trial % 10 );
+        CheckFixed( Value / 1e6, Trial % 10 );
+    }
+
+    CHECK( !strcmp( Fixed( NAN, 2 ), "null" ), "NaN" );
+    CHECK( !strcmp( Fixed( -INFINITY, 2 ), "null" ), "infinity" );
+}
+
+static void
+TestDocument( void )
+{
+    char Buffer[256], Expected[256];
+    json_writer_t Writer;
+    int i;
+
+    JSONBegin( &Writer, Buffer, sizeof( Buffer ) );
+    JSONBeginObject( &Writer, NULL );
+    JSONString( &Writer, "a", "x\"y\\z\n\r\t\x01\x1f" );
+    JSONInteger( &Writer, "min", LONG_MIN );
+    JSONBeginArray( &Writer, "list" );
+    JSONInteger( &Writer, NULL, 1 );
+    JSONBeginObject( &Writer, NULL );
+    JSONEndObject( &Writer );
+    JSONStringN( &Writer, NULL, "abc", 2 );
+    JSONEndArray( &Writer );
+    JSONFixed( &Writer, "k\"ey", -0.001, 2 );
+    JSONEndObject( &Writer );
+    JSONRaw( &Writer, "\r\n" );
+
+    snprintf( Expected, sizeof( Expected ),
+              "{\"a\":\"x\\\"y\\\\z\\n\\r\\t\\u0001\\u001f\","
+              "\"min\":%ld,\"list\":[1,{},\"ab\"],\"k\\\"ey\":-0.00}\r\n",
+              LONG_MIN );
+    CHECK( JSONEnd( &Writer ) == strlen( Buffer ), "length" );
+    CHECK( !strcmp( Buffer, Expected ), "document: %s", Buffer );
+
+    // Long clean runs either side of characters needing escapes, at every
+    // offset the 8-byte scan can see them
+    for ( i = 0; i < 20; i++ )
+    {
+        char Value[32];
+
+        memset( Value, 'a', sizeof( Value ) );
+        Value[31] = '\0';
+        Value[i] = '"';
+        snprintf( Expected, sizeof( Expected ), "\"%.*s\\\"%s\"", i, Value,
+                  Value + i + 1 );
+
+        JSONBegin( &Writer, Buffer, sizeof( Buffer ) );
+        JSONString( &Writer, NULL, Value );
+        JSONEnd( &Writer );
+        CHECK( !strcmp( Buffer, Expected ), "quote at %d: %s", i, Buffer );
+    }
+
+    // Every size too small for the document (28 characters and the
+    // terminator) fails, without writing past it
+    for ( i = 0; i <= 29; i++ )
+    {
+        memset( Buffer, '#', sizeof( Buffer ) );
+        JSONBegin( &Writer, Buffer, i );
+        JSONBeginObject( &Writer, NULL );
+        JSONString( &Writer, "name", "value\n" );
+        JSONFixed( &Writer, "x", 1.25, 3 );
+        JSONEndObject( &Writer );
+
+        if ( i == 29 )
+        {
+            CHECK( ( JSONEnd( &Writer ) == 28 ) && !strcmp( Buffer,
+                                                          "{\"name\":\"value\\n\",\"x\":1.250}" ),
+                   "size 29: %s", Buffer );
+            break;
+        }
+        CHECK( JSONEnd( &Writer ) == -1, "size %d fitted", i );
+        CHECK( ( i == 0 ) || ( Buffer[0] == '\0' ), "size %d not empty", i );
+        CHECK( Buffer[i] == '#', "size %d overrun", i );
+    }
+}
+
+int
+main( void )
+{
+    TestFixed(  );
+    TestDocument(  );
+
+    return TestResult( "json" );
+}
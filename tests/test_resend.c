@@ -0,0 +1,219 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../ssdvimage.h"
+#include "resendparse.h"
+#include "test.h"
+
+// SSDV resend requests, built by the image assembler from real packets and
+// decoded again as a tracker would.  Every packet asked for must really be
+// missing, the request must cover the missing packets from the start of
+// the image with no holes (so that if it's cut short, it's the later ones
+// that wait for the next uplink), and if nothing was cut, all of them.
+
+#define PACKET_SIZE 256
+
+static unsigned char *Packets;
+static int PacketCount;
+static resend_image_t Asked[RESEND_MAX_IMAGES];
+
+// The assembler queues images for conversion; nothing to do here
+void
+QueueImageConversion( const char *Callsign, int ImageNumber, int Final )
+{
+}
+
+typedef struct {
+    int ImageNumber;
+    int Highest;
+    char Have[65536];
+} sent_image_t;
+
+static void
+Send( const char *Callsign, sent_image_t * Image )
+{
+    unsigned char Packet[PACKET_SIZE];
+    int i;
+
+    Image->Highest = -1;
+    for ( i = 0; i < PacketCount; i++ )
+    {
+        if ( Image->Have[i] )
+        {
+            memcpy( Packet, Packets + i * PACKET_SIZE, PACKET_SIZE );
+            Packet[6] = Image->ImageNumber;
+            SSDVImageAddPacket( Callsign, Packet, time( NULL ) );
+            Image->Highest = i;
+        }
+    }
+}
+
+// Lose packets at random, in bursts of up to Burst
+static void
+Lose( sent_image_t * Image, int Percent, int Burst )
+{
+    int i, j, Length;
+
+    memset( Image->Have, 0, sizeof( Image->Have ) );
+    for ( i = 0; i < PacketCount; i++ )
+    {
+        Image->Have[i] = 1;
+    }
+
+    for ( i = 1; i < PacketCount - 1; i++ )
+    {
+        if ( rand(  ) % ( 100 * ( Burst + 1 ) / 2 ) < Percent )
+        {
+            Length = 1 + rand(  ) % Burst;
+            for ( j = i; ( j < i + Length ) && ( j < PacketCount - 1 ); j++ )
+            {
+                Image->Have[j] = 0;
+            }
+            i = j;
+        }
+    }
+}
+
+static void
+CheckImage( const char *Name, const resend_image_t * Asked,
+            const sent_image_t * Sent, int Whole )
+{
+    int i, Last, Holes;
+
+    CHECK( Asked->Highest == Sent->Highest, "%s: highest %d, not %d", Name,
+           Asked->Highest, Sent->Highest );
+
+    for ( Last = Sent->Highest - 1; ( Last >= 0 ) && !Asked->Wanted[Last];
+          Last-- )
+    {
+    }
+
+    Holes = 0;
+    for ( i = 0; i < 65536; i++ )
+    {
+        int Missing = ( i < Sent->Highest ) && !Sent->Have[i];
+
+        CHECK( !Asked->Wanted[i] || Missing, "%s: asked for %d", Name, i );
+        Holes += Missing && !Asked->Wanted[i] && ( Whole || ( i < Last ) );
+    }
+    CHECK( Holes == 0, "%s: %d missing packets not asked for", Name, Holes );
+}
+
+static void
+CheckRequests( const char *Name, const char *Callsign, sent_image_t * Sent,
+               int SentCount, int Whole )
+{
+    unsigned char Binary[256];
+    char Text[256];
+    int Length, Count, i, j;
+
+    for ( j = 0; j < 2; j++ )
+    {
+        if ( j == 0 )
+        {
+            Length = SSDVImageResendRequest( Callsign, Text, 255 );
+            CHECK( ( Length == strlen( Text ) ) && ( Length < 255 ),
+                   "%s: text length %d", Name, Length );
+            Count = ParseTextResend( Text, Asked );
+        }
+        else
+        {
+            Length = SSDVImageBinaryResendRequest( Callsign, Binary, 255 );
+            CHECK( ( Length > 2 ) && ( Length <= 255 ),
+                   "%s: binary length %d", Name, Length );
+            Count = ParseBinaryResend( Binary, Length, Asked );
+        }
+
+        // Once the first image fills the request, the second may not fit
+        CHECK( Whole ? ( Count == SentCount )
+               : ( ( Count >= 1 ) && ( Count <= SentCount ) ),
+               "%s (%s): %d images", Name,
+               j ? "binary" : "text", Count );
+
+        for ( i = 0; ( i < Count ) && ( i < SentCount ); i++ )
+        {
+            // Oldest image first
+            CHECK( Asked[i].ImageNumber == Sent[i].ImageNumber,
+                   "%s: image %d", Name, Asked[i].ImageNumber );
+            CheckImage( Name, &Asked[i], &Sent[i], Whole );
+        }
+    }
+}
+
+int
+main( void )
+{
+    static sent_image_t Sent[2];
+    unsigned char Binary[256];
+    char Text[256];
+    size_t Length;
+    int i;
+
+    Packets = TestReadFile( TEST_DATA "ssdv_1280x1024.bin", &Length );
+    if ( Packets == NULL )
+        return 1;
+    PacketCount = Length / PACKET_SIZE;
+
+    srand( 1 );
+
+    // A few gaps, which fit whole in either form
+    memset( Sent, 0, sizeof( Sent ) );
+    Sent[0].ImageNumber = 7;
+    for ( i = 0; i <= 120; i++ )
+    {
+        Sent[0].Have[i] = ( i != 5 ) && ( ( i < 17 ) || ( i > 20 ) );
+    }
+    Send( "SMALL", &Sent[0] );
+    CheckRequests( "few gaps", "SMALL", Sent, 1, 1 );
+
+    CHECK( SSDVImageResendRequest( "SMALL", Text, 255 ) &&
+           !strcmp( Text, "!7:120=5,17-20\n" ), "text: %s", Text );
+
+    // Two images, the older one with a burst; both fit
+    Sent[1].ImageNumber = 8;
+    for ( i = 0; i < 300; i++ )
+    {
+        Sent[1].Have[i] = ( i < 100 ) || ( i > 180 );
+    }
+    Send( "SMALL", &Sent[1] );
+    CheckRequests( "two images", "SMALL", Sent, 2, 1 );
+
+    // Nothing missing
+    memset( Sent, 0, sizeof( Sent ) );
+    Sent[0].ImageNumber = 1;
+    memset( Sent[0].Have, 1, 50 );
+    Send( "NONE", &Sent[0] );
+    CHECK( SSDVImageResendRequest( "NONE", Text, 255 ) == 0, "none: text" );
+    CHECK( SSDVImageBinaryResendRequest( "NONE", Binary, 255 ) == 0,
+           "none: binary" );
+
+    // Heavier loss over two whole images, which gets cut short
+    Sent[0].ImageNumber = 254;
+    Sent[1].ImageNumber = 255;
+    Lose( &Sent[0], 10, 1 );
+    Lose( &Sent[1], 10, 1 );
+    Send( "LOSSY", &Sent[0] );
+    Send( "LOSSY", &Sent[1] );
+    CheckRequests( "10% loss", "LOSSY", Sent, 2, 0 );
+
+    Sent[0].ImageNumber = 3;
+    Sent[1].ImageNumber = 4;
+    Lose( &Sent[0], 30, 20 );
+    Lose( &Sent[1], 5, 3 );
+    Send( "BURSTY", &Sent[0] );
+    Send( "BURSTY", &Sent[1] );
+    CheckRequests( "bursts", "BURSTY", Sent, 2, 0 );
+
+    // Very little room still gives a well-formed request
+    Length = SSDVImageBinaryResendRequest( "BURSTY", Binary, 12 );
+    CHECK( ( Length > 2 ) && ( Length <= 12 ), "12 bytes: %zu", Length );
+    CHECK( ParseBinaryResend( Binary, Length, Asked ) == 1,
+           "12 bytes: malformed" );
+    CheckImage( "12 bytes", &Asked[0], &Sent[0], 0 );
+
+    // No SSDVImageFlush(), which would write the images to /tmp
+    free( Packets );
+
+    return TestResult( "resend" );
+}
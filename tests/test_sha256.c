@@ -0,0 +1,121 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../sha256.h"
+#include "test.h"
+
+// SHA-256 known answers (FIPS 180-2 and the NIST examples), through every
+// transform this CPU can run, with the input fed whole and in pieces
+
+static const char *Transforms[] = { "portable", "shani", "armv8" };
+
+static void
+Hash( const char *Data, size_t Length, size_t Chunk, char *Hex )
+{
+    SHA256_CTX ctx;
+    uint8_t Digest[32];
+    size_t Done, n;
+    int i;
+
+    sha256_init( &ctx );
+    for ( Done = 0; Done < Length; Done += n )
+    {
+        n = Length - Done < Chunk ? Length - Done : Chunk;
+        sha256_update( &ctx, ( char * ) Data + Done, n );
+    }
+    sha256_final( &ctx, Digest );
+
+    for ( i = 0; i < 32; i++ )
+    {
+        sprintf( Hex + i * 2, "%02x", Digest[i] );
+    }
+}
+
+static void
+TestTransform( const char *Transform )
+{
+    static const char *Tests[][2] = {
+        {"",
+         "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+        {"abc",
+         "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+        {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+         "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+        {"abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmn"
+         "hijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+         "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1"}
+    };
+    static const size_t Chunks[] = { 1, 3, 63, 64, 65, 1000, 1000000 };
+    char Hex[65], *Million;
+    int i, c;
+
+    for ( i = 0; i < sizeof( Tests ) / sizeof( Tests[0] ); i++ )
+    {
+        for ( c = 0; c < sizeof( Chunks ) / sizeof( Chunks[0] ); c++ )
+        {
+            Hash( Tests[i][0], strlen( Tests[i][0] ), Chunks[c], Hex );
+            CHECK( !strcmp( Hex, Tests[i][1] ), "%s: \"%.10s\" in %zu: %s",
+                   Transform, Tests[i][0], Chunks[c], Hex );
+        }
+    }
+
+    // A million 'a's
+    Million = malloc( 1000000 );
+    memset( Million, 'a', 1000000 );
+    for ( c = 0; c < sizeof( Chunks ) / sizeof( Chunks[0] ); c++ )
+    {
+        Hash( Million, 1000000, Chunks[c], Hex );
+        CHECK( !strcmp( Hex, "cdc76e5c9914fb9281a1c7e284d73e67"
+                        "f1809a48a497200e046d39ccc7112cd0" ),
+               "%s: million a in %zu: %s", Transform, Chunks[c], Hex );
+    }
+    free( Million );
+}
+
+int
+main( void )
+{
+    unsigned char Data[3000];
+    char Expected[65], Actual[65];
+    int i, Tested, Length;
+
+    Tested = 0;
+    for ( i = 0; i < sizeof( Transforms ) / sizeof( Transforms[0] ); i++ )
+    {
+        if ( sha256_select_transform( Transforms[i] ) < 0 )
+        {
+            printf( "sha256: no %s transform here\n", Transforms[i] );
+            continue;
+        }
+        TestTransform( Transforms[i] );
+        Tested++;
+    }
+    CHECK( Tested >= 1, "no transforms" );
+
+    // Random lengths either side of the padding boundaries, every
+    // transform against the portable one
+    srand( 1 );
+    for ( i = 0; i < sizeof( Data ); i++ )
+    {
+        Data[i] = rand(  );
+    }
+    for ( Length = 0; Length < sizeof( Data ); Length += 1 + rand(  ) % 70 )
+    {
+        sha256_select_transform( "portable" );
+        Hash( ( char * ) Data, Length, Length + 1, Expected );
+        for ( i = 1; i < sizeof( Transforms ) / sizeof( Transforms[0] ); i++ )
+        {
+            if ( sha256_select_transform( Transforms[i] ) == 0 )
+            {
+                Hash( ( char * ) Data, Length, 1 + Length / 3, Actual );
+                CHECK( !strcmp( Expected, Actual ), "%s: length %d",
+                       Transforms[i], Length );
+            }
+        }
+    }
+
+    CHECK( sha256_select_transform( "none" ) < 0, "unknown transform" );
+
+    return TestResult( "sha256" );
+}
@@ -0,0 +1,192 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../ssdvdec.h"
+#include "test.h"
+
+// The sample is a 320x240 image in 21 packets.  The expected JPEG was
+// checked against the source image: libjpeg decodes both to identical
+// pixels.
+
+#define PACKET_SIZE 256
+
+static unsigned char *Packets, *Expected;
+static size_t PacketCount, ExpectedLength;
+
+// Feed packets in the order given, as the image assembler does: a packet
+// that fills a gap rewinds the decoder to it, and everything held after it
+// is fed again.  Each JPEG along the way must be complete.
+static void
+FeedInOrder( ssdv_decoder_t * Decoder, const int *Order, int Count,
+             char *Have )
+{
+    const unsigned char *JPEG;
+    size_t Length;
+    int n, i, Highest;
+
+    Highest = -1;
+    for ( i = 0; i < PacketCount; i++ )
+    {
+        if ( Have[i] )
+            Highest = i;
+    }
+
+    for ( n = 0; n < Count; n++ )
+    {
+        int ID = Order[n];
+
+        Have[ID] = 1;
+        if ( ID > Highest )
+            Highest = ID;
+
+        if ( ID < Decoder->State.NextPacket )
+            SSDVDecoderRewind( Decoder, ID );
+
+        for ( i = Decoder->State.NextPacket; i <= Highest; i++ )
+        {
+            if ( Have[i] )
+                SSDVDecoderFeed( Decoder, Packets + i * PACKET_SIZE );
+        }
+
+        JPEG = SSDVDecoderJPEG( Decoder, &Length );
+        CHECK( JPEG && ( Length > 4 ) && ( JPEG[0] == 0xFF )
+               && ( JPEG[1] == 0xD8 ) && ( JPEG[Length - 2] == 0xFF )
+               && ( JPEG[Length - 1] == 0xD9 ), "SOI/EOI after packet %d",
+               ID );
+    }
+}
+
+static int
+MatchesExpected( ssdv_decoder_t * Decoder )
+{
+    const unsigned char *JPEG;
+    size_t Length;
+
+    JPEG = SSDVDecoderJPEG( Decoder, &Length );
+
+    return JPEG && ( Length == ExpectedLength )
+        && !memcmp( JPEG, Expected, Length );
+}
+
+static void
+TestOrder( const char *Name, const int *Order )
+{
+    ssdv_decoder_t Decoder;
+    char Have[256];
+
+    memset( &Decoder, 0, sizeof( Decoder ) );
+    memset( Have, 0, sizeof( Have ) );
+
+    FeedInOrder( &Decoder, Order, PacketCount, Have );
+    CHECK( MatchesExpected( &Decoder ), "%s: JPEG differs", Name );
+
+    SSDVDecoderFree( &Decoder );
+}
+
+static void
+TestGaps( void )
+{
+    static const int Missing[] = { 3, 10, 11, 20 };
+    ssdv_decoder_t Decoder;
+    int Order[256], Count, i, j;
+    char Have[256];
+
+    memset( &Decoder, 0, sizeof( Decoder ) );
+    memset( Have, 0, sizeof( Have ) );
+
+    for ( i = 0, Count = 0; i < PacketCount; i++ )
+    {
+        for ( j = 0; ( j < 4 ) && ( Missing[j] != i ); j++ )
+        {
+        }
+        if ( j == 4 )
+            Order[Count++] = i;
+    }
+
+    // Partial image: complete JPEG, but not the finished one
+    FeedInOrder( &Decoder, Order, Count, Have );
+    CHECK( !MatchesExpected( &Decoder ), "gaps: should differ" );
+
+    // Resent packets turn up, latest first, each rewinding the decoder
+    for ( i = 3; i >= 0; i-- )
+    {
+        FeedInOrder( &Decoder, &Missing[i], 1, Have );
+    }
+    CHECK( MatchesExpected( &Decoder ), "gaps: JPEG differs once filled" );
+
+    // Rewinding to the start and feeding again changes nothing
+    SSDVDecoderRewind( &Decoder, 0 );
+    for ( i = 0; i < PacketCount; i++ )
+    {
+        SSDVDecoderFeed( &Decoder, Packets + i * PACKET_SIZE );
+    }
+    CHECK( MatchesExpected( &Decoder ), "rewind to 0: JPEG differs" );
+
+    SSDVDecoderFree( &Decoder );
+}
+
+static void
+TestFile( void )
+{
+    const char *JPEGFile = "tests/ssdvdec.jpg";
+    unsigned char *JPEG;
+    size_t Length;
+
+    CHECK( SSDVDecodeFile( TEST_DATA "ssdv_320x240.bin", JPEGFile ) == 0,
+           "SSDVDecodeFile" );
+    JPEG = TestReadFile( JPEGFile, &Length );
+    CHECK( JPEG && ( Length == ExpectedLength )
+           && !memcmp( JPEG, Expected, Length ), "file JPEG differs" );
+    free( JPEG );
+    remove( JPEGFile );
+}
+
+int
+main( void )
+{
+    int Order[256], i;
+    size_t Length;
+
+    Packets = TestReadFile( TEST_DATA "ssdv_320x240.bin", &Length );
+    Expected = TestReadFile( TEST_DATA "ssdv_320x240.jpg", &ExpectedLength );
+    if ( !Packets || !Expected )
+        return 1;
+    PacketCount = Length / PACKET_SIZE;
+
+    for ( i = 0; i < PacketCount; i++ )
+    {
+        Order[i] = i;
+    }
+    TestOrder( "in order", Order );
+
+    for ( i = 0; i < PacketCount; i++ )
+    {
+        Order[i] = PacketCount - 1 - i;
+    }
+    TestOrder( "reversed", Order );
+
+    for ( i = 0; i < PacketCount; i++ )
+    {
+        Order[i] = i < ( PacketCount + 1 ) / 2 ? i * 2 :
+            ( i - ( PacketCount + 1 ) / 2 ) * 2 + 1;
+    }
+    TestOrder( "evens then odds", Order );
+
+    srand( 1 );
+    for ( i = PacketCount - 1; i > 0; i-- )
+    {
+        int j = rand(  ) % ( i + 1 ), t = Order[i];
+
+        Order[i] = Order[j];
+        Order[j] = t;
+    }
+    TestOrder( "shuffled", Order );
+
+    TestGaps(  );
+    TestFile(  );
+
+    free( Packets );
+    free( Expected );
+
+    return TestResult( "ssdvdec" );
+}
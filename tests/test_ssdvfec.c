@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../ssdvfec.h"
+#include "../crc.h"
+#include "test.h"
+
+// Reed-Solomon repair of real 0x66 packets: up to 16 bad bytes must be
+// corrected, more must be reported as uncorrectable (the decoder may give
+// up or land on the wrong codeword, which the CRC catches).
+
+#define PACKET_SIZE 256
+#define CODEWORD    255         // Packet[1] to Packet[255]
+
+static unsigned char *Packets;
+static int PacketCount;
+
+// Damage Errors distinct bytes of the codeword, other than the packet
+// type (which decides whether there's anything to check at all).  Returns
+// 1 if any of them are covered by the CRC.
+static int
+Damage( unsigned char *Packet, int Errors )
+{
+    char Hit[PACKET_SIZE];
+    int i, Position, InData;
+
+    memset( Hit, 0, sizeof( Hit ) );
+    InData = 0;
+    for ( i = 0; i < Errors; i++ )
+    {
+        do
+        {
+            Position = 2 + rand(  ) % ( CODEWORD - 1 );
+        }
+        while ( Hit[Position] );
+
+        Hit[Position] = 1;
+        Packet[Position] ^= 1 + rand(  ) % 255;
+        InData |= Position <= 223;
+    }
+
+    return InData;
+}
+
+static void
+TestRepair( void )
+{
+    unsigned char Packet[PACKET_SIZE];
+    int Errors, i, Result, InData;
+
+    for ( i = 0; i < PacketCount; i++ )
+    {
+        memcpy( Packet, Packets + i * PACKET_SIZE, PACKET_SIZE );
+        CHECK( SSDVPacketRepair( Packet, CODEWORD ) == 0, "clean packet %d",
+               i );
+    }
+
+    for ( Errors = 1; Errors <= 16; Errors++ )
+    {
+        for ( i = 0; i < PacketCount; i++ )
+        {
+            const unsigned char *Good = Packets + i * PACKET_SIZE;
+
+            memcpy( Packet, Good, PACKET_SIZE );
+            InData = Damage( Packet, Errors );
+            Result = SSDVPacketRepair( Packet, CODEWORD );
+
+            // Damage only to the parity leaves the CRC good, so nothing
+            // needs doing
+            CHECK( Result == ( InData ? Errors : 0 ),
+                   "%d errors, packet %d: returned %d", Errors, i, Result );
+            CHECK( !memcmp( Packet + 1, Good + 1, 223 ),
+                   "%d errors, packet %d: data not restored", Errors, i );
+        }
+    }
+
+    for ( Errors = 17; Errors <= 40; Errors++ )
+    {
+        for ( i = 0; i < PacketCount; i++ )
+        {
+            memcpy( Packet, Packets + i * PACKET_SIZE, PACKET_SIZE );
+            while ( !Damage( Packet, Errors ) )
+            {
+                memcpy( Packet, Packets + i * PACKET_SIZE, PACKET_SIZE );
+            }
+            CHECK( SSDVPacketRepair( Packet, CODEWORD ) == SSDV_FEC_FAILED,
+                   "%d errors, packet %d: not rejected", Errors, i );
+        }
+    }
+
+    memcpy( Packet, Packets, PACKET_SIZE );
+    CHECK( SSDVPacketRepair( Packet, CODEWORD - 1 ) == SSDV_FEC_FAILED,
+           "short packet" );
+}
+
+// 0x67 packets have no parity, just a CRC over 251 bytes
+static void
+TestNoFEC( void )
+{
+    unsigned char Packet[PACKET_SIZE];
+    uint32_t CRC;
+
+    memcpy( Packet, Packets, PACKET_SIZE );
+    Packet[1] = 0x67;
+    CRC = CRC32Update( 0, Packet + 1, 251 );
+    Packet[252] = CRC >> 24;
+    Packet[253] = CRC >> 16;
+    Packet[254] = CRC >> 8;
+    Packet[255] = CRC;
+
+    CHECK( SSDVPacketRepair( Packet, CODEWORD ) == 0, "0x67 clean" );
+    Packet[100] ^= 1;
+    CHECK( SSDVPacketRepair( Packet, CODEWORD ) == SSDV_FEC_FAILED,
+           "0x67 damaged" );
+}
+
+int
+main( void )
+{
+    size_t Length;
+
+    if ( ( Packets = TestReadFile( TEST_DATA "ssdv_640x480.bin",
+                                   &Length ) ) == NULL )
+        return 1;
+    PacketCount = Length / PACKET_SIZE;
+
+    srand( 1 );
+    TestRepair(  );
+    TestNoFEC(  );
+
+    free( Packets );
+
+    return TestResult( "ssdvfec" );
+}
@@ -0,0 +1,81 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../telemetry.h"
+#include "test.h"
+
+static const char *Sentence =
+    "$$PAYLOAD,123,12:34:56,51.95023,-2.54445,12345,10,270,9,"
+    "21.5,-40.25,1.5,51.1,-2.2,5.5,300,90,91,12.5,45,1,2,3,4.5,7*5A3C\n";
+
+static void
+TestParse( void )
+{
+    telemetry_record_t Record;
+
+    CHECK( TelemetryParse( Sentence, &Record, TELEMETRY_DEV_FIELDS ) == 25,
+           "dev fields" );
+    CHECK( strcmp( Record.Values.Payload, "PAYLOAD" ) == 0, "payload" );
+    CHECK( Record.Values.Counter == 123, "counter" );
+    CHECK( strcmp( Record.Values.Time, "12:34:56" ) == 0, "time" );
+    CHECK( Record.Values.Seconds == 12 * 3600 + 34 * 60 + 56, "seconds" );
+    CHECK( fabs( Record.Values.Latitude - 51.95023 ) < 1e-9, "latitude" );
+    CHECK( fabs( Record.Values.Longitude + 2.54445 ) < 1e-9, "longitude" );
+    CHECK( Record.Values.Altitude == 12345, "altitude" );
+    CHECK( Record.Values.TempExt == -40.25f, "temp" );
+    CHECK( Record.Values.FlightMode == 7, "flight mode" );
+
+    CHECK( TelemetryParse( Sentence, &Record, TELEMETRY_BASIC_FIELDS ) == 6,
+           "basic fields" );
+    CHECK( Record.Values.Speed == 0, "speed not converted" );
+    CHECK( Record.Values.FlightMode == -1, "flight mode default" );
+}
+
+static void
+TestFromEnd( void )
+{
+    char Long[1000];
+    telemetry_field_t Field, Fields[TELEMETRY_MAX_FIELDS];
+    int i;
+
+    CHECK( TelemetryFieldFromEnd( Sentence, 1, &Field ), "last" );
+    CHECK( ( Field.Length == 1 ) && ( Field.Start[0] == '7' ), "last = 7" );
+    CHECK( TelemetryFieldFromEnd( Sentence, 2, &Field ), "second last" );
+    CHECK( ( Field.Length == 3 ) && !strncmp( Field.Start, "4.5", 3 ),
+           "second last = 4.5" );
+
+    // No checksum, no newline
+    CHECK( TelemetryFieldFromEnd( "$$A,B,C", 2, &Field ), "no '*'" );
+    CHECK( ( Field.Length == 1 ) && ( Field.Start[0] == 'B' ), "B" );
+    CHECK( TelemetryFieldFromEnd( "$$A,B,C", 3, &Field ), "first" );
+    CHECK( ( Field.Length == 1 ) && ( Field.Start[0] == 'A' ), "A" );
+    CHECK( !TelemetryFieldFromEnd( "$$A,B,C", 4, &Field ), "too few" );
+    CHECK( !TelemetryFieldFromEnd( "$$A*1234", 2, &Field ), "one field" );
+    CHECK( TelemetryFieldFromEnd( "$$A,,C", 2, &Field ) && !Field.Length,
+           "empty field" );
+
+    // More fields than the record holds: the split stops, but the SMS
+    // acknowledgement must still come from the real second-last field
+    strcpy( Long, "$$LONG" );
+    for ( i = 1; i <= 40; i++ )
+    {
+        sprintf( Long + strlen( Long ), ",%d", i );
+    }
+    strcat( Long, "*ABCD\n" );
+
+    CHECK( TelemetrySplit( Long, Fields, TELEMETRY_MAX_FIELDS ) ==
+           TELEMETRY_MAX_FIELDS, "split stops at the limit" );
+    CHECK( TelemetryFieldFromEnd( Long, 2, &Field ), "long" );
+    CHECK( atoi( Field.Start ) == 39, "second last of 41 is 39, got %d",
+           atoi( Field.Start ) );
+}
+
+int
+main( void )
+{
+    TestParse(  );
+    TestFromEnd(  );
+
+    return TestResult( "telemetry" );
+}
@@ -0,0 +1,18 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+// LogMessage for test programs linking gateway modules without gateway.c.
+// Quiet unless TEST_LOG is set, so "make test" shows only the results.
+void
+LogMessage( const char *format, ... )
+{
+    va_list args;
+
+    if ( getenv( "TEST_LOG" ) == NULL )
+        return;
+
+    va_start( args, format );
+    vprintf( format, args );
+    va_end( args );
+}